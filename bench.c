@@ -0,0 +1,873 @@
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gtpc-column.h"
+#include "gtpc-decoder.h"
+#include "gtpc-session.h"
+#include "gtpc-view.h"
+#include "gtpu-decoder.h"
+
+/*
+ * gcd-bench: end-to-end decode benchmark over built-in synthetic corpora
+ *
+ *   gcd-bench [-d seconds] [-t max threads] [-s sessions] [-j]
+ *
+ * -s sets how many sessions the session table learns before its lookups
+ * are timed, -j prints one json object per result line for regression
+ * tracking
+ */
+
+#define MAX_MSG_LEN  1024
+#define MAX_CORPUS   64
+#define LAT_SAMPLES  200000
+#define IE_REPEAT    16
+
+typedef struct msg_s {
+    uint8_t buf[MAX_MSG_LEN];
+    uint32_t len;
+    uint8_t version;
+} msg_t;
+
+typedef struct corpus_s {
+    const char *name;
+    msg_t msgs[MAX_CORPUS];
+    uint32_t count;
+} corpus_t;
+
+static double duration = 1.0;
+static int max_threads;
+static uint32_t max_sessions = 100000;
+static int json;
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* message builders */
+static msg_t *newMsg(corpus_t *c, uint8_t version, uint8_t type)
+{
+    msg_t *m = &c->msgs[c->count++];
+    memset(m, 0, sizeof(*m));
+    m->version = version;
+    uint8_t *p = m->buf;
+    switch (version) {
+    case 0:
+        p[0] = 0x1E; // v0, PT, spare
+        p[1] = type;
+        p[4] = 0x12; // sequence
+        p[9] = 0xFF; // spare
+        p[10] = 0xFF;
+        p[11] = 0xFF;
+        memcpy(p + 12, "\x64\x00\x00\x00\x00\x00\x00\xf1", 8); // tid
+        m->len = 20;
+        break;
+    case 1:
+        p[0] = 0x32; // v1, PT, S
+        p[1] = type;
+        *(uint32_t *)(p + 4) = htonl(0x01020304);
+        p[8] = 0x12;
+        m->len = 12;
+        break;
+    default:
+        p[0] = 0x48; // v2, T
+        p[1] = type;
+        *(uint32_t *)(p + 4) = htonl(0x01020304);
+        p[10] = 0x12;
+        m->len = 12;
+        break;
+    }
+    return m;
+}
+
+static void tv(msg_t *m, uint8_t type, const void *v, uint32_t n)
+{
+    m->buf[m->len++] = type;
+    memcpy(m->buf + m->len, v, n);
+    m->len += n;
+}
+
+static void tlv(msg_t *m, uint8_t type, const void *v, uint32_t n)
+{
+    m->buf[m->len++] = type;
+    *(uint16_t *)(m->buf + m->len) = htons(n);
+    m->len += 2;
+    memcpy(m->buf + m->len, v, n);
+    m->len += n;
+}
+
+static void tlv2(msg_t *m, uint8_t type, uint8_t instance, const void *v,
+                 uint32_t n)
+{
+    m->buf[m->len++] = type;
+    *(uint16_t *)(m->buf + m->len) = htons(n);
+    m->len += 2;
+    m->buf[m->len++] = instance & 0x0F;
+    memcpy(m->buf + m->len, v, n);
+    m->len += n;
+}
+
+static void finish(msg_t *m)
+{
+    uint32_t hdr = m->version == 0 ? 20 : (m->version == 1 ? 8 : 4);
+    *(uint16_t *)(m->buf + 2) = htons(m->len - hdr);
+}
+
+#define IMSI   "\x64\x00\x00\x00\x00\x00\x00\xf1"
+#define MSISDN "\x91\x68\x31\x00\x00\x00\xf1"
+#define IMEI   "\x53\x71\x02\x01\x23\x45\x67\xf8"
+#define APN    "\x03" "cmn" "\x04" "corp" "\x03" "net"
+#define RAI    "\x64\xf0\x00\x12\x34\x56"
+#define ULI    "\x00\x64\xf0\x00\x12\x34\xab\xcd"
+#define GSN1   "\xc0\xa8\x01\x01"
+#define GSN2   "\xc0\xa8\x01\x02"
+#define EUA    "\xf1\x21\x0a\x00\x00\x01"
+#define QOS1   "\x02\x23\x92\x1f\x91\x97\xfe\xfe\x74\xf9\xff\xff"
+
+static void v0Messages(corpus_t *c)
+{
+    msg_t *m = newMsg(c, 0, 16); // create pdp context request
+    tv(m, 0x06, "\x23\x92\x1f", 3);
+    tv(m, 0x0E, "\x05", 1);
+    tv(m, 0x0F, "\x01", 1);
+    tv(m, 0x10, "\x00\x01", 2);
+    tv(m, 0x11, "\x00\x02", 2);
+    tlv(m, 0x80, "\xf1\x21", 2);
+    tlv(m, 0x83, APN, sizeof(APN) - 1);
+    tlv(m, 0x85, GSN1, 4);
+    tlv(m, 0x85, GSN2, 4);
+    tlv(m, 0x86, MSISDN, 7);
+    finish(m);
+
+    m = newMsg(c, 0, 17); // create pdp context response
+    tv(m, 0x01, "\x80", 1);
+    tv(m, 0x06, "\x23\x92\x1f", 3);
+    tv(m, 0x08, "\x00", 1);
+    tv(m, 0x0E, "\x05", 1);
+    tv(m, 0x10, "\x00\x03", 2);
+    tv(m, 0x11, "\x00\x04", 2);
+    tv(m, 0x7F, "\x00\x00\x00\x09", 4);
+    tlv(m, 0x80, EUA, 6);
+    tlv(m, 0x85, GSN1, 4);
+    tlv(m, 0x85, GSN2, 4);
+    finish(m);
+
+    m = newMsg(c, 0, 20); // delete pdp context request
+    finish(m);
+    m = newMsg(c, 0, 21); // delete pdp context response
+    tv(m, 0x01, "\x80", 1);
+    finish(m);
+}
+
+static void v1Messages(corpus_t *c)
+{
+    msg_t *m = newMsg(c, 1, 16); // create pdp context request
+    tv(m, 0x02, IMSI, 8);
+    tv(m, 0x03, RAI, 6);
+    tv(m, 0x0E, "\x05", 1);
+    tv(m, 0x0F, "\xfc", 1);
+    tv(m, 0x10, "\x11\x22\x33\x44", 4);
+    tv(m, 0x11, "\x55\x66\x77\x88", 4);
+    tv(m, 0x14, "\x05", 1);
+    tv(m, 0x1A, "\x08\x00", 2);
+    tlv(m, 0x80, "\xf1\x21", 2);
+    tlv(m, 0x83, APN, sizeof(APN) - 1);
+    tlv(m, 0x85, GSN1, 4);
+    tlv(m, 0x85, GSN2, 4);
+    tlv(m, 0x86, MSISDN, 7);
+    tlv(m, 0x87, QOS1, 12);
+    tlv(m, 0x97, "\x01", 1);
+    tlv(m, 0x98, ULI, 8);
+    tlv(m, 0x99, "\x23\x00", 2);
+    tlv(m, 0x9A, IMEI, 8);
+    finish(m);
+
+    m = newMsg(c, 1, 17); // create pdp context response
+    tv(m, 0x01, "\x80", 1);
+    tv(m, 0x08, "\x00", 1);
+    tv(m, 0x0E, "\x05", 1);
+    tv(m, 0x10, "\x99\x88\x77\x66", 4);
+    tv(m, 0x11, "\x55\x44\x33\x22", 4);
+    tv(m, 0x7F, "\x00\x00\x00\x09", 4);
+    tlv(m, 0x80, EUA, 6);
+    tlv(m, 0x85, GSN1, 4);
+    tlv(m, 0x85, GSN2, 4);
+    tlv(m, 0x87, QOS1, 12);
+    finish(m);
+
+    m = newMsg(c, 1, 18); // update pdp context request
+    tv(m, 0x03, RAI, 6);
+    tv(m, 0x0E, "\x05", 1);
+    tv(m, 0x10, "\x11\x22\x33\x44", 4);
+    tv(m, 0x11, "\x55\x66\x77\x88", 4);
+    tv(m, 0x14, "\x05", 1);
+    tlv(m, 0x85, GSN1, 4);
+    tlv(m, 0x85, GSN2, 4);
+    tlv(m, 0x87, QOS1, 12);
+    tlv(m, 0x97, "\x01", 1);
+    tlv(m, 0x98, ULI, 8);
+    finish(m);
+
+    m = newMsg(c, 1, 19); // update pdp context response
+    tv(m, 0x01, "\x80", 1);
+    tv(m, 0x10, "\x99\x88\x77\x66", 4);
+    tv(m, 0x7F, "\x00\x00\x00\x09", 4);
+    tlv(m, 0x85, GSN1, 4);
+    tlv(m, 0x85, GSN2, 4);
+    tlv(m, 0x87, QOS1, 12);
+    finish(m);
+
+    m = newMsg(c, 1, 20); // delete pdp context request
+    tv(m, 0x13, "\x01", 1);
+    tv(m, 0x14, "\x05", 1);
+    finish(m);
+
+    m = newMsg(c, 1, 21); // delete pdp context response
+    tv(m, 0x01, "\x80", 1);
+    finish(m);
+}
+
+static void v2Messages(corpus_t *c)
+{
+    static const uint8_t fteid[] = {0x8a, 0x11, 0x22, 0x33, 0x44,
+                                    10,   0,    0,    9};
+    msg_t *m = newMsg(c, 2, 32); // create session request
+    tlv2(m, 1, 0, IMSI, 8);
+    tlv2(m, 76, 0, "\x68\x31\x00\x00\x00\xf1", 6);
+    tlv2(m, 75, 0, IMEI, 8);
+    tlv2(m, 86, 0, "\x18\x64\xf0\x00\x12\x34\x64\xf0\x00\x00\x00\x00\x01",
+         13);
+    tlv2(m, 83, 0, "\x64\xf0\x00", 3);
+    tlv2(m, 82, 0, "\x06", 1);
+    tlv2(m, 87, 0, fteid, sizeof(fteid));
+    tlv2(m, 71, 0, APN, sizeof(APN) - 1);
+    tlv2(m, 128, 0, "\x00", 1);
+    tlv2(m, 99, 0, "\x01", 1);
+    tlv2(m, 79, 0, "\x01\x00\x00\x00\x00", 5);
+    tlv2(m, 72, 0, "\x00\x00\x10\x00\x00\x00\x10\x00", 8);
+    finish(m);
+
+    m = newMsg(c, 2, 33); // create session response
+    tlv2(m, 2, 0, "\x10\x00", 2);
+    tlv2(m, 87, 1, fteid, sizeof(fteid));
+    tlv2(m, 79, 0, "\x01\x0a\x00\x00\x01", 5);
+    tlv2(m, 127, 0, "\x00", 1);
+    finish(m);
+
+    m = newMsg(c, 2, 34); // modify bearer request
+    tlv2(m, 86, 0, "\x18\x64\xf0\x00\x12\x34\x64\xf0\x00\x00\x00\x00\x01",
+         13);
+    tlv2(m, 82, 0, "\x06", 1);
+    tlv2(m, 87, 0, fteid, sizeof(fteid));
+    finish(m);
+
+    m = newMsg(c, 2, 35); // modify bearer response
+    tlv2(m, 2, 0, "\x10\x00", 2);
+    finish(m);
+
+    m = newMsg(c, 2, 36); // delete session request
+    tlv2(m, 73, 0, "\x05", 1);
+    tlv2(m, 77, 0, "\x08\x00", 2);
+    finish(m);
+
+    m = newMsg(c, 2, 37); // delete session response
+    tlv2(m, 2, 0, "\x10\x00", 2);
+    finish(m);
+}
+
+static void malformedMessages(corpus_t *c)
+{
+    corpus_t tmp = {.name = "tmp"};
+    v1Messages(&tmp);
+    v2Messages(&tmp);
+    for (uint32_t i = 0; i < tmp.count && c->count < MAX_CORPUS; i++) {
+        msg_t *m = &c->msgs[c->count++];
+        *m = tmp.msgs[i];
+        if (m->len > 16) {
+            // cut the last IE short but keep the header length consistent
+            m->len -= 3;
+            finish(m);
+        }
+    }
+    msg_t *m = newMsg(c, 1, 16); // unknown TV IE, chain can not be followed
+    tv(m, 0x02, IMSI, 8);
+    tv(m, 0x30, "\x00\x00", 2);
+    finish(m);
+}
+
+static void unknownIEMessages(corpus_t *c)
+{
+    corpus_t tmp = {.name = "tmp"};
+    v1Messages(&tmp);
+    v2Messages(&tmp);
+    for (uint32_t i = 0; i < tmp.count && c->count < MAX_CORPUS; i++) {
+        msg_t *m = &c->msgs[c->count++];
+        *m = tmp.msgs[i];
+        if (m->version == 1) {
+            tlv(m, 0xEE, "vendor-specific", 15); // unregistered TLV
+        } else {
+            tlv2(m, 0xFE, 0, "vendor-specific", 15);
+        }
+        finish(m);
+    }
+}
+
+static void mixMessages(corpus_t *c)
+{
+    v0Messages(c);
+    v1Messages(c);
+    v1Messages(c);
+    v2Messages(c);
+    v2Messages(c);
+    v2Messages(c);
+}
+
+/* measurements */
+typedef struct run_s {
+    const corpus_t *corpus;
+    double seconds;
+    uint64_t msgs;
+    uint64_t bytes;
+} run_t;
+
+static void *runLoop(void *arg)
+{
+    run_t *run = arg;
+    const corpus_t *c = run->corpus;
+    gtp_t *gtp = malloc(sizeof(gtp_t));
+    uint64_t start = nowNs(), end = start + (uint64_t)(run->seconds * 1e9);
+    uint64_t msgs = 0, bytes = 0;
+    for (;;) {
+        for (uint32_t i = 0; i < c->count; i++) {
+            memset(gtp, 0, sizeof(*gtp));
+            decodeGtpc((uint8_t *)c->msgs[i].buf, c->msgs[i].len, gtp);
+            bytes += c->msgs[i].len;
+        }
+        msgs += c->count;
+        if (nowNs() >= end) {
+            break;
+        }
+    }
+    run->seconds = (nowNs() - start) / 1e9;
+    run->msgs = msgs;
+    run->bytes = bytes;
+    free(gtp);
+    return NULL;
+}
+
+static int cmpU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t timerOverhead()
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = nowNs(), t1 = nowNs();
+        if (t1 - t0 < best) {
+            best = t1 - t0;
+        }
+    }
+    return best;
+}
+
+static void latency(const corpus_t *c, uint64_t pct[4])
+{
+    uint64_t *samples = malloc(sizeof(uint64_t) * LAT_SAMPLES);
+    uint64_t overhead = timerOverhead();
+    gtp_t gtp;
+    for (uint32_t n = 0; n < LAT_SAMPLES; n++) {
+        const msg_t *m = &c->msgs[n % c->count];
+        memset(&gtp, 0, sizeof(gtp));
+        uint64_t t0 = nowNs();
+        decodeGtpc((uint8_t *)m->buf, m->len, &gtp);
+        uint64_t t = nowNs() - t0;
+        samples[n] = t > overhead ? t - overhead : 0;
+    }
+    qsort(samples, LAT_SAMPLES, sizeof(uint64_t), cmpU64);
+    pct[0] = samples[LAT_SAMPLES * 50 / 100];
+    pct[1] = samples[LAT_SAMPLES * 90 / 100];
+    pct[2] = samples[LAT_SAMPLES * 99 / 100];
+    pct[3] = samples[LAT_SAMPLES * 999 / 1000];
+    free(samples);
+}
+
+static run_t scale(const corpus_t *c, int threads)
+{
+    pthread_t tids[threads];
+    run_t runs[threads];
+    run_t total = {.corpus = c};
+    for (int i = 0; i < threads; i++) {
+        runs[i] = (run_t){.corpus = c, .seconds = duration};
+        pthread_create(&tids[i], NULL, runLoop, &runs[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        total.msgs += runs[i].msgs;
+        total.bytes += runs[i].bytes;
+        if (runs[i].seconds > total.seconds) {
+            total.seconds = runs[i].seconds;
+        }
+    }
+    return total;
+}
+
+static void reportCorpus(const corpus_t *c)
+{
+    run_t run = scale(c, 1);
+    uint64_t pct[4];
+    latency(c, pct);
+    double mps = run.msgs / run.seconds;
+    double bps = run.bytes / run.seconds;
+    if (json) {
+        printf("{\"bench\":\"corpus\",\"corpus\":\"%s\",\"threads\":1,"
+               "\"msgs_per_sec\":%.0f,\"bytes_per_sec\":%.0f,"
+               "\"ns_per_msg\":%.2f,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+               "\"p99_ns\":%llu,\"p999_ns\":%llu}\n",
+               c->name, mps, bps, 1e9 / mps, (unsigned long long)pct[0],
+               (unsigned long long)pct[1], (unsigned long long)pct[2],
+               (unsigned long long)pct[3]);
+    } else {
+        printf("%-10s %12.0f %10.1f %9.2f %7llu %7llu %7llu %7llu\n", c->name,
+               mps, bps / 1e6, 1e9 / mps, (unsigned long long)pct[0],
+               (unsigned long long)pct[1], (unsigned long long)pct[2],
+               (unsigned long long)pct[3]);
+    }
+}
+
+static void reportScaling(const corpus_t *c)
+{
+    if (!json) {
+        printf("\n%-8s %12s %10s\n", "threads", "msgs/s", "speedup");
+    }
+    double base = 0;
+    for (int t = 1;; t = t * 2 < max_threads ? t * 2 : max_threads) {
+        run_t run = scale(c, t);
+        double mps = run.msgs / run.seconds;
+        if (t == 1) {
+            base = mps;
+        }
+        if (json) {
+            printf("{\"bench\":\"scaling\",\"corpus\":\"%s\",\"threads\":%d,"
+                   "\"msgs_per_sec\":%.0f,\"speedup\":%.2f}\n",
+                   c->name, t, mps, mps / base);
+        } else {
+            printf("%-8d %12.0f %9.2fx\n", t, mps, mps / base);
+        }
+        if (t == max_threads) {
+            break;
+        }
+    }
+}
+
+static double nsPerMsg(msg_t *m, uint32_t iterations)
+{
+    gtp_t gtp;
+    uint64_t t0 = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        memset(&gtp, 0, sizeof(gtp));
+        decodeGtpc(m->buf, m->len, &gtp);
+    }
+    return (double)(nowNs() - t0) / iterations;
+}
+
+/*
+ * cost of one IE parser: a message repeating the IE IE_REPEAT times against
+ * the same message with no IE at all
+ */
+static void reportIECost(const corpus_t *c)
+{
+    uint8_t seen[MAX_GTPC_VERSION + 1][MAX_IE + 1] = {{0}};
+    uint32_t iterations = 200000;
+    if (!json) {
+        printf("\n%-8s %-5s %10s\n", "version", "ie", "ns/ie");
+    }
+    for (uint32_t i = 0; i < c->count; i++) {
+        const msg_t *src = &c->msgs[i];
+        gtp_view_t view;
+        if (decodeGtpcView((uint8_t *)src->buf, src->len, &view) != 1) {
+            continue;
+        }
+        corpus_t tmp;
+        tmp.count = 0;
+        msg_t *empty = newMsg(&tmp, src->version, src->buf[1]);
+        finish(empty);
+        double base = nsPerMsg(empty, iterations);
+        for (uint16_t k = 0; k < view.count; k++) {
+            const gtp_ie_ref_t *ie = &view.ies[k];
+            if (seen[src->version][ie->type]) {
+                continue;
+            }
+            seen[src->version][ie->type] = 1;
+            uint32_t hdrlen = src->version == 2 ? 4 : (ie->type & 0x80 ? 3 : 1);
+            uint32_t ielen = hdrlen + ie->length;
+            msg_t *m = newMsg(&tmp, src->version, src->buf[1]);
+            for (int r = 0; r < IE_REPEAT && m->len + ielen <= MAX_MSG_LEN;
+                 r++) {
+                memcpy(m->buf + m->len, src->buf + ie->offset - hdrlen, ielen);
+                m->len += ielen;
+            }
+            finish(m);
+            double cost = (nsPerMsg(m, iterations) - base) / IE_REPEAT;
+            tmp.count--;
+            if (json) {
+                printf("{\"bench\":\"ie\",\"version\":%u,\"ie\":%u,"
+                       "\"ns_per_ie\":%.2f}\n",
+                       src->version, ie->type, cost);
+            } else {
+                printf("%-8u %-5u %10.2f\n", src->version, ie->type, cost);
+            }
+        }
+    }
+}
+
+#define GTPU_BATCH 32
+
+/* user plane header parsing, every packet of a corpus has the same shape */
+static void reportGtpu()
+{
+    static const struct {
+        const char *name;
+        uint8_t hdr[32];
+        uint32_t len;
+    } shapes[] = {
+        {"plain", {0x30, 0xFF, 0x00, 0x40, 0, 0, 0, 1}, 8},
+        {"sqn", {0x32, 0xFF, 0x00, 0x44, 0, 0, 0, 1, 0x12, 0x34, 0, 0}, 12},
+        {"pdu-session",
+         {0x34, 0xFF, 0x00, 0x48, 0, 0, 0, 1, 0, 0, 0, 0x85, 0x01, 0x10, 0x09,
+          0x00},
+         16},
+        {"chain",
+         {0x36, 0xFF, 0x00, 0x50, 0, 0, 0, 1, 0x12, 0x34, 0, 0x40, 0x01, 0x08,
+          0x68, 0xC0, 0x01, 0x00, 0x2A, 0x85, 0x01, 0x10, 0x09, 0x00},
+         24},
+    };
+    static uint8_t pkts[GTPU_BATCH][128];
+    uint8_t *data[GTPU_BATCH];
+    uint32_t len[GTPU_BATCH];
+    gtpu_t gtpu[GTPU_BATCH];
+    int status[GTPU_BATCH];
+
+    if (!json) {
+        printf("\n%-12s %12s %9s\n", "gtpu", "pkts/s", "ns/pkt");
+    }
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        for (int i = 0; i < GTPU_BATCH; i++) {
+            memset(pkts[i], 0, sizeof(pkts[i]));
+            memcpy(pkts[i], shapes[s].hdr, shapes[s].len);
+            pkts[i][7] = i; // distinct teids
+            data[i] = pkts[i];
+            len[i] = 8 + pkts[i][3];
+        }
+        uint64_t n = 0, start = nowNs();
+        uint64_t end = start + (uint64_t)(duration * 1e9);
+        do {
+            for (int r = 0; r < 1024; r++) {
+                decodeGtpuBatch(data, len, gtpu, status, GTPU_BATCH);
+            }
+            n += 1024 * GTPU_BATCH;
+        } while (nowNs() < end);
+        double pps = n / ((nowNs() - start) / 1e9);
+        if (json) {
+            printf("{\"bench\":\"gtpu\",\"shape\":\"%s\","
+                   "\"pkts_per_sec\":%.0f,\"ns_per_pkt\":%.2f}\n",
+                   shapes[s].name, pps, 1e9 / pps);
+        } else {
+            printf("%-12s %12.0f %9.2f\n", shapes[s].name, pps, 1e9 / pps);
+        }
+    }
+}
+
+#define COLUMN_BATCH 1024
+
+/*
+ * a batch of the corpus decoded into gtp_t structs against the same batch
+ * decoded into columns, all of them or the few an analytics query reads
+ */
+static void reportColumns(const corpus_t *c)
+{
+    static gtp_t gtp[COLUMN_BATCH];
+    uint8_t *data[COLUMN_BATCH];
+    uint32_t len[COLUMN_BATCH];
+    int status[COLUMN_BATCH];
+    static const struct {
+        const char *name;
+        uint32_t columns; // 0 for gtp_t structs
+    } modes[] = {
+        {"structs", 0},
+        {"columns", GCD_COL_ALL},
+        {"columns-4", GCD_COL_BIT(GCD_COL_MSG_TYPE) | GCD_COL_BIT(GCD_COL_TEID)
+                          | GCD_COL_BIT(GCD_COL_IMSI)
+                          | GCD_COL_BIT(GCD_COL_CAUSE)},
+    };
+
+    for (int i = 0; i < COLUMN_BATCH; i++) {
+        data[i] = (uint8_t *)c->msgs[i % c->count].buf;
+        len[i] = c->msgs[i % c->count].len;
+    }
+    if (!json) {
+        printf("\n%-12s %12s %9s\n", "output", "msgs/s", "ns/msg");
+    }
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        gcd_column_batch_t *batch = NULL;
+        if (modes[m].columns) {
+            batch = gcdColumnBatchCreate(COLUMN_BATCH, modes[m].columns);
+            if (!batch) {
+                fprintf(stderr, "column batch allocation failed\n");
+                return;
+            }
+        }
+        uint64_t n = 0, start = nowNs();
+        uint64_t end = start + (uint64_t)(duration * 1e9);
+        do {
+            if (batch) {
+                gcdColumnBatchReset(batch);
+                gcdColumnBatchDecode(batch, data, len, COLUMN_BATCH);
+            } else {
+                memset(gtp, 0, sizeof(gtp));
+                decodeGtpcBatch(data, len, gtp, status, COLUMN_BATCH);
+            }
+            n += COLUMN_BATCH;
+        } while (nowNs() < end);
+        gcdColumnBatchDestroy(batch);
+        double mps = n / ((nowNs() - start) / 1e9);
+        if (json) {
+            printf("{\"bench\":\"output\",\"mode\":\"%s\","
+                   "\"msgs_per_sec\":%.0f,\"ns_per_msg\":%.2f}\n",
+                   modes[m].name, mps, 1e9 / mps);
+        } else {
+            printf("%-12s %12.0f %9.2f\n", modes[m].name, mps, 1e9 / mps);
+        }
+    }
+}
+
+#define SESSION_BATCH 64
+
+typedef struct session_run_s {
+    gcd_session_table_t *table;
+    uint32_t *teids; // every learned TEID, shuffled per thread
+    uint32_t count;
+    double seconds;
+    uint64_t lookups;
+    uint64_t hits;
+} session_run_t;
+
+static void *sessionLoop(void *arg)
+{
+    session_run_t *run = arg;
+    gcd_session_t sessions[SESSION_BATCH];
+    int found[SESSION_BATCH];
+    uint64_t start = nowNs(), end = start + (uint64_t)(run->seconds * 1e9);
+    uint64_t lookups = 0, hits = 0, now = start;
+    do {
+        for (uint32_t i = 0; i + SESSION_BATCH <= run->count;
+             i += SESSION_BATCH) {
+            hits += gcdSessionFindBatch(run->table, run->teids + i, sessions,
+                                        found, SESSION_BATCH, now);
+        }
+        lookups += run->count / SESSION_BATCH * SESSION_BATCH;
+        now = nowNs();
+    } while (now < end);
+    run->seconds = (now - start) / 1e9;
+    run->lookups = lookups;
+    run->hits = hits;
+    return NULL;
+}
+
+/*
+ * learn max_sessions create request/response exchanges through their views,
+ * two TEIDs each, then look every TEID up with gcdSessionFindBatch() from
+ * 1 to max_threads threads
+ */
+static void reportSessions()
+{
+    uint32_t count = max_sessions * 2;
+    // twice the TEIDs, an unlucky shard must not evict what was learned
+    gcd_session_table_t *table =
+        gcdSessionTableCreate(&(gcd_session_conf_t){.maxSessions = count * 2});
+    uint32_t *teids = malloc(sizeof(uint32_t) * count);
+    if (!table || !teids) {
+        fprintf(stderr, "session table allocation failed\n");
+        gcdSessionTableDestroy(table);
+        free(teids);
+        return;
+    }
+    static const uint8_t fteid[] = {0x8a, 0, 0, 0, 0, 10, 0, 0, 9};
+    corpus_t tmp = {.name = "tmp"};
+    msg_t *req = newMsg(&tmp, 2, 32); // create session request
+    tlv2(req, 1, 0, IMSI, 8);
+    uint32_t reqTeid = req->len + 5;
+    tlv2(req, 87, 0, fteid, sizeof(fteid));
+    tlv2(req, 71, 0, APN, sizeof(APN) - 1);
+    finish(req);
+    msg_t *rsp = newMsg(&tmp, 2, 33); // create session response
+    tlv2(rsp, 2, 0, "\x10\x00", 2);
+    uint32_t rspTeid = rsp->len + 5;
+    tlv2(rsp, 87, 0, fteid, sizeof(fteid));
+    tlv2(rsp, 79, 0, "\x01\x0a\x00\x00\x01", 5);
+    finish(rsp);
+
+    gtp_view_t view;
+    uint32_t learned = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < max_sessions; i++) {
+        teids[2 * i] = 2 * i + 1;
+        teids[2 * i + 1] = 2 * i + 2;
+        *(uint32_t *)(req->buf + reqTeid) = htonl(teids[2 * i]);
+        *(uint32_t *)(rsp->buf + 4) = htonl(teids[2 * i]);
+        *(uint32_t *)(rsp->buf + rspTeid) = htonl(teids[2 * i + 1]);
+        decodeGtpcView(req->buf, req->len, &view);
+        learned += gcdSessionLearn(table, &view, start) == 1;
+        decodeGtpcView(rsp->buf, rsp->len, &view);
+        learned += gcdSessionLearn(table, &view, start) == 1;
+    }
+    double lps = learned / ((nowNs() - start) / 1e9);
+    if (learned != 2 * max_sessions) {
+        fprintf(stderr, "%u of %u session messages learned\n", learned,
+                2 * max_sessions);
+    }
+    if (json) {
+        printf("{\"bench\":\"session-learn\",\"sessions\":%u,"
+               "\"msgs_per_sec\":%.0f}\n",
+               max_sessions, lps);
+    } else {
+        printf("\n%u sessions learned at %.0f msgs/s\n", max_sessions, lps);
+        printf("%-8s %12s %9s %10s\n", "threads", "lookups/s", "ns/find",
+               "speedup");
+    }
+
+    pthread_t tids[max_threads];
+    session_run_t runs[max_threads];
+    for (int i = 0; i < max_threads; i++) {
+        runs[i] = (session_run_t){.table = table, .count = count};
+        runs[i].teids = malloc(sizeof(uint32_t) * count);
+        if (!runs[i].teids) {
+            fprintf(stderr, "session lookup allocation failed\n");
+            abort();
+        }
+        memcpy(runs[i].teids, teids, sizeof(uint32_t) * count);
+        srand(i + 1);
+        for (uint32_t k = count - 1; k > 0; k--) { // spread over the shards
+            uint32_t j = rand() % (k + 1), v = runs[i].teids[k];
+            runs[i].teids[k] = runs[i].teids[j];
+            runs[i].teids[j] = v;
+        }
+    }
+    double base = 0;
+    for (int t = 1;; t = t * 2 < max_threads ? t * 2 : max_threads) {
+        uint64_t lookups = 0, hits = 0;
+        double seconds = 0;
+        for (int i = 0; i < t; i++) {
+            runs[i].seconds = duration;
+            pthread_create(&tids[i], NULL, sessionLoop, &runs[i]);
+        }
+        for (int i = 0; i < t; i++) {
+            pthread_join(tids[i], NULL);
+            lookups += runs[i].lookups;
+            hits += runs[i].hits;
+            if (runs[i].seconds > seconds) {
+                seconds = runs[i].seconds;
+            }
+        }
+        if (hits != lookups) {
+            fprintf(stderr, "%llu of %llu lookups missed\n",
+                    (unsigned long long)(lookups - hits),
+                    (unsigned long long)lookups);
+        }
+        double fps = lookups / seconds;
+        if (t == 1) {
+            base = fps;
+        }
+        if (json) {
+            printf("{\"bench\":\"session\",\"sessions\":%u,\"threads\":%d,"
+                   "\"lookups_per_sec\":%.0f,\"speedup\":%.2f}\n",
+                   max_sessions, t, fps, fps / base);
+        } else {
+            printf("%-8d %12.0f %9.2f %9.2fx\n", t, fps, 1e9 * t / fps,
+                   fps / base);
+        }
+        if (t == max_threads) {
+            break;
+        }
+    }
+    for (int i = 0; i < max_threads; i++) {
+        free(runs[i].teids);
+    }
+    free(teids);
+    gcdSessionTableDestroy(table);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-d seconds] [-t max threads] [-s sessions] [-j]\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "d:t:s:jh")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 's':
+            max_sessions = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            json = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (duration <= 0 || max_threads <= 0 || max_sessions < SESSION_BATCH
+        || max_sessions > UINT32_MAX / 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!initIEParsers()) {
+        fprintf(stderr, "init IE parsers failed\n");
+        return 1;
+    }
+
+    static corpus_t corpora[] = {
+        {.name = "v0"},        {.name = "v1"},      {.name = "v2"},
+        {.name = "malformed"}, {.name = "unknown"}, {.name = "mix"},
+    };
+    v0Messages(&corpora[0]);
+    v1Messages(&corpora[1]);
+    v2Messages(&corpora[2]);
+    malformedMessages(&corpora[3]);
+    unknownIEMessages(&corpora[4]);
+    mixMessages(&corpora[5]);
+
+    if (!json) {
+        printf("%-10s %12s %10s %9s %7s %7s %7s %7s\n", "corpus", "msgs/s",
+               "MB/s", "ns/msg", "p50", "p90", "p99", "p99.9");
+    }
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+        reportCorpus(&corpora[i]);
+    }
+    reportScaling(&corpora[5]);
+    reportIECost(&corpora[5]);
+    reportColumns(&corpora[5]);
+    reportGtpu();
+    reportSessions();
+    return 0;
+}
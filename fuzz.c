@@ -0,0 +1,611 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gtpc-column.h"
+#include "gtpc-decoder.h"
+#include "gtpc-encoder.h"
+#include "gtpc-record.h"
+#include "gtpc-session.h"
+#include "gtpc-view.h"
+
+/*
+ * gcd-fuzz: run every decode path over a message with nothing readable past
+ * its end, for address sanitizer builds
+ *
+ *   gcd-fuzz [-n iterations] [-s seed] [file|dir...]
+ *
+ * the built-in regression messages and a full message of every version are
+ * decoded first, each also cut at every length, then the files given, raw
+ * gtpc messages. -n mutates them as many times more, "make fuzz" runs a
+ * million. "make gcd-libfuzzer" keeps only LLVMFuzzerTestOneInput() for
+ * libFuzzer to drive.
+ */
+
+#define MAX_MSG_LEN 2048
+#define MAX_MSGS    256
+
+static gcd_column_batch_t *columns;
+static gcd_session_table_t *sessions; // small, so mutations also evict
+
+static void onLog(int level, const char *msg, void *arg)
+{
+}
+
+/* a copy per path, some decode in place */
+static uint8_t *copyOf(const uint8_t *data, size_t len)
+{
+    uint8_t *p = malloc(len ? len : 1);
+    if (!p) {
+        abort();
+    }
+    memcpy(p, data, len);
+    return p;
+}
+
+static void init()
+{
+    if (columns) {
+        return;
+    }
+    initIEParsers();
+    gcdSetLogger(onLog, NULL, 0);
+    columns = gcdColumnBatchCreate(1, GCD_COL_ALL);
+    sessions = gcdSessionTableCreate(
+        &(gcd_session_conf_t){.maxSessions = 64, .shards = 4, .idleNs = 8});
+    if (!columns || !sessions) {
+        abort();
+    }
+}
+
+/* the decodeGtpc() return value */
+static int decodeAll(const uint8_t *data, size_t len)
+{
+    static gtp_t gtp[4];
+    static gtp_view_t view;
+    static gtp_record_t rec;
+    gtp_ie_mask_t none = {0};
+    int status[4];
+    uint8_t *p;
+
+    memset(gtp, 0, sizeof(gtp));
+    p = copyOf(data, len);
+    int ret = decodeGtpc(p, len, gtp);
+    free(p);
+
+    memset(gtp, 0, sizeof(gtp));
+    p = copyOf(data, len);
+    decodeGtpcMasked(p, len, gtp, &none);
+    free(p);
+
+    memset(gtp, 0, sizeof(gtp));
+    p = copyOf(data, len);
+    decodeGtpcAll(p, len, gtp, status, 4);
+    free(p);
+
+    p = copyOf(data, len);
+    if (decodeGtpcView(p, len, &view) >= 0) {
+        static uint64_t now;
+        if (gtpcRecordFromView(&view, &rec)
+            && (rec.imsiDigits > 2 * MAX_IMSI_LEN
+                || rec.imeiDigits > 2 * MAX_IMEISV_LEN
+                || rec.msisdnDigits > 2 * MAX_MSISDN_LEN)) {
+            abort(); // a digit count wrapped instead of being rejected
+        }
+        gcdSessionLearn(sessions, &view, now++);
+        gcdSessionExpire(sessions, now);
+    }
+    free(p);
+
+    p = copyOf(data, len);
+    uint32_t n = len;
+    gcdColumnBatchReset(columns);
+    gcdColumnBatchDecode(columns, &p, &n, 1);
+    free(p);
+    return ret;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len)
+{
+    init();
+    if (len <= MAX_MSG_LEN) {
+        decodeAll(data, len);
+    }
+    return 0;
+}
+
+#ifndef GCD_LIBFUZZER
+
+/*
+ * regression messages for the IE chain validation, the header length is
+ * set from the message unless raw. the ones marked fails must not decode
+ */
+typedef struct regression_s {
+    const char *name;
+    const char *hex;
+    int raw;
+    int fails;
+} regression_t;
+
+#define V0 "1e10000000010000ff ffffff 6400000000000000 f1"
+#define V1 "3210000001020304 0001 0000"
+#define V2 "4820000001020304 000001 00"
+
+static const regression_t regressions[] = {
+    {"v2 ie value past the end", V2 "01 0009 00 21436587", 0, 1},
+    {"v2 ie header cut", V2 "01 0004 00 21436587 0300", 0, 1},
+    {"v2 ie length 0xffff", V2 "47 ffff 00 03616263", 0, 1},
+    {"v2 grouped ie overflowing its group", V2 "5d 0005 00 49 0005 00 05", 0,
+     0},
+    {"v2 f-teid shorter than its fixed part", V2 "57 0003 00 8a0000", 0, 0},
+    {"v2 paa of 1 byte", V2 "4f 0001 00 01", 0, 0},
+    {"v2 uli flags without the fields", V2 "56 0001 00 18", 0, 0},
+    {"v2 header length past the datagram", "4820 00ff 01020304 000001 00", 1,
+     0},
+    {"v2 piggybacked message cut",
+     "5820 000c 01020304 000001 00 49 0001 00 05 4821 00ff 01020304", 1, 0},
+    {"v1 tlv length 0xffff", V1 "85 ffff 0a000001", 0, 1},
+    {"v1 tlv header cut", V1 "0e 01 85 00", 0, 1},
+    {"v1 tv value cut", V1 "02 214365", 0, 1},
+    {"v1 unknown tv", V1 "0e 01 7e 00", 0, 1},
+    {"v1 gsn address of 5 bytes", V1 "85 0005 0102030405", 0, 0},
+    {"v1 end user address of 1 byte", V1 "80 0001 f1", 0, 0},
+    {"v1 apn label past its ie", V1 "83 0004 08616263", 0, 0},
+    {"v1 header length past the datagram", "3210 ffff 01020304 0001 0000", 1,
+     0},
+    {"v0 tlv length past the end", V0 "85 0010 0a000001", 0, 1},
+    {"v0 tv value cut", V0 "02 2143", 0, 1},
+    {"v0 header only", V0, 0, 0},
+};
+
+#define REGRESSIONS (sizeof(regressions) / sizeof(regressions[0]))
+
+typedef struct msg_s {
+    uint8_t data[MAX_MSG_LEN];
+    uint32_t len;
+} msg_t;
+
+static msg_t msgs[MAX_MSGS];
+static uint32_t nmsgs;
+
+static uint32_t parseHex(const char *hex, uint8_t *out)
+{
+    uint32_t n = 0;
+    for (const char *p = hex; *p; p++) {
+        if (*p == ' ') {
+            continue;
+        }
+        unsigned v;
+        sscanf(p, "%2x", &v);
+        out[n++] = v;
+        p++;
+    }
+    return n;
+}
+
+static void fixLength(uint8_t *p, uint32_t len)
+{
+    uint32_t hdr = 4; // what msgLen leaves out
+    switch (p[0] >> 5) {
+    case 0:
+        hdr = 20;
+        break;
+    case 1:
+        hdr = 8;
+        break;
+    }
+    p[2] = (len - hdr) >> 8;
+    p[3] = len - hdr;
+}
+
+static int runRegressions()
+{
+    int failed = 0;
+    for (uint32_t i = 0; i < REGRESSIONS; i++) {
+        const regression_t *r = &regressions[i];
+        msg_t *m = &msgs[nmsgs++];
+        m->len = parseHex(r->hex, m->data);
+        if (!r->raw) {
+            fixLength(m->data, m->len);
+        }
+        int ret = decodeAll(m->data, m->len);
+        if (r->fails && ret == 1) {
+            fprintf(stderr, "%s: decoded\n", r->name);
+            failed++;
+        }
+        for (uint32_t cut = 0; cut < m->len; cut++) {
+            decodeAll(m->data, cut);
+        }
+    }
+    return failed;
+}
+
+#define SAME(field)                                                          \
+    (want->field == got->field                                               \
+         ? 0                                                                 \
+         : fprintf(stderr, "v%u " #field ": %llu, decoded %llu\n", version,  \
+                   (unsigned long long)want->field,                          \
+                   (unsigned long long)got->field) > 0)
+#define SAME_STR(field)                                                      \
+    (!strcmp(want->field, got->field)                                        \
+         ? 0                                                                 \
+         : fprintf(stderr, "v%u " #field ": \"%s\", decoded \"%s\"\n",        \
+                   version, want->field, got->field) > 0)
+
+/* the fields decodeGtpc() has to give back as they were encoded */
+static int compareDecoded(const gtp_t *want, const gtp_t *got)
+{
+    uint8_t version = want->hdr.version;
+    int diff = SAME(hdr.version) + SAME(hdr.msgType) + SAME(hdr.sqn);
+    switch (version) {
+    case 0:
+        diff += SAME(b0.cause) + SAME(b0.flowLabelData)
+                + SAME(b0.flowLabelSignalling) + SAME_STR(b0.imsi)
+                + SAME_STR(b0.msisdn) + SAME_STR(b0.apn);
+        break;
+    case 1:
+        diff += SAME(hdr.teid) + SAME(b1.cause) + SAME(b1.teid)
+                + SAME(b1.teidControlPlane) + SAME_STR(b1.imsi)
+                + SAME_STR(b1.msisdn) + SAME_STR(b1.imei) + SAME_STR(b1.apn);
+        break;
+    default:
+        diff += SAME(hdr.teid) + SAME(b2.cause) + SAME(b2.senderFteid.teid)
+                + SAME(b2.pgwFteid.teid) + SAME_STR(b2.imsi)
+                + SAME_STR(b2.msisdn) + SAME_STR(b2.mei) + SAME_STR(b2.apn)
+                + SAME(b2.bearerCount) + SAME(b2.bearerTotal)
+                + SAME(b2.bearers[1].ebi) + SAME(b2.bearers[1].fteidMask)
+                + SAME(b2.bearers[1].fteid[2].teid);
+        break;
+    }
+    return diff;
+}
+
+#undef SAME
+#undef SAME_STR
+
+/*
+ * a message of every version with most of the built-in IEs, must decode to
+ * what was encoded
+ */
+static int addEncoded()
+{
+    int failed = 0;
+    static gtp_t gtp[3];
+    for (int v = 0; v < 3; v++) {
+        gtp[v].hdr.version = v;
+        gtp[v].hdr.msgType = v == 2 ? 32 : 16;
+        gtp[v].hdr.teid = 0x01020304;
+        gtp[v].hdr.sqn = 0x1234;
+    }
+    gtp_v0_body_t *b0 = &gtp[0].b0;
+    strcpy(b0->imsi, "460001234567890");
+    strcpy(b0->routingAreaIdentityMcc, "460");
+    strcpy(b0->routingAreaIdentityMnc, "00");
+    b0->routingAreaIdentityLac = 0x1111;
+    b0->qos[0] = 0x0b;
+    b0->cause = 128;
+    b0->flowLabelData = 7;
+    b0->flowLabelSignalling = 8;
+    b0->pdpTypeNum = 0x21;
+    strcpy(b0->endUserAddress, "10.0.0.1");
+    strcpy(b0->apn, "cmnet.mnc000.mcc460.gprs");
+    strcpy(b0->gsnAddressSignal, "192.168.0.1");
+    strcpy(b0->gsnAddressUser, "192.168.0.2");
+    strcpy(b0->msisdn, "8613800000000");
+
+    gtp_v1_body_t *b1 = &gtp[1].b1;
+    strcpy(b1->imsi, "460001234567890");
+    strcpy(b1->routingAreaIdentityMcc, "460");
+    strcpy(b1->routingAreaIdentityMnc, "00");
+    b1->cause = 128;
+    b1->recovery = 3;
+    b1->teid = 0x11111111;
+    b1->teidControlPlane = 0x22222222;
+    b1->nsapi = 5;
+    b1->chargingId = 9;
+    b1->pdpTypeOrg = 1;
+    b1->pdpTypeNum = 0x57;
+    strcpy(b1->endUserAddress, "2001:db8::1");
+    strcpy(b1->apn, "cmnet.mnc000.mcc460.gprs");
+    strcpy(b1->gsnAddressSignal, "192.168.0.1");
+    strcpy(b1->gsnAddressUser, "2001:db8::2");
+    strcpy(b1->msisdn, "8613800000000");
+    b1->priority = 1;
+    b1->commonFlags = 0x80;
+    b1->ratType = 1;
+    strcpy(b1->userLocationInforMcc, "460");
+    strcpy(b1->userLocationInforMnc, "00");
+    b1->userLocationInforCellId = 0x3333;
+    b1->timezone = 0x23;
+    strcpy(b1->imei, "3534900698733190");
+
+    gtp_v2_body_t *b2 = &gtp[2].b2;
+    strcpy(b2->imsi, "460001234567890");
+    b2->cause = 16;
+    b2->ratType = 6;
+    b2->pdnType = 3;
+    b2->ebi = 5;
+    strcpy(b2->msisdn, "8613800000000");
+    strcpy(b2->mei, "3534900698733190");
+    strcpy(b2->apn, "ims.mnc000.mcc460.gprs");
+    strcpy(b2->servingNetworkMcc, "460");
+    strcpy(b2->servingNetworkMnc, "00");
+    b2->uliFlags = GTPV2_ULI_TAI | GTPV2_ULI_ECGI;
+    strcpy(b2->uliMcc, "460");
+    strcpy(b2->uliMnc, "00");
+    b2->uliTac = 0x4444;
+    b2->uliEci = 0x123456;
+    b2->paaType = 3;
+    b2->paaIpv6PrefixLen = 64;
+    b2->paaIpv4[0] = 10;
+    b2->ambrUplink = 1000;
+    b2->ambrDownlink = 2000;
+    b2->indicationLen = 3;
+    b2->senderFteid = (gtp_v2_fteid_t){.present = 1,
+                                       .ifType = 10,
+                                       .hasIpv4 = 1,
+                                       .hasIpv6 = 1,
+                                       .teid = 0x55555555,
+                                       .ipv4 = {192, 168, 0, 1},
+                                       .ipv6 = {0x20, 0x01, 0x0d, 0xb8}};
+    b2->pgwFteid = (gtp_v2_fteid_t){.present = 1,
+                                    .ifType = 7,
+                                    .hasIpv4 = 1,
+                                    .teid = 0x66666666,
+                                    .ipv4 = {192, 168, 0, 2}};
+    b2->bearerCount = b2->bearerTotal = 2;
+    for (int i = 0; i < 2; i++) {
+        gtp_v2_bearer_t *br = &b2->bearers[i];
+        br->ebi = 5 + i;
+        br->qci = 9;
+        br->arp = 0x45;
+        br->mbrUplink = br->gbrDownlink = 100000;
+        br->fteidMask = 0x05;
+        br->fteid[0] = (gtp_v2_bearer_fteid_t){.teid = 0x77777770 + i,
+                                               .ipv4 = {10, 0, 0, 1},
+                                               .ifType = 0,
+                                               .hasIpv4 = 1};
+        br->fteid[2] = (gtp_v2_bearer_fteid_t){.teid = 0x77777780 + i,
+                                               .ipv4 = {10, 0, 0, 2},
+                                               .ifType = 4,
+                                               .hasIpv4 = 1};
+    }
+
+    for (int v = 0; v < 3; v++) {
+        msg_t *m = &msgs[nmsgs];
+        int len = encodeGtpc(&gtp[v], m->data, MAX_MSG_LEN);
+        m->len = len > 0 ? len : 0;
+        if (len < 0 || decodeAll(m->data, m->len) != 1) {
+            fprintf(stderr, "v%d message: not decoded\n", v);
+            failed++;
+        } else {
+            static gtp_t got;
+            memset(&got, 0, sizeof(got));
+            uint8_t *p = copyOf(m->data, m->len);
+            // twice into the same gtp_t, nothing may add up across messages
+            decodeGtpc(p, m->len, &got);
+            decodeGtpc(p, m->len, &got);
+            free(p);
+            failed += compareDecoded(&gtp[v], &got) != 0;
+        }
+        for (uint32_t cut = 0; cut < m->len; cut++) {
+            decodeAll(m->data, cut);
+        }
+        nmsgs++;
+    }
+    return failed;
+}
+
+/* a v2 create session request or accepted response, learned at nowNs */
+static int learnV2(uint8_t type, uint32_t teid, uint32_t fteid,
+                   uint64_t nowNs, gcd_session_table_t *table)
+{
+    static gtp_t gtp;
+    static uint8_t buf[MAX_MSG_LEN];
+    gtp_view_t view;
+    memset(&gtp, 0, sizeof(gtp));
+    gtp.hdr.version = 2;
+    gtp.hdr.msgType = type;
+    gtp.hdr.teid = teid;
+    gtp.b2.cause = type == 33 ? 16 : 0;
+    snprintf(gtp.b2.imsi, sizeof(gtp.b2.imsi), "4600012%08u", fteid);
+    gtp.b2.senderFteid = (gtp_v2_fteid_t){.present = 1,
+                                          .ifType = 10,
+                                          .hasIpv4 = 1,
+                                          .teid = fteid,
+                                          .ipv4 = {192, 168, 0, 1}};
+    int len = encodeGtpc(&gtp, buf, sizeof(buf));
+    if (len <= 0 || decodeGtpcView(buf, len, &view) != 1) {
+        return -2;
+    }
+    return gcdSessionLearn(table, &view, nowNs);
+}
+
+/* count of teids[0, n) gcdSessionFind() knows */
+static uint32_t findAll(gcd_session_table_t *table, uint32_t first,
+                        uint32_t n, uint64_t nowNs)
+{
+    uint32_t hits = 0;
+    for (uint32_t teid = first; teid < first + n; teid++) {
+        hits += gcdSessionFind(table, teid, NULL, nowNs);
+    }
+    return hits;
+}
+
+#define SESSION_CHECK(cond)                                                  \
+    ((cond) ? 0 : fprintf(stderr, "session: %s\n", #cond) > 0)
+
+/*
+ * learn, find, expire and miss on a table of 4 shards of 16 entries, so
+ * TEIDs share shards and probe chains, then re-learn what expired and
+ * overflow a shard into eviction
+ */
+static int checkSessions()
+{
+    int failed = 0;
+    gcd_session_t s;
+    gcd_session_stats_t st;
+    gcd_session_table_t *t = gcdSessionTableCreate(
+        &(gcd_session_conf_t){.maxSessions = 64, .shards = 4, .idleNs = 10});
+    if (!t) {
+        abort();
+    }
+
+    failed += SESSION_CHECK(learnV2(32, 0, 1, 0, t) == 1);
+    failed += SESSION_CHECK(learnV2(33, 1, 2, 1, t) == 1);
+    failed += SESSION_CHECK(gcdSessionFind(t, 2, &s, 2) == 1);
+    failed += SESSION_CHECK(s.requesterTeid == 1 && s.responderTeid == 2
+                            && s.imsi == 460001200000001ULL);
+    failed += SESSION_CHECK(learnV2(33, 99, 100, 2, t) == -1);
+
+    // 24 requests on 4 shards, at least 6 land in one
+    for (uint32_t teid = 10; teid < 34; teid++) {
+        failed += SESSION_CHECK(learnV2(32, 0, teid, teid < 22 ? 3 : 9, t)
+                                == 1);
+    }
+    failed += SESSION_CHECK(findAll(t, 10, 12, 3) == 12);
+    failed += SESSION_CHECK(findAll(t, 22, 12, 9) == 12);
+
+    // 1, 2 and 10 to 21 idle since 3 at most, removed from shared chains
+    failed += SESSION_CHECK(gcdSessionExpire(t, 18) == 14);
+    failed += SESSION_CHECK(findAll(t, 1, 2, 18) == 0);
+    failed += SESSION_CHECK(findAll(t, 10, 12, 18) == 0);
+    failed += SESSION_CHECK(findAll(t, 22, 12, 18) == 12);
+    failed += SESSION_CHECK(learnV2(33, 1, 2, 18, t) == -1);
+
+    failed += SESSION_CHECK(learnV2(32, 0, 1, 19, t) == 1);
+    failed += SESSION_CHECK(gcdSessionFind(t, 1, &s, 19) == 1);
+    failed += SESSION_CHECK(s.responderTeid == 0);
+    gcdSessionTableStats(t, &st);
+    failed += SESSION_CHECK(st.entries == 13 && st.expired == 14);
+
+    // 4 times the capacity, the most recent 16 fit whatever their shard
+    for (uint32_t teid = 1000; teid < 1256; teid++) {
+        learnV2(32, 0, teid, 20, t);
+    }
+    failed += SESSION_CHECK(findAll(t, 1240, 16, 20) == 16);
+    gcdSessionTableStats(t, &st);
+    failed += SESSION_CHECK(st.entries == 64 && st.evicted > 0);
+    gcdSessionTableDestroy(t);
+    return failed;
+}
+
+#undef SESSION_CHECK
+
+static void addFile(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    if (nmsgs < MAX_MSGS) {
+        msg_t *m = &msgs[nmsgs];
+        m->len = fread(m->data, 1, MAX_MSG_LEN, f);
+        decodeAll(m->data, m->len);
+        nmsgs++;
+    }
+    fclose(f);
+}
+
+static void addPath(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) || !S_ISDIR(st.st_mode)) {
+        addFile(path);
+        return;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return;
+    }
+    for (struct dirent *e; (e = readdir(dir));) {
+        if (e->d_name[0] != '.') {
+            char file[4096];
+            snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+            addFile(file);
+        }
+    }
+    closedir(dir);
+}
+
+/* flip bytes, hit length fields and cut or extend a copy of a message */
+static uint32_t mutate(const msg_t *seed, uint8_t *out)
+{
+    uint32_t len = seed->len;
+    memcpy(out, seed->data, len);
+    for (int k = 1 + rand() % 4; k > 0; k--) {
+        uint32_t at = len ? rand() % len : 0;
+        switch (rand() % 5) {
+        case 0:
+            if (len) {
+                out[at] ^= 1 << (rand() % 8);
+            }
+            break;
+        case 1:
+            if (len) {
+                out[at] = rand();
+            }
+            break;
+        case 2: // a length field or a type byte going big
+            if (at + 1 < len) {
+                out[at] = 0xff;
+                out[at + 1] = rand() % 2 ? 0xff : rand();
+            }
+            break;
+        case 3:
+            len = len ? rand() % len : 0;
+            break;
+        default:
+            while (len < MAX_MSG_LEN && rand() % 4) {
+                out[len++] = rand();
+            }
+            break;
+        }
+    }
+    return len;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long iterations = 0;
+    unsigned seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-n iterations] [-s seed] [file|dir...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    init();
+    int failed = runRegressions() + addEncoded() + checkSessions();
+    for (int i = optind; i < argc; i++) {
+        addPath(argv[i]);
+    }
+    srand(seed);
+    static uint8_t buf[MAX_MSG_LEN];
+    for (unsigned long i = 0; i < iterations; i++) {
+        uint32_t len = mutate(&msgs[rand() % nmsgs], buf);
+        decodeAll(buf, len);
+    }
+    gcdColumnBatchDestroy(columns);
+    gcdSessionTableDestroy(sessions);
+    fprintf(stderr, "%u messages, %lu mutations, %d failed\n", nmsgs,
+            iterations, failed);
+    return failed != 0;
+}
+
+#endif
@@ -0,0 +1,632 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gtpc-encoder.h"
+
+/*
+ * gcd-gen: synthetic gtpc load, request/response transactions of a
+ * subscriber population
+ *
+ *   gcd-gen [-v 1|2] [-n transactions] [-r msgs/s] [-s subscribers]
+ *           [-p peers] [-l latency us] [-m mix] -o file.pcap | -u host:port
+ *
+ * the mix weighs the transaction kinds, eg. "create=1,modify=6,delete=1,
+ * echo=1". -o writes an ethernet pcap with nanosecond timestamps, spaced
+ * by the rate (default 100000 msgs/s). -u sends the messages to a udp
+ * socket at the rate, 0 for as fast as possible.
+ */
+
+#define MAX_MSG_LEN  512
+#define FRAME_HDR    42 // ethernet, ipv4 and udp
+#define SEND_BATCH   64
+#define MAX_PENDING  4096
+#define GTPC_PORT    2123
+
+enum kind { CREATE, MODIFY, DELETE, ECHO, KINDS };
+static const char *kindNames[KINDS] = {"create", "modify", "delete", "echo"};
+/* request types per version, the response is the next type */
+static const uint8_t requestTypes[3][KINDS] = {
+    {0},
+    {16, 18, 20, 1},
+    {32, 34, 36, 1},
+};
+
+typedef struct msg_s {
+    uint8_t frame[FRAME_HDR + MAX_MSG_LEN];
+    uint32_t len; // of the gtpc message
+    uint64_t tsNs;
+    uint32_t src;
+    uint32_t dst;
+} msg_t;
+
+typedef struct gen_s {
+    uint8_t version;
+    uint64_t transactions;
+    uint64_t rate;
+    uint32_t subscribers;
+    uint32_t peers;
+    uint64_t latencyNs;
+    uint32_t weights[KINDS];
+    uint32_t weightSum;
+    uint64_t rng;
+    uint32_t sqn;
+    FILE *pcap;
+    int sock;
+    /* responses wait here until their time comes, latency is constant */
+    msg_t pending[MAX_PENDING];
+    uint32_t head;
+    uint32_t count;
+    uint8_t batch[SEND_BATCH][MAX_MSG_LEN];
+    uint32_t batchLen[SEND_BATCH];
+    uint32_t batched;
+    uint64_t sent;
+    uint64_t refused; // icmp unreachable reported by a send, retried
+    uint64_t startNs;
+} gen_t;
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t xorshift(gen_t *g)
+{
+    g->rng ^= g->rng << 13;
+    g->rng ^= g->rng >> 7;
+    g->rng ^= g->rng << 17;
+    return g->rng;
+}
+
+/* 15 digit imsi of mcc 001, mnc 01 */
+static void subscriberImsi(uint32_t sub, char *imsi)
+{
+    memcpy(imsi, "00101", 5);
+    for (int i = 14; i >= 5; i--) {
+        imsi[i] = '0' + sub % 10;
+        sub /= 10;
+    }
+    imsi[15] = 0;
+}
+
+static void subscriberMsisdn(uint32_t sub, char *msisdn)
+{
+    memcpy(msisdn, "86", 2);
+    for (int i = 12; i >= 2; i--) {
+        msisdn[i] = '0' + sub % 10;
+        sub /= 10;
+    }
+    msisdn[13] = 0;
+}
+
+static void fteid(gtp_v2_fteid_t *f, uint8_t ifType, uint32_t teid,
+                  uint32_t addr)
+{
+    memset(f, 0, sizeof(*f));
+    f->present = 1;
+    f->ifType = ifType;
+    f->hasIpv4 = 1;
+    f->teid = teid;
+    memcpy(f->ipv4, &addr, 4);
+}
+
+static void encodeCause(gcd_encoder_t *enc, uint8_t version)
+{
+    static const uint8_t accepted[2] = {16, 0};
+    static const uint8_t v1Accepted = 128;
+    if (version == 2) {
+        gcdEncodeTlv(enc, GTPV2_CAUSE, 0, accepted, 2);
+    } else {
+        gcdEncodeTv(enc, GTPV1_CAUSE, &v1Accepted, 1);
+    }
+}
+
+static void encodeU32Tv(gcd_encoder_t *enc, uint8_t type, uint32_t value)
+{
+    value = htonl(value);
+    gcdEncodeTv(enc, type, &value, 4);
+}
+
+static void encodeV1(gcd_encoder_t *enc, int kind, int response, uint32_t sub,
+                     uint32_t mme, uint32_t pgw)
+{
+    static const uint8_t qos[4] = {2, 0x0B, 0x92, 0x1F};
+    static const uint8_t eua[2] = {0xF1, 0x21};
+    char digits[16];
+    uint8_t v[6];
+    uint32_t teid = response ? 2 * sub + 2 : 2 * sub + 1;
+    uint32_t gsn = response ? pgw : mme;
+    if (kind == ECHO) {
+        v[0] = 1;
+        gcdEncodeTv(enc, GTPV1_RECOVERY, v, 1);
+        return;
+    }
+    if (response) {
+        encodeCause(enc, 1);
+    }
+    if (kind == CREATE && !response) {
+        subscriberImsi(sub, digits);
+        gcdEncodeDigits(enc, GTPV1_IMSI, 0, digits);
+        v[0] = 0xFC; // selection mode 0
+        gcdEncodeTv(enc, GTPV1_SELECTION_MODE, v, 1);
+    }
+    if (kind != DELETE) {
+        encodeU32Tv(enc, GTPV1_TEID_DATA_I, teid + 0x80000000);
+        encodeU32Tv(enc, GTPV1_TEID_CONTROL_PLANE, teid);
+    }
+    if (!response) { // mandatory in create, update and delete requests
+        v[0] = 5;
+        gcdEncodeTv(enc, GTPV1_NSAPI, v, 1);
+    }
+    if (kind == CREATE && response) {
+        encodeU32Tv(enc, GTPV1_CHARGING_ID, sub);
+        memcpy(v, eua, 2);
+        uint32_t ue = htonl(0x64400000 + sub); // 100.64.0.0/10
+        memcpy(v + 2, &ue, 4);
+        gcdEncodeTlv(enc, GTPV1_END_USER_ADDRESS, 0, v, 6);
+    } else if (kind == CREATE) {
+        gcdEncodeTlv(enc, GTPV1_END_USER_ADDRESS, 0, eua, 2);
+        gcdEncodeApn(enc, GTPV1_ACCESS_POINT_NAME, 0,
+                     "internet.mnc001.mcc001.gprs");
+    }
+    if (kind != DELETE) {
+        gcdEncodeTlv(enc, GTPV1_GSN_ADDRESS, 0, &gsn, 4); // signalling
+        gcdEncodeTlv(enc, GTPV1_GSN_ADDRESS, 0, &gsn, 4); // user traffic
+    }
+    if (kind == CREATE && !response) {
+        subscriberMsisdn(sub, digits);
+        gcdEncodeDigits(enc, GTPV1_MSISDN, 0, digits);
+    }
+    if (kind != DELETE) {
+        gcdEncodeTlv(enc, GTPV1_QUALITY_OF_SERVICE, 0, qos, 4);
+    }
+    if (kind == CREATE && !response) {
+        v[0] = 1; // UTRAN
+        gcdEncodeTlv(enc, GTPV1_RAT_TYPE, 0, v, 1);
+    }
+}
+
+static void encodeBearerQos(gcd_encoder_t *enc)
+{
+    uint8_t qos[22] = {0x24, 9};
+    gcdEncodeTlv(enc, GTPV2_BEARER_QOS, 0, qos, 22);
+}
+
+static void encodeV2(gcd_encoder_t *enc, int kind, int response, uint32_t sub,
+                     uint32_t mme, uint32_t pgw)
+{
+    static const uint8_t ebi = 5;
+    char digits[16];
+    uint8_t v[22];
+    gtp_v2_fteid_t f;
+    if (kind == ECHO) {
+        v[0] = 1;
+        gcdEncodeTlv(enc, GTPV2_RECOVERY, 0, v, 1);
+        return;
+    }
+    if (response) {
+        encodeCause(enc, 2);
+    }
+    switch (kind) {
+    case CREATE:
+        if (!response) {
+            subscriberImsi(sub, digits);
+            gcdEncodeDigits(enc, GTPV2_IMSI, 0, digits);
+            subscriberMsisdn(sub, digits);
+            gcdEncodeDigits(enc, GTPV2_MSISDN, 0, digits);
+            v[0] = 0x18; // TAI and ECGI
+            memcpy(v + 1, "\x00\xf1\x10\x00\x01", 5);
+            memcpy(v + 6, "\x00\xf1\x10\x00\x00\x01\x01", 7);
+            gcdEncodeTlv(enc, GTPV2_ULI, 0, v, 13);
+            gcdEncodeTlv(enc, GTPV2_SERVING_NETWORK, 0, "\x00\xf1\x10", 3);
+            v[0] = 6; // EUTRAN
+            gcdEncodeTlv(enc, GTPV2_RAT_TYPE, 0, v, 1);
+            fteid(&f, 10, 2 * sub + 1, mme); // S11 MME
+            gcdEncodeFteid(enc, 0, &f);
+            gcdEncodeApn(enc, GTPV2_APN, 0, "internet");
+            v[0] = 0;
+            gcdEncodeTlv(enc, GTPV2_SELECTION_MODE, 0, v, 1);
+            v[0] = 1;
+            gcdEncodeTlv(enc, GTPV2_PDN_TYPE, 0, v, 1); // IPv4
+            memset(v, 0, 5);
+            v[0] = 1;
+            gcdEncodeTlv(enc, GTPV2_PAA, 0, v, 5); // 0.0.0.0
+        } else {
+            fteid(&f, 11, 2 * sub + 2, pgw); // S11/S4 SGW
+            gcdEncodeFteid(enc, 0, &f);
+            uint32_t ue = htonl(0x64400000 + sub);
+            v[0] = 1;
+            memcpy(v + 1, &ue, 4);
+            gcdEncodeTlv(enc, GTPV2_PAA, 0, v, 5);
+        }
+        memcpy(v, "\x00\x00\xc3\x50\x00\x01\x86\xa0", 8);
+        gcdEncodeTlv(enc, GTPV2_AMBR, 0, v, 8); // 50/100 Mbps
+        gcdEncodeGroupBegin(enc, GTPV2_BEARER_CONTEXT, 0);
+        gcdEncodeTlv(enc, GTPV2_EBI, 0, &ebi, 1);
+        if (response) {
+            encodeCause(enc, 2);
+            fteid(&f, 1, 2 * sub + 0x80000002, pgw); // S1-U SGW
+            gcdEncodeFteid(enc, 0, &f);
+        } else {
+            encodeBearerQos(enc);
+        }
+        gcdEncodeGroupEnd(enc);
+        break;
+    case MODIFY:
+        gcdEncodeGroupBegin(enc, GTPV2_BEARER_CONTEXT, 0);
+        gcdEncodeTlv(enc, GTPV2_EBI, 0, &ebi, 1);
+        if (response) {
+            encodeCause(enc, 2);
+        } else {
+            fteid(&f, 0, 2 * sub + 0x80000001, mme); // S1-U eNodeB
+            gcdEncodeFteid(enc, 0, &f);
+        }
+        gcdEncodeGroupEnd(enc);
+        break;
+    case DELETE:
+        if (!response) {
+            gcdEncodeTlv(enc, GTPV2_EBI, 0, &ebi, 1); // linked bearer
+        }
+        break;
+    }
+}
+
+/* ethernet, ipv4 and udp headers in front of a message */
+static void frameHeaders(msg_t *m)
+{
+    uint8_t *p = m->frame;
+    uint16_t ipLen = 20 + 8 + m->len;
+    memset(p, 0, 12);
+    p[12] = 0x08;
+    p[13] = 0x00;
+    p += 14;
+    p[0] = 0x45;
+    p[1] = 0;
+    p[2] = ipLen >> 8;
+    p[3] = ipLen;
+    memset(p + 4, 0, 4);
+    p[8] = 64;
+    p[9] = 17;
+    memcpy(p + 12, &m->src, 4);
+    memcpy(p + 16, &m->dst, 4);
+    uint32_t sum = 0;
+    p[10] = p[11] = 0;
+    for (int i = 0; i < 20; i += 2) {
+        sum += p[i] << 8 | p[i + 1];
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = ~((sum & 0xFFFF) + (sum >> 16));
+    p[10] = sum >> 8;
+    p[11] = sum;
+    p += 20;
+    p[0] = GTPC_PORT >> 8;
+    p[1] = GTPC_PORT & 0xFF;
+    p[2] = GTPC_PORT >> 8;
+    p[3] = GTPC_PORT & 0xFF;
+    p[4] = (8 + m->len) >> 8;
+    p[5] = 8 + m->len;
+    p[6] = p[7] = 0; // no udp checksum
+}
+
+static int writePcapHeader(FILE *f)
+{
+    struct {
+        uint32_t magic;
+        uint16_t major, minor;
+        int32_t zone;
+        uint32_t sigfigs, snaplen, linktype;
+    } h = {0xa1b23c4d, 2, 4, 0, 0, 65535, 1}; // nanosecond timestamps
+    return fwrite(&h, sizeof(h), 1, f) == 1 ? 0 : -1;
+}
+
+static int flushBatch(gen_t *g)
+{
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec iov[SEND_BATCH];
+    uint32_t n = g->batched, done = 0;
+    if (n == 0) {
+        return 0;
+    }
+    if (g->rate) {
+        // pace the batch to the time of its first message
+        uint64_t due = g->startNs + g->sent * 1000000000ULL / g->rate;
+        uint64_t now = nowNs();
+        if (due > now) {
+            struct timespec ts = {(due - now) / 1000000000ULL,
+                                  (due - now) % 1000000000ULL};
+            nanosleep(&ts, NULL);
+        }
+    }
+    memset(msgs, 0, sizeof(msgs[0]) * n);
+    for (uint32_t i = 0; i < n; i++) {
+        iov[i].iov_base = g->batch[i];
+        iov[i].iov_len = g->batchLen[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (done < n) {
+        int ret = sendmmsg(g->sock, msgs + done, n - done, 0);
+        if (ret < 0 && errno == ECONNREFUSED) {
+            g->refused++; // nobody listens yet, the error is cleared
+            continue;
+        }
+        if (ret < 0) {
+            perror("sendmmsg");
+            return -1;
+        }
+        done += ret;
+    }
+    g->sent += n;
+    g->batched = 0;
+    return 0;
+}
+
+static int emit(gen_t *g, msg_t *m)
+{
+    if (g->pcap) {
+        uint32_t caplen = FRAME_HDR + m->len;
+        uint32_t rec[4] = {m->tsNs / 1000000000ULL, m->tsNs % 1000000000ULL,
+                           caplen, caplen};
+        frameHeaders(m);
+        if (fwrite(rec, sizeof(rec), 1, g->pcap) != 1
+            || fwrite(m->frame, caplen, 1, g->pcap) != 1) {
+            perror("write");
+            return -1;
+        }
+        g->sent++;
+        return 0;
+    }
+    memcpy(g->batch[g->batched], m->frame + FRAME_HDR, m->len);
+    g->batchLen[g->batched++] = m->len;
+    return g->batched == SEND_BATCH ? flushBatch(g) : 0;
+}
+
+/* hand out the responses due before tsNs, oldest first */
+static int drain(gen_t *g, uint64_t tsNs)
+{
+    while (g->count && g->pending[g->head].tsNs <= tsNs) {
+        if (emit(g, &g->pending[g->head]) < 0) {
+            return -1;
+        }
+        g->head = (g->head + 1) % MAX_PENDING;
+        g->count--;
+    }
+    return 0;
+}
+
+static int buildMessage(gen_t *g, msg_t *m, int kind, int response,
+                        uint32_t sub)
+{
+    gcd_encoder_t enc;
+    uint32_t peer = sub % g->peers;
+    uint32_t mme = htonl(0x0A010000 + peer + 1); // 10.1.x.x
+    uint32_t pgw = htonl(0x0A020000 + peer + 1); // 10.2.x.x
+    gtp_header_t hdr = {.version = g->version,
+                        .msgType = requestTypes[g->version][kind] + response,
+                        .sqn = g->sqn & (g->version == 2 ? 0xFFFFFF : 0xFFFF)};
+    // requests go to the peer's TEID, a create request has none yet
+    if (kind != ECHO && !(kind == CREATE && !response)) {
+        hdr.teid = response ? 2 * sub + 1 : 2 * sub + 2;
+    }
+    gcdEncodeBegin(&enc, m->frame + FRAME_HDR, MAX_MSG_LEN, &hdr);
+    if (g->version == 1) {
+        encodeV1(&enc, kind, response, sub, mme, pgw);
+    } else {
+        encodeV2(&enc, kind, response, sub, mme, pgw);
+    }
+    int len = gcdEncodeEnd(&enc);
+    if (len < 0) {
+        return -1;
+    }
+    m->len = len;
+    m->src = response ? pgw : mme;
+    m->dst = response ? mme : pgw;
+    return 0;
+}
+
+static int pickKind(gen_t *g)
+{
+    uint32_t r = xorshift(g) % g->weightSum;
+    for (int k = 0; k < KINDS; k++) {
+        if (r < g->weights[k]) {
+            return k;
+        }
+        r -= g->weights[k];
+    }
+    return ECHO;
+}
+
+static int run(gen_t *g)
+{
+    static msg_t request;
+    uint64_t spacing = g->rate ? 1000000000ULL / g->rate : 0;
+    uint64_t ts = 1700000000ULL * 1000000000ULL;
+    g->startNs = nowNs();
+    for (uint64_t i = 0; i < g->transactions; i++, g->sqn++) {
+        int kind = pickKind(g);
+        uint32_t sub = xorshift(g) % g->subscribers;
+        if (drain(g, ts) < 0) {
+            return -1;
+        }
+        if (g->count == MAX_PENDING) {
+            // latency longer than the queue covers, answer right away
+            if (drain(g, UINT64_MAX) < 0) {
+                return -1;
+            }
+        }
+        msg_t *rsp = &g->pending[(g->head + g->count) % MAX_PENDING];
+        if (buildMessage(g, &request, kind, 0, sub) < 0
+            || buildMessage(g, rsp, kind, 1, sub) < 0) {
+            fprintf(stderr, "message does not fit %u bytes\n", MAX_MSG_LEN);
+            return -1;
+        }
+        request.tsNs = ts;
+        rsp->tsNs = ts + g->latencyNs;
+        g->count++;
+        if (emit(g, &request) < 0) {
+            return -1;
+        }
+        ts += 2 * spacing;
+    }
+    if (drain(g, UINT64_MAX) < 0) {
+        return -1;
+    }
+    return g->pcap ? 0 : flushBatch(g);
+}
+
+static int parseMix(gen_t *g, char *mix)
+{
+    memset(g->weights, 0, sizeof(g->weights));
+    g->weightSum = 0;
+    for (char *tok = strtok(mix, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        int k = 0;
+        if (!eq) {
+            return -1;
+        }
+        *eq = 0;
+        while (k < KINDS && strcmp(tok, kindNames[k])) {
+            k++;
+        }
+        if (k == KINDS) {
+            return -1;
+        }
+        g->weights[k] = atoi(eq + 1);
+        g->weightSum += g->weights[k];
+    }
+    return g->weightSum ? 0 : -1;
+}
+
+static int openUdp(const char *target)
+{
+    char host[256];
+    const char *colon = strrchr(target, ':');
+    struct addrinfo hints = {.ai_socktype = SOCK_DGRAM}, *ai;
+    if (!colon || colon - target >= (long)sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, target, colon - target);
+    host[colon - target] = 0;
+    if (getaddrinfo(host, colon + 1, &hints, &ai)) {
+        return -1;
+    }
+    int fd = socket(ai->ai_family, SOCK_DGRAM, 0);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-v 1|2] [-n transactions] [-r msgs/s] "
+            "[-s subscribers]\n"
+            "       [-p peers] [-l latency us] [-m mix] "
+            "-o file.pcap | -u host:port\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static gen_t g;
+    char mix[] = "create=1,modify=6,delete=1,echo=1";
+    const char *out = NULL, *target = NULL;
+    int opt, ret = 0;
+    g.version = 2;
+    g.transactions = 100000;
+    g.rate = 100000;
+    g.subscribers = 100000;
+    g.peers = 1;
+    g.latencyNs = 2000000;
+    g.rng = 0x9E3779B97F4A7C15ULL;
+    g.sock = -1;
+    parseMix(&g, mix);
+    while ((opt = getopt(argc, argv, "v:n:r:s:p:l:m:o:u:h")) != -1) {
+        switch (opt) {
+        case 'v':
+            g.version = atoi(optarg);
+            break;
+        case 'n':
+            g.transactions = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            g.rate = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            g.subscribers = atoi(optarg);
+            break;
+        case 'p':
+            g.peers = atoi(optarg);
+            break;
+        case 'l':
+            g.latencyNs = strtoull(optarg, NULL, 10) * 1000;
+            break;
+        case 'm':
+            if (parseMix(&g, optarg) < 0) {
+                fprintf(stderr, "bad mix %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'u':
+            target = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((g.version != 1 && g.version != 2) || !g.subscribers || !g.peers
+        || g.subscribers > 2000000000U || !out == !target) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (out) {
+        if (!g.rate) {
+            g.rate = 100000; // timestamps need a spacing
+        }
+        g.pcap = strcmp(out, "-") ? fopen(out, "wb") : stdout;
+        if (!g.pcap || writePcapHeader(g.pcap) < 0) {
+            perror(out);
+            return 1;
+        }
+    } else if ((g.sock = openUdp(target)) < 0) {
+        fprintf(stderr, "%s: can not resolve or connect\n", target);
+        return 1;
+    }
+
+    uint64_t start = nowNs();
+    if (run(&g) < 0) {
+        ret = 1;
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    if (g.pcap && fclose(g.pcap)) {
+        perror(out);
+        ret = 1;
+    }
+    if (g.sock >= 0) {
+        close(g.sock);
+    }
+    fprintf(stderr, "%lu messages in %.2f s, %.0f msgs/s\n",
+            (unsigned long)g.sent, elapsed,
+            elapsed > 0 ? g.sent / elapsed : 0.0);
+    if (g.refused) {
+        fprintf(stderr, "%lu sends refused by the target\n",
+                (unsigned long)g.refused);
+    }
+    return ret;
+}
@@ -0,0 +1,483 @@
+#include "gtpc-capture.h"
+
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define GCD_CACHE_LINE 64
+
+#define DEFAULT_BLOCK_SIZE (1 << 20)
+#define DEFAULT_BLOCKS     64
+#define DEFAULT_TIMEOUT_MS 10
+#define DEFAULT_BATCH      64
+#define FRAME_SIZE         2048 // only a hint to the kernel for TPACKET_V3
+#define SNAPLEN            65535
+#define RUN_POLL_MS        100
+
+typedef struct ring_s {
+    int fd;
+    uint8_t *map;
+    uint32_t block; // next block to read
+    gcd_payload_t *payloads;
+    gcd_reasm_t *reasm;
+    gcd_capture_stats_t stats; // updated once per block
+} __attribute__((aligned(GCD_CACHE_LINE))) ring_t;
+
+struct gcd_capture_s {
+    ring_t *rings;
+    uint32_t nrings;
+    uint32_t blockSize;
+    uint32_t blocks;
+    uint32_t batch;
+    int loopback; // lo shows every packet twice, once outgoing
+    int stop;
+};
+
+typedef struct runner_s {
+    gcd_capture_t *capture;
+    uint32_t ring;
+    onGtpcBatch cb;
+    void *arg;
+    int ret;
+} runner_t;
+
+/*
+ * udp from or to port 2123/3386 over untagged IPv4/IPv6, IPv4 fragments
+ * past the first and IPv6 with extension headers, whose ports are not at a
+ * fixed offset, and any VLAN/QinQ/MPLS frame: gcdLocateGtpc() looks behind
+ * all of those. offloaded tags are not in the frame and never seen here
+ */
+static struct sock_filter gtpcFilter[] = {
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETHERTYPE_IP, 0, 11),
+    /* IPv4 */
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 29),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+    BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 26, 0),
+    BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+    BPF_STMT(BPF_LD | BPF_H | BPF_IND, 14),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTPC_PORT, 23, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTP_PRIME_PORT, 22, 0),
+    BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTPC_PORT, 20, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTP_PRIME_PORT, 19, 20),
+    /* IPv6 */
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETHERTYPE_IPV6, 0, 13),
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 20),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 6),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 54),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTPC_PORT, 14, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTP_PRIME_PORT, 13, 0),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 56),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTPC_PORT, 11, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, GTP_PRIME_PORT, 10, 11),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_FRAGMENT, 9, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_HOPOPTS, 8, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ROUTING, 7, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_DSTOPTS, 6, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_AH, 5, 6),
+    /* tagged or labeled */
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETHERTYPE_VLAN, 4, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x88A8, 3, 0), // 802.1ad
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x9100, 2, 0), // old QinQ
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x8847, 1, 0), // MPLS unicast
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x8848, 0, 1), // MPLS multicast
+    BPF_STMT(BPF_RET | BPF_K, SNAPLEN),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+static void closeRing(gcd_capture_t *c, ring_t *r)
+{
+    if (r->map && r->map != MAP_FAILED) {
+        munmap(r->map, (size_t)c->blockSize * c->blocks);
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    free(r->payloads);
+    gcdReasmDestroy(r->reasm);
+}
+
+static int openRing(gcd_capture_t *c, ring_t *r, const gcd_capture_conf_t *conf,
+                    int ifindex, int fanout)
+{
+    r->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (r->fd < 0) {
+        return -1;
+    }
+    int version = TPACKET_V3;
+    struct sock_fprog prog = {
+        .len = sizeof(gtpcFilter) / sizeof(gtpcFilter[0]),
+        .filter = gtpcFilter,
+    };
+    struct tpacket_req3 req = {
+        .tp_block_size = c->blockSize,
+        .tp_block_nr = c->blocks,
+        .tp_frame_size = FRAME_SIZE,
+        .tp_frame_nr = c->blockSize / FRAME_SIZE * c->blocks,
+        .tp_retire_blk_tov = conf->blockTimeoutMs ? conf->blockTimeoutMs
+                                                  : DEFAULT_TIMEOUT_MS,
+    };
+    /* the filter goes first so nothing unfiltered is queued before bind */
+    if (setsockopt(r->fd, SOL_PACKET, PACKET_VERSION, &version,
+                   sizeof(version)) < 0
+        || setsockopt(r->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+                      sizeof(prog)) < 0
+        || setsockopt(r->fd, SOL_PACKET, PACKET_RX_RING, &req,
+                      sizeof(req)) < 0) {
+        return -1;
+    }
+    r->map = mmap(NULL, (size_t)c->blockSize * c->blocks,
+                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, r->fd, 0);
+    if (r->map == MAP_FAILED) {
+        r->map = mmap(NULL, (size_t)c->blockSize * c->blocks,
+                      PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+        if (r->map == MAP_FAILED) {
+            return -1;
+        }
+    }
+    struct sockaddr_ll addr = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(ETH_P_ALL),
+        .sll_ifindex = ifindex,
+    };
+    if (bind(r->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        return -1;
+    }
+    if (conf->promisc) {
+        struct packet_mreq mr = {
+            .mr_ifindex = ifindex,
+            .mr_type = PACKET_MR_PROMISC,
+        };
+        if (setsockopt(r->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr,
+                       sizeof(mr)) < 0) {
+            return -1;
+        }
+    }
+    if ((c->nrings > 1 || conf->fanoutGroup)
+        && setsockopt(r->fd, SOL_PACKET, PACKET_FANOUT, &fanout,
+                      sizeof(fanout)) < 0) {
+        return -1;
+    }
+    if (conf->reassembly && !(r->reasm = gcdReasmCreate(conf->reassembly))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    r->payloads = malloc(sizeof(*r->payloads) * c->batch);
+    return r->payloads ? 0 : -1;
+}
+
+/* the link type of the interface, only ethernet framing is supported */
+static int checkLink(const char *ifname, int *ifindex, int *loopback)
+{
+    struct ifreq ifr;
+    if (strlen(ifname) >= sizeof(ifr.ifr_name)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strcpy(ifr.ifr_name, ifname);
+    int ret = -1;
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) == 0) {
+        *ifindex = ifr.ifr_ifindex;
+        if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0) {
+            int type = ifr.ifr_hwaddr.sa_family;
+            *loopback = type == ARPHRD_LOOPBACK;
+            if (type == ARPHRD_ETHER || type == ARPHRD_LOOPBACK) {
+                ret = 0;
+            } else {
+                errno = EPROTONOSUPPORT;
+            }
+        }
+    }
+    int err = errno;
+    close(fd);
+    errno = err;
+    return ret;
+}
+
+gcd_capture_t *gcdCaptureOpen(const gcd_capture_conf_t *conf)
+{
+    int ifindex, loopback;
+    if (!conf->ifname || checkLink(conf->ifname, &ifindex, &loopback) < 0) {
+        if (!conf->ifname) {
+            errno = EINVAL;
+        }
+        return NULL;
+    }
+    gcd_capture_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        return NULL;
+    }
+    c->nrings = conf->rings ? conf->rings : 1;
+    c->blockSize = conf->blockSize ? conf->blockSize : DEFAULT_BLOCK_SIZE;
+    c->blocks = conf->blocks ? conf->blocks : DEFAULT_BLOCKS;
+    c->batch = conf->batch ? conf->batch : DEFAULT_BATCH;
+    c->loopback = loopback;
+    if (c->blockSize % (uint32_t)getpagesize() || c->blockSize < FRAME_SIZE) {
+        free(c);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (posix_memalign((void **)&c->rings, GCD_CACHE_LINE,
+                       sizeof(*c->rings) * c->nrings)) {
+        free(c);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(c->rings, 0, sizeof(*c->rings) * c->nrings);
+    for (uint32_t i = 0; i < c->nrings; i++) {
+        c->rings[i].fd = -1;
+    }
+
+    /*
+     * the symmetric flow hash keeps a request and its response on one
+     * ring, a matcher per ring needs no lock
+     */
+    uint16_t group = conf->fanoutGroup ? conf->fanoutGroup
+                                       : (uint16_t)getpid();
+    uint16_t mode = conf->fanoutMode ? conf->fanoutMode : PACKET_FANOUT_HASH;
+    int fanout = group | (mode << 16);
+    for (uint32_t i = 0; i < c->nrings; i++) {
+        if (openRing(c, &c->rings[i], conf, ifindex, fanout) < 0) {
+            int err = errno;
+            gcdCaptureClose(c);
+            errno = err;
+            return NULL;
+        }
+    }
+    return c;
+}
+
+void gcdCaptureClose(gcd_capture_t *capture)
+{
+    if (!capture) {
+        return;
+    }
+    for (uint32_t i = 0; i < capture->nrings; i++) {
+        closeRing(capture, &capture->rings[i]);
+    }
+    free(capture->rings);
+    free(capture);
+}
+
+/* the reassembler belongs to the polling thread, stats readers get a copy */
+static void publishReasm(ring_t *r)
+{
+    gcd_reasm_stats_t rs;
+    gcd_reasm_stats_t *dst = &r->stats.reasm;
+    gcdReasmStats(r->reasm, &rs);
+    __atomic_store_n(&dst->fragments, rs.fragments, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->reassembled, rs.reassembled, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->timeouts, rs.timeouts, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->evicted, rs.evicted, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->invalid, rs.invalid, __ATOMIC_RELAXED);
+}
+
+/*
+ * locate the payloads of every frame of a block, cb sees them while the
+ * block still belongs to us
+ * @return
+ *   0 to continue, what cb returned otherwise
+ */
+static int walkBlock(gcd_capture_t *c, ring_t *r,
+                     struct tpacket_block_desc *bd, onGtpcBatch cb,
+                     void *arg, uint32_t *delivered)
+{
+    uint32_t frames = bd->hdr.bh1.num_pkts;
+    uint64_t bytes = 0, malformed = 0;
+    uint32_t n = 0;
+    int stop = 0;
+    uint8_t *first = (uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt;
+    struct tpacket3_hdr *h = (struct tpacket3_hdr *)first;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        uint8_t *frame = (uint8_t *)h + h->tp_mac;
+        struct sockaddr_ll *sll = (struct sockaddr_ll *)((uint8_t *)h
+            + TPACKET_ALIGN(sizeof(*h)));
+        bytes += h->tp_snaplen;
+        if (!c->loopback || sll->sll_pkttype != PACKET_OUTGOING) {
+            gcd_payload_t *out = &r->payloads[n];
+            uint64_t ts = (uint64_t)h->tp_sec * 1000000000ULL + h->tp_nsec;
+            int found = r->reasm
+                            ? gcdReasmLocate(r->reasm, frame, h->tp_snaplen,
+                                             GCD_LINKTYPE_ETHERNET, ts, out)
+                            : gcdLocateGtpc(frame, h->tp_snaplen,
+                                            GCD_LINKTYPE_ETHERNET, out);
+            if (found > 0) {
+                out->tsNs = ts;
+                if (++n == c->batch) {
+                    *delivered += n;
+                    stop = cb(r->payloads, n, arg);
+                    n = 0;
+                    if (r->reasm) {
+                        gcdReasmRelease(r->reasm);
+                    }
+                    if (stop) {
+                        break;
+                    }
+                }
+            } else if (found < 0) {
+                malformed++;
+            }
+        }
+        h = (struct tpacket3_hdr *)((uint8_t *)h + h->tp_next_offset);
+    }
+    if (n && !stop) {
+        *delivered += n;
+        stop = cb(r->payloads, n, arg);
+    }
+    if (r->reasm) {
+        gcdReasmRelease(r->reasm);
+        publishReasm(r);
+    }
+    __atomic_fetch_add(&r->stats.frames, frames, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->stats.bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->stats.malformed, malformed, __ATOMIC_RELAXED);
+    return stop;
+}
+
+int gcdCapturePoll(gcd_capture_t *capture, uint32_t ring, int timeoutMs,
+                   onGtpcBatch cb, void *arg)
+{
+    if (ring >= capture->nrings) {
+        errno = EINVAL;
+        return -1;
+    }
+    ring_t *r = &capture->rings[ring];
+    uint32_t delivered = 0;
+    int waited = 0;
+
+    for (;;) {
+        struct tpacket_block_desc *bd = (struct tpacket_block_desc *)(r->map
+            + (size_t)r->block * capture->blockSize);
+        uint32_t status = __atomic_load_n(&bd->hdr.bh1.block_status,
+                                          __ATOMIC_ACQUIRE);
+        if (!(status & TP_STATUS_USER)) {
+            if (delivered || waited) {
+                break;
+            }
+            struct pollfd pfd = {.fd = r->fd, .events = POLLIN | POLLERR};
+            if (poll(&pfd, 1, timeoutMs) < 0 && errno != EINTR) {
+                return -1;
+            }
+            waited = 1;
+            continue;
+        }
+        int stop = walkBlock(capture, r, bd, cb, arg, &delivered);
+        /* the frames are ours until here, payloads must not outlive cb */
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                         __ATOMIC_RELEASE);
+        r->block = (r->block + 1) % capture->blocks;
+        if (stop) {
+            __atomic_store_n(&capture->stop, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    __atomic_fetch_add(&r->stats.payloads, delivered, __ATOMIC_RELAXED);
+    return (int)delivered;
+}
+
+static void *runRing(void *arg)
+{
+    runner_t *run = arg;
+    gcd_capture_t *c = run->capture;
+    while (!__atomic_load_n(&c->stop, __ATOMIC_RELAXED)) {
+        if (gcdCapturePoll(c, run->ring, RUN_POLL_MS, run->cb, run->arg) < 0) {
+            run->ret = -1;
+            __atomic_store_n(&c->stop, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+int gcdCaptureRun(gcd_capture_t *capture, onGtpcBatch cb, void *arg)
+{
+    runner_t *runs = calloc(capture->nrings, sizeof(*runs));
+    pthread_t *tids = calloc(capture->nrings, sizeof(*tids));
+    if (!runs || !tids) {
+        free(runs);
+        free(tids);
+        return -1;
+    }
+    uint32_t started = 1;
+    for (uint32_t i = 0; i < capture->nrings; i++) {
+        runs[i] = (runner_t){capture, i, cb, arg, 0};
+    }
+    /* ring 0 is polled by the calling thread */
+    for (; started < capture->nrings; started++) {
+        if (pthread_create(&tids[started], NULL, runRing, &runs[started])) {
+            runs[0].ret = -1;
+            __atomic_store_n(&capture->stop, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    runRing(&runs[0]);
+    int ret = 0;
+    for (uint32_t i = 0; i < started; i++) {
+        if (i) {
+            pthread_join(tids[i], NULL);
+        }
+        if (runs[i].ret < 0) {
+            ret = -1;
+        }
+    }
+    free(runs);
+    free(tids);
+    return ret;
+}
+
+void gcdCaptureStop(gcd_capture_t *capture)
+{
+    __atomic_store_n(&capture->stop, 1, __ATOMIC_RELAXED);
+}
+
+void gcdCaptureStats(gcd_capture_t *capture, gcd_capture_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < capture->nrings; i++) {
+        ring_t *r = &capture->rings[i];
+        /* the kernel counters are reset by every read */
+        struct tpacket_stats_v3 ks;
+        socklen_t len = sizeof(ks);
+        if (getsockopt(r->fd, SOL_PACKET, PACKET_STATISTICS, &ks, &len) == 0) {
+            __atomic_fetch_add(&r->stats.drops, ks.tp_drops, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&r->stats.freezes, ks.tp_freeze_q_cnt,
+                               __ATOMIC_RELAXED);
+        }
+        stats->frames += __atomic_load_n(&r->stats.frames, __ATOMIC_RELAXED);
+        stats->bytes += __atomic_load_n(&r->stats.bytes, __ATOMIC_RELAXED);
+        stats->payloads +=
+            __atomic_load_n(&r->stats.payloads, __ATOMIC_RELAXED);
+        stats->malformed +=
+            __atomic_load_n(&r->stats.malformed, __ATOMIC_RELAXED);
+        stats->drops += __atomic_load_n(&r->stats.drops, __ATOMIC_RELAXED);
+        stats->freezes += __atomic_load_n(&r->stats.freezes, __ATOMIC_RELAXED);
+        gcd_reasm_stats_t *rs = &r->stats.reasm;
+        stats->reasm.fragments +=
+            __atomic_load_n(&rs->fragments, __ATOMIC_RELAXED);
+        stats->reasm.reassembled +=
+            __atomic_load_n(&rs->reassembled, __ATOMIC_RELAXED);
+        stats->reasm.timeouts +=
+            __atomic_load_n(&rs->timeouts, __ATOMIC_RELAXED);
+        stats->reasm.evicted += __atomic_load_n(&rs->evicted, __ATOMIC_RELAXED);
+        stats->reasm.invalid += __atomic_load_n(&rs->invalid, __ATOMIC_RELAXED);
+    }
+}
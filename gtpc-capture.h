@@ -0,0 +1,82 @@
+#ifndef GTPC_CAPTURE_H_
+#define GTPC_CAPTURE_H_
+
+#include <stdint.h>
+
+#include "gtpc-pcap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gcd_capture_conf_s {
+    const char *ifname;
+    uint32_t rings;          // sockets of the fanout group, 0 for 1
+    uint32_t blockSize;      // ring block bytes, 0 for 1MB
+    uint32_t blocks;         // blocks per ring, 0 for 64
+    uint32_t blockTimeoutMs; // hand over a partly filled block, 0 for 10ms
+    uint32_t batch;          // payloads per callback, 0 for 64
+    uint16_t fanoutGroup;    // 0 derives one from the pid
+    uint16_t fanoutMode;     // PACKET_FANOUT_*, 0 is the symmetric flow hash
+    int promisc;
+    const gcd_reasm_conf_t *reassembly; // per ring, NULL drops ip fragments
+} gcd_capture_conf_t;
+
+typedef struct gcd_capture_stats_s {
+    uint64_t frames;    // frames read from the rings
+    uint64_t bytes;     // captured bytes of those frames
+    uint64_t payloads;  // gtpc payloads located
+    uint64_t malformed; // frames with broken link/ip/udp headers
+    uint64_t drops;     // frames the kernel dropped, the rings were full
+    uint64_t freezes;   // times a ring was full
+    gcd_reasm_stats_t reasm; // of all rings
+} gcd_capture_stats_t;
+
+/*
+ * live capture on AF_PACKET TPACKET_V3 rings, one per worker, joined in a
+ * fanout group so both directions of a flow land on the same ring. a BPF
+ * filter keeps only udp port 2123/3386 (and VLAN/MPLS frames, ip fragments
+ * and IPv6 extension headers, which are checked in user space). payloads
+ * point into the ring and the block is only given back to the kernel after
+ * the callback returned. the flow hash of a fragment only covers the
+ * addresses, so all fragments of a datagram reach the same reassembler
+ */
+typedef struct gcd_capture_s gcd_capture_t;
+
+/**
+ * open and map the rings of conf->ifname, needs CAP_NET_RAW
+ * @return
+ *   NULL on error, errno is set
+ */
+GCD_PUBLIC gcd_capture_t *gcdCaptureOpen(const gcd_capture_conf_t *conf);
+GCD_PUBLIC void gcdCaptureClose(gcd_capture_t *capture);
+/**
+ * hand the payloads of every ready block of one ring to cb, waiting up to
+ * timeoutMs for the first one. a ring is polled by one thread at a time
+ * @return
+ *   -1 on error, errno is set
+ *   number of payloads handed to cb
+ */
+GCD_PUBLIC int gcdCapturePoll(gcd_capture_t *capture, uint32_t ring,
+                              int timeoutMs, onGtpcBatch cb, void *arg);
+/**
+ * poll every ring on a thread of its own until gcdCaptureStop() or cb
+ * asks to stop, cb is called concurrently from those threads
+ * @return
+ *   -1 on error
+ *   0  stopped
+ */
+GCD_PUBLIC int gcdCaptureRun(gcd_capture_t *capture, onGtpcBatch cb,
+                             void *arg);
+/**
+ * make gcdCaptureRun() return, safe to call from a signal handler
+ */
+GCD_PUBLIC void gcdCaptureStop(gcd_capture_t *capture);
+GCD_PUBLIC void gcdCaptureStats(gcd_capture_t *capture,
+                                gcd_capture_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
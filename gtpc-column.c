@@ -0,0 +1,400 @@
+#include "gtpc-column.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gtpc-internal.h"
+#include "util.h"
+
+#define GCD_CACHE_LINE 64
+#define BATCH_PREFETCH 4
+
+static const struct {
+    const char *name;
+    const char *format;
+    uint8_t width;
+} column_specs[GCD_COL_MAX] = {
+    [GCD_COL_STATUS] = {"status", "c", 1},
+    [GCD_COL_VERSION] = {"version", "C", 1},
+    [GCD_COL_MSG_TYPE] = {"msg_type", "C", 1},
+    [GCD_COL_SQN] = {"sqn", "I", 4},
+    [GCD_COL_TEID] = {"teid", "I", 4},
+    [GCD_COL_CAUSE] = {"cause", "C", 1},
+    [GCD_COL_RAT_TYPE] = {"rat_type", "C", 1},
+    [GCD_COL_IMSI] = {"imsi", "L", 8},
+    [GCD_COL_IMSI_DIGITS] = {"imsi_digits", "C", 1},
+    [GCD_COL_MSISDN] = {"msisdn", "L", 8},
+    [GCD_COL_MSISDN_DIGITS] = {"msisdn_digits", "C", 1},
+    [GCD_COL_IMEI] = {"imei", "L", 8},
+    [GCD_COL_IMEI_DIGITS] = {"imei_digits", "C", 1},
+    [GCD_COL_CONTROL_TEID] = {"control_teid", "I", 4},
+    [GCD_COL_CHARGING_ID] = {"charging_id", "I", 4},
+    [GCD_COL_APN] = {"apn", "i", 4},
+};
+
+static inline uint32_t padded(uint32_t size)
+{
+    return (size + GCD_CACHE_LINE - 1) & ~(GCD_CACHE_LINE - 1);
+}
+
+static void *allocBuffer(uint32_t size)
+{
+    void *p;
+    if (posix_memalign(&p, GCD_CACHE_LINE, padded(size))) {
+        return NULL;
+    }
+    memset(p, 0, padded(size));
+    return p;
+}
+
+gcd_column_batch_t *gcdColumnBatchCreate(uint32_t capacity, uint32_t columns)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    gcd_column_batch_t *b = calloc(1, sizeof(*b));
+    if (!b) {
+        return NULL;
+    }
+    b->capacity = capacity;
+    b->columns = (columns & GCD_COL_ALL) | GCD_COL_BIT(GCD_COL_STATUS);
+    for (uint32_t c = 0; c < GCD_COL_MAX; c++) {
+        if (!(b->columns & GCD_COL_BIT(c))) {
+            continue;
+        }
+        gcd_column_t *col = &b->col[c];
+        col->validity = allocBuffer((capacity + 7) / 8);
+        col->values = allocBuffer(capacity * column_specs[c].width);
+        col->width = column_specs[c].width;
+        if (!col->validity || !col->values) {
+            gcdColumnBatchDestroy(b);
+            return NULL;
+        }
+    }
+    if (b->columns & GCD_COL_BIT(GCD_COL_APN)) {
+        uint32_t nslots = 1;
+        while (nslots < capacity * 2) { // load factor at most 1/2
+            nslots <<= 1;
+        }
+        b->apnMask = nslots - 1;
+        b->apnSlots = calloc(nslots, sizeof(*b->apnSlots));
+        b->apnOffsets = calloc(capacity + 1, sizeof(*b->apnOffsets));
+        b->apnDataCap = 4096;
+        b->apnData = malloc(b->apnDataCap);
+        if (!b->apnSlots || !b->apnOffsets || !b->apnData) {
+            gcdColumnBatchDestroy(b);
+            return NULL;
+        }
+    }
+    return b;
+}
+
+void gcdColumnBatchDestroy(gcd_column_batch_t *batch)
+{
+    if (!batch) {
+        return;
+    }
+    for (uint32_t c = 0; c < GCD_COL_MAX; c++) {
+        free(batch->col[c].validity);
+        free(batch->col[c].values);
+    }
+    free(batch->apnSlots);
+    free(batch->apnOffsets);
+    free(batch->apnData);
+    free(batch);
+}
+
+void gcdColumnBatchReset(gcd_column_batch_t *batch)
+{
+    for (uint32_t c = 0; c < GCD_COL_MAX; c++) {
+        gcd_column_t *col = &batch->col[c];
+        if (!col->width) {
+            continue;
+        }
+        // only the rows used so far can be dirty
+        memset(col->validity, 0, (batch->rows + 7) / 8);
+        memset(col->values, 0, batch->rows * col->width);
+        col->nulls = 0;
+        col->valid = 0;
+    }
+    if (batch->apnCount) {
+        memset(batch->apnSlots, 0,
+               (batch->apnMask + 1) * sizeof(*batch->apnSlots));
+        batch->apnCount = 0;
+    }
+    batch->rows = 0;
+}
+
+void gcdColumnBatchSetIntern(gcd_column_batch_t *batch, gcd_intern_t *intern)
+{
+    batch->intern = intern;
+}
+
+const char *gcdColumnName(uint32_t col)
+{
+    return col < GCD_COL_MAX ? column_specs[col].name : NULL;
+}
+
+const char *gcdColumnFormat(uint32_t col)
+{
+    return col < GCD_COL_MAX ? column_specs[col].format : NULL;
+}
+
+static GCD_ALWAYS_INLINE void markValid(gcd_column_t *col, uint32_t row)
+{
+    uint8_t bit = 1 << (row & 7);
+    if (!(col->validity[row >> 3] & bit)) {
+        col->validity[row >> 3] |= bit;
+        col->valid++;
+    }
+}
+
+/* store a value of a selected column and mark it present */
+#define PUT(b, c, type, row, v)                    \
+    do {                                           \
+        gcd_column_t *col_ = &(b)->col[(c)];       \
+        if (col_->width) {                         \
+            ((type *)col_->values)[(row)] = (v);   \
+            markValid(col_, (row));                \
+        }                                          \
+    } while (0)
+
+static inline uint32_t hashApn(const char *apn, uint32_t len)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (uint32_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)apn[i]) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ * @return
+ *   -1 out of memory
+ *   dictionary index of apn
+ */
+static int32_t internApn(gcd_column_batch_t *b, const char *apn, uint32_t len)
+{
+    uint32_t i = hashApn(apn, len) & b->apnMask;
+    for (; b->apnSlots[i]; i = (i + 1) & b->apnMask) {
+        uint32_t index = b->apnSlots[i] - 1;
+        int32_t start = b->apnOffsets[index];
+        if ((uint32_t)(b->apnOffsets[index + 1] - start) == len
+            && !memcmp(b->apnData + start, apn, len)) {
+            return index;
+        }
+    }
+
+    uint32_t used = b->apnOffsets[b->apnCount];
+    if (used + len > b->apnDataCap) {
+        uint32_t cap = b->apnDataCap * 2;
+        char *data = realloc(b->apnData, cap);
+        if (!data) {
+            return -1;
+        }
+        b->apnData = data;
+        b->apnDataCap = cap;
+    }
+    memcpy(b->apnData + used, apn, len);
+    b->apnOffsets[b->apnCount + 1] = used + len;
+    b->apnSlots[i] = ++b->apnCount;
+    return b->apnCount - 1;
+}
+
+static int columnApn(gcd_column_batch_t *b, uint32_t row, uint8_t *v,
+                     uint16_t len)
+{
+    if (len > MAX_APN_LEN) {
+        return 0;
+    }
+    gcd_column_t *col = &b->col[GCD_COL_APN];
+    if (!col->width || col->validity[row >> 3] & 1 << (row & 7)) {
+        return 1; // the first APN of a message, the dictionary holds a row
+    }
+    if (b->intern) {
+        uint32_t id = gcdInternApn(b->intern, v, len);
+        if (id) {
+            PUT(b, GCD_COL_APN, int32_t, row, id);
+        }
+        return 1;
+    }
+    char apn[MAX_APN_LEN + 1];
+    int32_t index = internApn(b, apn, APN2ASCII(v, len, apn, sizeof(apn)));
+    if (index >= 0) {
+        PUT(b, GCD_COL_APN, int32_t, row, index);
+    }
+    return 1;
+}
+
+static int columnDigits(gcd_column_batch_t *b, uint32_t row, uint32_t c,
+                        uint8_t *v, uint16_t len, uint16_t max)
+{
+    if (len > max) {
+        return 0;
+    }
+    uint64_t value;
+    uint8_t digits = BCD2U64(v, len * 2, &value);
+    PUT(b, c, uint64_t, row, value);
+    PUT(b, c + 1, uint8_t, row, digits);
+    return 1;
+}
+
+static int columnGtpv1IE(gcd_column_batch_t *b, uint32_t row, uint8_t version,
+                         uint8_t type, uint8_t *v, uint16_t len)
+{
+    switch (type) {
+    case 0x01: // cause
+        PUT(b, GCD_COL_CAUSE, uint8_t, row, v[0]);
+        break;
+    case 0x02: // imsi
+        return columnDigits(b, row, GCD_COL_IMSI, v, len, MAX_IMSI_LEN);
+    case 0x11: // teid control plane, a flow label on v0
+        if (version == 1) {
+            PUT(b, GCD_COL_CONTROL_TEID, uint32_t, row,
+                ntohl(*(uint32_t *)v));
+        }
+        break;
+    case 0x7F: // charging id
+        PUT(b, GCD_COL_CHARGING_ID, uint32_t, row, ntohl(*(uint32_t *)v));
+        break;
+    case 0x83: // access point name
+        return columnApn(b, row, v, len);
+    case 0x86: // msisdn, skip the extension/numbering plan octet
+        if (len < 1) {
+            return 0;
+        }
+        return columnDigits(b, row, GCD_COL_MSISDN, v + 1, len - 1,
+                            MAX_MSISDN_LEN);
+    case 0x97: // rat type
+        if (len < 1) {
+            return 0;
+        }
+        PUT(b, GCD_COL_RAT_TYPE, uint8_t, row, v[0]);
+        break;
+    case 0x9A: // imei(sv)
+        return columnDigits(b, row, GCD_COL_IMEI, v, len, MAX_IMEISV_LEN);
+    default:
+        break;
+    }
+    return 1;
+}
+
+static int columnGtpv2IE(gcd_column_batch_t *b, uint32_t row, uint8_t type,
+                         uint8_t instance, uint8_t *v, uint16_t len)
+{
+    switch (type) {
+    case 1: // imsi
+        return columnDigits(b, row, GCD_COL_IMSI, v, len, MAX_IMSI_LEN);
+    case 2: // cause
+        if (len < 2) {
+            return 0;
+        }
+        PUT(b, GCD_COL_CAUSE, uint8_t, row, v[0]);
+        break;
+    case 71: // apn
+        return columnApn(b, row, v, len);
+    case 75: // mei
+        return columnDigits(b, row, GCD_COL_IMEI, v, len, MAX_IMEISV_LEN);
+    case 76: // msisdn
+        return columnDigits(b, row, GCD_COL_MSISDN, v, len, MAX_MSISDN_LEN);
+    case 82: // rat type
+        if (len < 1) {
+            return 0;
+        }
+        PUT(b, GCD_COL_RAT_TYPE, uint8_t, row, v[0]);
+        break;
+    case 87: // f-teid, the sender's control plane endpoint is instance 0
+        if (len < 5) {
+            return 0;
+        }
+        if (instance == 0) {
+            PUT(b, GCD_COL_CONTROL_TEID, uint32_t, row,
+                ntohl(*(uint32_t *)(v + 1)));
+        }
+        break;
+    case 94: // charging id
+        if (len < 4) {
+            return 0;
+        }
+        PUT(b, GCD_COL_CHARGING_ID, uint32_t, row, ntohl(*(uint32_t *)v));
+        break;
+    default:
+        break;
+    }
+    return 1;
+}
+
+/*
+ * decode one message into row
+ * @return
+ *   same as decodeGtpc
+ */
+static int decodeRow(gcd_column_batch_t *b, uint32_t row, uint8_t *data,
+                     uint32_t len)
+{
+    gtp_header_t hdr;
+    int offset = len ? decodeGtpcHeader(data, len, &hdr, NULL) : -1;
+    if (offset < 0) {
+        return -1;
+    }
+    uint8_t version = hdr.version;
+    PUT(b, GCD_COL_VERSION, uint8_t, row, version);
+    PUT(b, GCD_COL_MSG_TYPE, uint8_t, row, hdr.msgType);
+    // gtpv1 has a sequence number only with the S flag
+    if (version != 1 || data[0] & 0x02) {
+        PUT(b, GCD_COL_SQN, uint32_t, row, hdr.sqn);
+    }
+    // gtpv0 has a TID instead, gtpv2 a TEID only with the T flag
+    if (version == 1 || (version == 2 && data[0] & 0x08)) {
+        PUT(b, GCD_COL_TEID, uint32_t, row, hdr.teid);
+    }
+
+    uint32_t end = gtpcMessageLen(&hdr);
+    for (uint32_t idx = offset; idx < end;) {
+        int ielen = gtpcIELength(version, data + idx, end - idx);
+        if (ielen <= 0) {
+            return 0;
+        }
+        uint8_t *ie = data + idx;
+        int ok;
+        if (version == 2) {
+            ok = columnGtpv2IE(b, row, ie[0], ie[3] & 0x0F, ie + 4, ielen - 4);
+        } else {
+            uint8_t hdrlen = ie[0] & 0x80 ? 3 : 1;
+            ok = columnGtpv1IE(b, row, version, ie[0], ie + hdrlen,
+                               ielen - hdrlen);
+        }
+        if (!ok) {
+            return 0;
+        }
+        idx += ielen;
+    }
+    return 1;
+}
+
+uint32_t gcdColumnBatchDecode(gcd_column_batch_t *batch, uint8_t **data,
+                              uint32_t *len, uint32_t n)
+{
+    if (n > batch->capacity - batch->rows) {
+        n = batch->capacity - batch->rows;
+    }
+    for (uint32_t i = 0; i < n && i < BATCH_PREFETCH; i++) {
+        GCD_PREFETCH_R(data[i]);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (i + BATCH_PREFETCH < n) {
+            GCD_PREFETCH_R(data[i + BATCH_PREFETCH]);
+            GCD_PREFETCH_R(data[i + BATCH_PREFETCH] + 64);
+        }
+        uint32_t row = batch->rows++;
+        int8_t status = decodeRow(batch, row, data[i], len[i]);
+        PUT(batch, GCD_COL_STATUS, int8_t, row, status);
+    }
+    for (uint32_t c = 0; c < GCD_COL_MAX; c++) {
+        if (batch->col[c].width) {
+            batch->col[c].nulls = batch->rows - batch->col[c].valid;
+        }
+    }
+    return n;
+}
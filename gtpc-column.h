@@ -0,0 +1,113 @@
+#ifndef GTPC_COLUMN_H_
+#define GTPC_COLUMN_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+#include "gtpc-intern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* columns of a batch, one row per message */
+enum {
+    GCD_COL_STATUS,   // int8, decode status, same as decodeGtpc
+    GCD_COL_VERSION,  // uint8
+    GCD_COL_MSG_TYPE, // uint8
+    GCD_COL_SQN,      // uint32, null for gtpv1 without the S flag
+    GCD_COL_TEID,     // uint32, header TEID, null if the header has none
+    GCD_COL_CAUSE,    // uint8
+    GCD_COL_RAT_TYPE, // uint8
+    GCD_COL_IMSI,     // uint64, decimal value of the digits
+    GCD_COL_IMSI_DIGITS,
+    GCD_COL_MSISDN,
+    GCD_COL_MSISDN_DIGITS,
+    GCD_COL_IMEI,
+    GCD_COL_IMEI_DIGITS,
+    GCD_COL_CONTROL_TEID, // uint32, sender's control plane TEID
+    GCD_COL_CHARGING_ID,  // uint32
+    GCD_COL_APN,          // int32, index into the APN dictionary
+    GCD_COL_MAX
+};
+
+#define GCD_COL_BIT(col) (1U << (col))
+#define GCD_COL_ALL      (GCD_COL_BIT(GCD_COL_MAX) - 1)
+
+/*
+ * one column in the arrow layout: a validity bitmap, least significant bit
+ * first with a set bit for a present value, and a buffer of fixed width
+ * values. both are 64 byte aligned and padded, values of null rows are 0
+ */
+typedef struct gcd_column_s {
+    uint8_t *validity;
+    void *values;
+    uint32_t nulls; // arrow null_count
+    uint32_t valid; // rows with a value
+    uint8_t width; // bytes per value, 0 for a column not selected
+} gcd_column_t;
+
+/*
+ * decoded messages as a structure of arrays, no per message struct is
+ * built. GCD_COL_APN is dictionary encoded, the dictionary is an arrow utf8
+ * array of the distinct dotted APNs of the batch, or with an intern table
+ * the column holds its APN ids and stays comparable across batches
+ */
+typedef struct gcd_column_batch_s {
+    uint32_t rows;
+    uint32_t capacity;
+    uint32_t columns; // GCD_COL_BIT() of the selected columns
+    gcd_column_t col[GCD_COL_MAX];
+    uint32_t apnCount;
+    int32_t *apnOffsets; // apnCount + 1 entries
+    char *apnData;
+    uint32_t apnDataCap;
+    uint32_t *apnSlots; // hash of the dictionary, index + 1, 0 empty
+    uint32_t apnMask;
+    gcd_intern_t *intern;
+} gcd_column_batch_t;
+
+/**
+ * allocate the buffers of capacity rows for the selected columns,
+ * GCD_COL_STATUS is always selected
+ * @return
+ *   NULL on allocation failure or capacity 0
+ */
+GCD_PUBLIC gcd_column_batch_t *gcdColumnBatchCreate(uint32_t capacity,
+                                                    uint32_t columns);
+GCD_PUBLIC void gcdColumnBatchDestroy(gcd_column_batch_t *batch);
+/**
+ * empty the batch and its dictionary, buffers handed out before are
+ * overwritten by the next decode
+ */
+GCD_PUBLIC void gcdColumnBatchReset(gcd_column_batch_t *batch);
+/**
+ * fill GCD_COL_APN with ids of intern instead of the batch dictionary,
+ * NULL goes back to the dictionary. intern must outlive the batch
+ */
+GCD_PUBLIC void gcdColumnBatchSetIntern(gcd_column_batch_t *batch,
+                                        gcd_intern_t *intern);
+/**
+ * decode messages into the next rows until n messages are done or the
+ * batch is full. every message takes a row, fields of a message failing
+ * to decode are null from the failing IE on
+ * @return
+ *   number of messages consumed
+ */
+GCD_PUBLIC uint32_t gcdColumnBatchDecode(gcd_column_batch_t *batch,
+                                         uint8_t **data, uint32_t *len,
+                                         uint32_t n);
+/**
+ * name and arrow C data interface format string of a column, eg. "C" for
+ * uint8 and "i" for the int32 dictionary indices of GCD_COL_APN
+ * @return
+ *   NULL for an unknown column
+ */
+GCD_PUBLIC const char *gcdColumnName(uint32_t col);
+GCD_PUBLIC const char *gcdColumnFormat(uint32_t col);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+#include "gtpc-context.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gtpc-internal.h"
+
+#define GCD_CACHE_LINE   64
+#define GCD_READER_SLOTS 64
+
+/*
+ * readers announce themselves in one of two counters selected by the low
+ * bit of the decoder epoch. a swap flips the epoch and waits for the
+ * counters of the previous phase to drain, twice, so every reader that may
+ * still see the old set has left it (the same scheme as SRCU)
+ */
+typedef struct reader_slot_s {
+    uint64_t active[2];
+} __attribute__((aligned(GCD_CACHE_LINE))) reader_slot_t;
+
+struct gcd_decoder_s {
+    reader_slot_t readers[GCD_READER_SLOTS];
+    gcd_parsers_t *parsers;
+    uint32_t epoch;
+    pthread_mutex_t writer;
+};
+
+static uint32_t next_reader_slot;
+static __thread uint32_t reader_slot = UINT32_MAX;
+
+static inline reader_slot_t *readerSlot(gcd_decoder_t *decoder)
+{
+    if (reader_slot == UINT32_MAX) {
+        reader_slot = __atomic_fetch_add(&next_reader_slot, 1,
+                                         __ATOMIC_RELAXED) %
+                      GCD_READER_SLOTS;
+    }
+    return &decoder->readers[reader_slot];
+}
+
+gcd_parsers_t *gcdParsersCreate()
+{
+    gcd_parsers_t *parsers = malloc(sizeof(*parsers));
+    if (!parsers) {
+        return NULL;
+    }
+    if (!initParserSet(parsers)) {
+        free(parsers);
+        return NULL;
+    }
+    return parsers;
+}
+
+gcd_parsers_t *gcdParsersClone(const gcd_parsers_t *parsers)
+{
+    gcd_parsers_t *clone = malloc(sizeof(*clone));
+    if (clone) {
+        memcpy(clone, parsers, sizeof(*clone));
+    }
+    return clone;
+}
+
+void gcdParsersDestroy(gcd_parsers_t *parsers)
+{
+    free(parsers);
+}
+
+int gcdParsersRegister(gcd_parsers_t *parsers, uint8_t version, uint8_t ie,
+                       onIEParse parser)
+{
+    return registerParserSet(parsers, version, ie, parser);
+}
+
+void gcdParsersSetMask(gcd_parsers_t *parsers, const gtp_ie_mask_t *mask)
+{
+    parsers->masked = mask != NULL;
+    if (mask) {
+        parsers->mask = *mask;
+    }
+}
+
+gcd_decoder_t *gcdDecoderCreate(gcd_parsers_t *parsers)
+{
+    gcd_decoder_t *decoder = NULL;
+    if (posix_memalign((void **)&decoder, GCD_CACHE_LINE, sizeof(*decoder))) {
+        return NULL;
+    }
+    memset(decoder, 0, sizeof(*decoder));
+    if (!parsers) {
+        parsers = gcdParsersCreate();
+        if (!parsers) {
+            free(decoder);
+            return NULL;
+        }
+    }
+    decoder->parsers = parsers;
+    pthread_mutex_init(&decoder->writer, NULL);
+    return decoder;
+}
+
+void gcdDecoderDestroy(gcd_decoder_t *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+    pthread_mutex_destroy(&decoder->writer);
+    gcdParsersDestroy(decoder->parsers);
+    free(decoder);
+}
+
+static void waitReaders(gcd_decoder_t *decoder, uint32_t phase)
+{
+    for (int i = 0; i < GCD_READER_SLOTS; i++) {
+        while (__atomic_load_n(&decoder->readers[i].active[phase],
+                               __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+    }
+}
+
+int gcdDecoderSwap(gcd_decoder_t *decoder, gcd_parsers_t *parsers)
+{
+    if (!decoder || !parsers) {
+        return -1;
+    }
+    pthread_mutex_lock(&decoder->writer);
+    gcd_parsers_t *old =
+        __atomic_exchange_n(&decoder->parsers, parsers, __ATOMIC_SEQ_CST);
+    for (int round = 0; round < 2; round++) {
+        uint32_t epoch = __atomic_load_n(&decoder->epoch, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&decoder->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+        waitReaders(decoder, epoch & 1);
+    }
+    pthread_mutex_unlock(&decoder->writer);
+    gcdParsersDestroy(old);
+    return 0;
+}
+
+int gcdDecode(gcd_decoder_t *decoder, uint8_t *data, uint32_t len, gtp_t *gtp)
+{
+    gtp->err.code = GTP_ERR_NONE;
+    int hdr_offset = decodeGtpcHeader(data, len, &gtp->hdr, &gtp->err);
+    if (hdr_offset == -1) {
+        return -1;
+    }
+
+    reader_slot_t *slot = readerSlot(decoder);
+    uint32_t phase = __atomic_load_n(&decoder->epoch, __ATOMIC_SEQ_CST) & 1;
+    __atomic_fetch_add(&slot->active[phase], 1, __ATOMIC_SEQ_CST);
+    const gcd_parsers_t *parsers =
+        __atomic_load_n(&decoder->parsers, __ATOMIC_SEQ_CST);
+    int ret = decodeGtpcBody(data, gtpcMessageLen(&gtp->hdr), hdr_offset,
+                             gtp, parsers,
+                             parsers->masked ? &parsers->mask : NULL);
+    __atomic_fetch_sub(&slot->active[phase], 1, __ATOMIC_RELEASE);
+    return ret;
+}
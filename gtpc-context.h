@@ -0,0 +1,81 @@
+#ifndef GTPC_CONTEXT_H_
+#define GTPC_CONTEXT_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * a parser set owns the IE parser tables of every version. it is built and
+ * modified by one thread, then published to a decoder which owns it from
+ * that point on
+ */
+typedef struct gcd_parsers_s gcd_parsers_t;
+/*
+ * a decoder can be shared read-only by any number of threads, its parser
+ * set can be replaced while they decode without ever blocking them
+ */
+typedef struct gcd_decoder_s gcd_decoder_t;
+
+/**
+ * create a parser set holding the built-in parsers
+ * @return
+ *   NULL on allocation failure
+ */
+GCD_PUBLIC gcd_parsers_t *gcdParsersCreate();
+/**
+ * copy an existing set, eg. the one currently used by a decoder
+ * @return
+ *   NULL on allocation failure
+ */
+GCD_PUBLIC gcd_parsers_t *gcdParsersClone(const gcd_parsers_t *parsers);
+GCD_PUBLIC void gcdParsersDestroy(gcd_parsers_t *parsers);
+/**
+ * register your custom IE in a parser set
+ * @return
+ *   same as registerIEParser
+ */
+GCD_PUBLIC int gcdParsersRegister(gcd_parsers_t *parsers, uint8_t version,
+                                  uint8_t ie, onIEParse parser);
+/**
+ * restrict decoding to the IEs set in mask, NULL decodes every IE
+ */
+GCD_PUBLIC void gcdParsersSetMask(gcd_parsers_t *parsers,
+                                  const gtp_ie_mask_t *mask);
+
+/**
+ * create a decoder owning parsers, NULL uses the built-in parsers
+ * @return
+ *   NULL on allocation failure
+ */
+GCD_PUBLIC gcd_decoder_t *gcdDecoderCreate(gcd_parsers_t *parsers);
+/**
+ * no thread may be decoding with the decoder any more
+ */
+GCD_PUBLIC void gcdDecoderDestroy(gcd_decoder_t *decoder);
+/**
+ * atomically replace the parser set, decoding threads switch to the new
+ * set on their next message. the old set is destroyed once no thread uses
+ * it any more, the caller waits for that but decoding threads never do
+ * @return
+ *   -1 error, parsers is left untouched
+ *   0  success
+ */
+GCD_PUBLIC int gcdDecoderSwap(gcd_decoder_t *decoder, gcd_parsers_t *parsers);
+/**
+ * decode gtpc data with the decoder's current parser set
+ * @return
+ *   same as decodeGtpc
+ */
+GCD_PUBLIC int gcdDecode(gcd_decoder_t *decoder, uint8_t *data, uint32_t len,
+                         gtp_t *gtp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
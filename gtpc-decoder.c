@@ -1,9 +1,9 @@
 #include "gtpc-decoder.h"
 
 #include <arpa/inet.h>
-#include <stdio.h>
 #include <string.h>
 
+#include "gtpc-internal.h"
 #include "gtpv0-decoder.h"
 #include "gtpv1-decoder.h"
 #include "gtpv2-decoder.h"
@@ -27,18 +27,94 @@ static int gtpv2FallbackTlv(uint8_t *data, uint32_t len, gtp_t *ud)
     return offset;
 }
 
-static int decodeGtpcHeader(uint8_t *data, uint32_t len, gtp_t *gtp)
+int gtpcIELength(uint8_t version, uint8_t *data, uint32_t len)
+{
+    uint32_t total;
+    if (version == 2) {
+        if (len < 4) {
+            return -1;
+        }
+        total = 4 + ntohs(*(uint16_t *)&data[1]);
+    } else if (data[0] & 0x80) {
+        if (len < 3) {
+            return -1;
+        }
+        total = 3 + ntohs(*(uint16_t *)&data[1]);
+    } else {
+        uint8_t tvlen = version == 0 ? gtpv0TvLen[data[0]] : gtpv1TvLen[data[0]];
+        if (tvlen == 0) {
+            return 0; // unknown TV, can not be skipped
+        }
+        total = 1 + tvlen;
+    }
+    return len < total ? -1 : (int)total;
+}
+
+/*
+ * walk the IE chain from offset on, checking every IE ends by end. the
+ * built-in parsers run unchecked on the stretch it accepts
+ * @return
+ *   -1 IE at *stop runs past end
+ *   1  IEs up to *stop fit, *stop is end or an unknown TV only its
+ *      registered parser knows the length of
+ */
+static int validateIEs(uint8_t version, const uint8_t *data, uint32_t offset,
+                       uint32_t end, uint32_t *stop)
+{
+    if (version == 2) {
+        while (end - offset >= 4) {
+            uint32_t next = offset + 4 + ntohs(*(uint16_t *)&data[offset + 1]);
+            if (next > end) {
+                break;
+            }
+            offset = next;
+        }
+        *stop = offset;
+        return offset == end ? 1 : -1;
+    }
+
+    const uint8_t *tvlen = version == 0 ? gtpv0TvLen : gtpv1TvLen;
+    while (offset < end) {
+        uint32_t next;
+        if (data[offset] & 0x80) {
+            if (end - offset < 3) {
+                *stop = offset;
+                return -1;
+            }
+            next = offset + 3 + ntohs(*(uint16_t *)&data[offset + 1]);
+        } else if (tvlen[data[offset]]) {
+            next = offset + 1 + tvlen[data[offset]];
+        } else {
+            break; // unknown TV
+        }
+        if (next > end) {
+            *stop = offset;
+            return -1;
+        }
+        offset = next;
+    }
+    *stop = offset;
+    return 1;
+}
+
+static int parseGtpcHeader(uint8_t *data, uint32_t len, gtp_header_t *hdr,
+                           gtp_error_t *err)
 {
     uint32_t oft = 0;
-    gtp_header_t *hdr = &gtp->hdr;
 
     hdr->version = (*data >> 5) & 0x07;
+    hdr->piggyback = 0;
     switch (hdr->version) {
     case 0: {
         uint8_t pt = (*data >> 4) & 0x01; // protocol type
         if (pt != 1) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 0);
             return -1; // not GTP
         }
+        if (len < 20) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 0);
+            return -1;
+        }
         uint8_t sndcp = *data & 0x01; // Is SNDCP N-PDU included?
         ++oft;
         hdr->msgType = data[oft++];
@@ -55,121 +131,311 @@ static int decodeGtpcHeader(uint8_t *data, uint32_t len, gtp_t *gtp)
         char tid[9];
         memcpy(tid, data + oft, 8);
         oft += 8;
+        if (len < oft + (uint32_t)hdr->msgLen) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 2);
+            return -1;
+        }
         break;
     }
     case 1: {
         uint8_t pt = (*data >> 4) & 0x01; // protocol type
         if (pt != 1) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 0);
             return -1; // not GTP
         }
         uint8_t ext = (*data >> 2) & 0x01; // Is Next Extension Header present
         uint8_t sqn = (*data >> 1) & 0x01; // Is Sequence Number present?
-        // uint8_t pdu = *data & 0x01; // Is N-PDU number present?
+        uint8_t pdu = *data & 0x01;        // Is N-PDU number present?
+        if (len < 8) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 0);
+            return -1;
+        }
         ++oft;
         hdr->msgType = data[oft++];
         hdr->msgLen = ntohs(*(uint16_t *)(data + oft));
         oft += 2;
         hdr->teid = ntohl(*(uint32_t *)(data + oft));
         oft += 4;
-        if (sqn == 1) {
-            hdr->sqn = ntohs(*(uint16_t *)(data + oft));
-            oft += 2;
+        // the optional octets and extension headers count into msgLen
+        uint32_t total = oft + (uint32_t)hdr->msgLen;
+        if (len < total) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 2);
+            return -1;
         }
-        if (ext) {}
-        oft += 2;
-        while (data[oft - 1] == 0x02) {
-            // next extension header type
+        // any of the flags brings all of the 4 optional octets
+        if (ext || sqn || pdu) {
+            if (total < 12) {
+                setGtpError(err, GTP_ERR_HEADER, 0, oft);
+                return -1;
+            }
+            if (sqn == 1) {
+                hdr->sqn = ntohs(*(uint16_t *)(data + oft));
+            }
             oft += 4;
+            if (ext) {
+                int end = gtpv1ExtensionChain(data, total, oft,
+                                              data[oft - 1], NULL);
+                if (end < 0) {
+                    setGtpError(err, GTP_ERR_HEADER, 0, oft);
+                    return -1;
+                }
+                oft = end;
+            }
         }
         break;
     }
     case 2: {
         uint8_t teidFlag = (*data >> 3) & 0x01;
+        hdr->piggyback = (*data >> 4) & 0x01;
+        if (len < 4) {
+            setGtpError(err, GTP_ERR_HEADER, 0, 0);
+            return -1;
+        }
         ++oft;
         hdr->msgType = data[oft++];
         hdr->msgLen = ntohs(*(uint16_t *)(data + oft));
         oft += 2;
-        if (len != hdr->msgLen + oft) {
+        // a piggybacked message may follow, otherwise nothing may
+        uint32_t total = hdr->msgLen + oft;
+        if (hdr->piggyback ? len < total : len != total) {
+            setGtpError(err, GTP_ERR_HEADER, 0, oft);
+            return -1;
+        }
+        if (total < oft + (teidFlag ? 8 : 4)) {
+            setGtpError(err, GTP_ERR_HEADER, 0, oft);
             return -1;
         }
         if (teidFlag) {
             hdr->teid = ntohl(*(uint32_t *)(data + oft));
             oft += 4;
         }
-        hdr->teid = (ntohl(*(uint32_t *)(data + oft)) >> 8) & 0x00ffffff;
+        hdr->sqn = (ntohl(*(uint32_t *)(data + oft)) >> 8) & 0x00ffffff;
         oft += 4;
         break;
     }
     default:
-        printf("unsupported gtpc version[%u]\n", hdr->version);
+        setGtpError(err, GTP_ERR_VERSION, 0, 0);
         return -1;
     }
     return oft;
 }
 
-#define MAX_GTPC_VERSION 2
-static onIEParse ie_table[MAX_GTPC_VERSION + 1][MAX_IE + 1];
+int decodeGtpcHeader(uint8_t *data, uint32_t len, gtp_header_t *hdr,
+                     gtp_error_t *err)
+{
+    gtp_error_t local;
+    if (!err) {
+        err = &local;
+    }
+    int ret = parseGtpcHeader(data, len, hdr, err);
+    gcd_stats_t *st = statsLocal();
+    if (st) {
+        if (ret < 0) {
+            GCD_STAT_INC(st->errors[err->code]);
+        } else {
+            GCD_STAT_INC(st->messages[hdr->version]);
+            GCD_STAT_INC(st->msgTypes[hdr->version][hdr->msgType]);
+        }
+    }
+    return ret;
+}
+
+/* parser set behind the global (non context) API */
+static gcd_parsers_t default_parsers;
+static onIEParse const ie_dispatch[MAX_GTPC_VERSION + 1] = {
+    dispatchGtpv0IE, dispatchGtpv1IE, dispatchGtpv2IE};
 
-static int decodeGtpcBody(uint8_t *data, uint32_t len, gtp_t *gtp,
-                          onIEParse ietable[MAX_IE])
+int decodeGtpcBody(uint8_t *data, uint32_t len, uint32_t offset, gtp_t *gtp,
+                   const gcd_parsers_t *parsers, const gtp_ie_mask_t *mask)
 {
-    uint32_t idx = 0;
+    uint32_t idx = offset;
     int ret = 0;
+    uint8_t version = gtp->hdr.version;
+    onIEParse dispatch = ie_dispatch[version];
+    gcd_stats_t *st = statsLocal();
+    uint32_t checked = offset; // IEs before it are known to fit in len
+    if (version == 2) {
+        // counted per message, a reused gtp_t must not carry them over
+        gtp->b2.bearerCount = 0;
+        gtp->b2.bearerTotal = 0;
+    }
     while (idx < len) {
-        onIEParse parse = ietable[data[idx]];
-        if (!parse) {
-            // warning
-            printf("unknown ie[%u] or corresponding parser not be registered\n",
-                   data[idx]);
-            // try to use unknown tlvDecoder
-            if (gtp->hdr.version < 2 && data[idx] & 0x80) {
-                parse = gtpv1FallbackTlv;
-            } else if (gtp->hdr.version == 2) {
-                parse = gtpv2FallbackTlv;
-            } else {
-                break;
+        if (idx >= checked
+            && validateIEs(version, data, idx, len, &checked) < 0) {
+            setGtpError(&gtp->err, GTP_ERR_IE, data[checked], checked);
+            if (st) {
+                GCD_STAT_INC(st->errors[GTP_ERR_IE]);
             }
+            gcdLog(GCD_LOG_ERROR, "truncated ie[%u] in offset[%u]",
+                   data[checked], checked);
+            return 0;
         }
-        ret = parse(data + idx, len - idx, gtp);
-        if (ret < 0) {
-            printf("parse ie error in offset[%u]\n", idx);
-            break;
+        uint8_t ie = data[idx];
+        if (mask && !GTP_IE_MASK_TEST(mask, version, ie)) {
+            ret = gtpcIELength(version, data + idx, len - idx);
+            if (ret > 0) {
+                idx += ret;
+                continue;
+            }
+            // unknown length, let the parser (if any) decide
+        }
+        ret = GTPC_IE_NOT_BUILTIN;
+        // an unknown TV at checked has not been validated, only parsers
+        // registered for it may know its length
+        if (idx < checked
+            && !GTP_IE_MASK_TEST(&parsers->custom, version, ie)) {
+            ret = dispatch(data + idx, len - idx, gtp);
+            if (st && ret != GTPC_IE_NOT_BUILTIN) {
+                GCD_STAT_INC(st->ieHits[version][ie]);
+            }
+        }
+        if (ret == GTPC_IE_NOT_BUILTIN) {
+            onIEParse parse = parsers->table[version][ie];
+            if (!parse) {
+                // try to use unknown tlvDecoder
+                if (version < 2 && ie & 0x80) {
+                    parse = gtpv1FallbackTlv;
+                } else if (version == 2) {
+                    parse = gtpv2FallbackTlv;
+                } else {
+                    setGtpError(&gtp->err, GTP_ERR_UNKNOWN_IE, ie, idx);
+                    if (st) {
+                        GCD_STAT_INC(st->errors[GTP_ERR_UNKNOWN_IE]);
+                    }
+                    gcdLog(GCD_LOG_ERROR, "unknown ie[%u] in offset[%u]", ie,
+                           idx);
+                    return 0;
+                }
+                gcdLog(GCD_LOG_WARN,
+                       "unknown ie[%u] or corresponding parser not be "
+                       "registered",
+                       ie);
+                if (st) {
+                    GCD_STAT_INC(st->ieFallbacks[version][ie]);
+                }
+            } else if (st) {
+                GCD_STAT_INC(st->ieHits[version][ie]);
+            }
+            ret = parse(data + idx, len - idx, gtp);
+        }
+        if (ret <= 0) {
+            setGtpError(&gtp->err, GTP_ERR_IE, ie, idx);
+            if (st) {
+                GCD_STAT_INC(st->errors[GTP_ERR_IE]);
+            }
+            gcdLog(GCD_LOG_ERROR, "parse ie[%u] error in offset[%u]", ie, idx);
+            return 0;
         }
         idx += ret;
     }
-    return idx == len;
+    return 1;
 }
 
-int initIEParsers()
+int initParserSet(gcd_parsers_t *parsers)
 {
-    memset(ie_table, 0, sizeof(ie_table));
-    return registerGtpv0IEParsers(ie_table[0])
-        && registerGtpv1IEParsers(ie_table[1])
-        && registerGtpv2IEParsers(ie_table[2]);
+    memset(parsers, 0, sizeof(*parsers));
+    return registerGtpv0IEParsers(parsers->table[0])
+        && registerGtpv1IEParsers(parsers->table[1])
+        && registerGtpv2IEParsers(parsers->table[2]);
 }
 
-int registerIEParser(uint8_t version, uint8_t ie, onIEParse parser)
+int registerParserSet(gcd_parsers_t *parsers, uint8_t version, uint8_t ie,
+                      onIEParse parser)
 {
     if (version > MAX_GTPC_VERSION) {
         return -1;
     }
     int ret = 0;
-    if (ie_table[version][ie]) {
+    if (parsers->table[version][ie]) {
         ret = 1;
     }
-    ie_table[version][ie] = parser;
+    parsers->table[version][ie] = parser;
+    GTP_IE_MASK_SET(&parsers->custom, version, ie);
     return ret;
 }
 
+int initIEParsers()
+{
+    return initParserSet(&default_parsers);
+}
+
+int registerIEParser(uint8_t version, uint8_t ie, onIEParse parser)
+{
+    return registerParserSet(&default_parsers, version, ie, parser);
+}
+
 int decodeGtpc(uint8_t *data, uint32_t len, gtp_t *gtp)
 {
     // decode header
-    int hdr_offset = decodeGtpcHeader(data, len, gtp);
+    gtp->err.code = GTP_ERR_NONE;
+    int hdr_offset = decodeGtpcHeader(data, len, &gtp->hdr, &gtp->err);
     if (hdr_offset == -1) {
-        printf("decode gtpc header error\n");
+        gcdLog(GCD_LOG_ERROR, "decode gtpc header error[%u]", gtp->err.code);
         return -1;
     }
 
-    return decodeGtpcBody(data + hdr_offset, len - hdr_offset, gtp,
-                          ie_table[gtp->hdr.version]);
+    return decodeGtpcBody(data, gtpcMessageLen(&gtp->hdr), hdr_offset,
+                          gtp, &default_parsers, NULL);
+}
+
+int decodeGtpcMasked(uint8_t *data, uint32_t len, gtp_t *gtp,
+                     const gtp_ie_mask_t *mask)
+{
+    gtp->err.code = GTP_ERR_NONE;
+    int hdr_offset = decodeGtpcHeader(data, len, &gtp->hdr, &gtp->err);
+    if (hdr_offset == -1) {
+        gcdLog(GCD_LOG_ERROR, "decode gtpc header error[%u]", gtp->err.code);
+        return -1;
+    }
+
+    return decodeGtpcBody(data, gtpcMessageLen(&gtp->hdr), hdr_offset,
+                          gtp, &default_parsers, mask);
+}
+
+#define GTPC_BATCH_PREFETCH 4
+
+uint32_t decodeGtpcBatch(uint8_t **data, uint32_t *len, gtp_t *gtp,
+                         int *status, uint32_t n)
+{
+    uint32_t ok = 0;
+
+    // warm up the first window
+    for (uint32_t i = 0; i < n && i < GTPC_BATCH_PREFETCH; i++) {
+        GCD_PREFETCH_R(data[i]);
+        GCD_PREFETCH_W(&gtp[i]);
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t next = i + GTPC_BATCH_PREFETCH;
+        if (next < n) {
+            GCD_PREFETCH_R(data[next]);
+            GCD_PREFETCH_R(data[next] + 64);
+            GCD_PREFETCH_W(&gtp[next]);
+            GCD_PREFETCH_W((uint8_t *)&gtp[next] + 64);
+        }
+        if (len[i] == 0) {
+            status[i] = -1;
+            continue;
+        }
+        status[i] = decodeGtpc(data[i], len[i], &gtp[i]);
+        ok += status[i] == 1;
+    }
+    return ok;
+}
+
+uint32_t decodeGtpcAll(uint8_t *data, uint32_t len, gtp_t *gtp, int *status,
+                       uint32_t max)
+{
+    uint32_t n = 0, offset = 0;
+    while (n < max && offset < len) {
+        status[n] = decodeGtpc(data + offset, len - offset, &gtp[n]);
+        if (status[n] == -1) {
+            return n + 1; // the next message can not be located
+        }
+        offset += gtpcMessageLen(&gtp[n].hdr);
+        if (!gtp[n++].hdr.piggyback) {
+            break;
+        }
+    }
+    return n;
 }
@@ -15,6 +15,7 @@ typedef struct gtp_header_s {
     uint16_t msgLen;
     uint32_t teid;
     uint32_t sqn;
+    uint8_t piggyback; // gtpv2 P flag, another message follows this one
 } gtp_header_t;
 
 #define BCD_TO_BUFFER_LEN(x) (((x) + 1) / 2)
@@ -133,13 +134,129 @@ typedef struct gtp_v1_body_s {
     char imei[MAX_IMEISV_BCD_LEN + 1];
     uint8_t bearerControlMode;
 } gtp_v1_body_t;
+#define MAX_INDICATION_LEN 8
+
+/* fully qualified TEID of TS 29.274 8.22 */
+typedef struct gtp_v2_fteid_s {
+    uint8_t present;
+    uint8_t ifType; // interface type, eg. 10 S11 MME GTP-C
+    uint8_t hasIpv4;
+    uint8_t hasIpv6;
+    uint32_t teid;
+    uint8_t ipv4[4];
+    uint8_t ipv6[16];
+} gtp_v2_fteid_t;
+
+/*
+ * user plane F-TEID inside a bearer context, kept compact as every slot
+ * carries MAX_BEARER_FTEID of them: an ipv6 address is only flagged, read
+ * it from the IE itself through the view or gtpcIEIterNext
+ */
+typedef struct gtp_v2_bearer_fteid_s {
+    uint32_t teid;
+    uint8_t ipv4[4];
+    uint8_t ifType;
+    uint8_t hasIpv4;
+    uint8_t hasIpv6;
+} gtp_v2_bearer_fteid_t;
+
+/* bearer context grouped IE of TS 29.274 8.28 */
+#define MAX_BEARER_FTEID 4
+typedef struct gtp_v2_bearer_s {
+    uint8_t instance; // eg. 0 to be created, 1 to be removed
+    uint8_t ebi;
+    uint8_t cause;
+    uint8_t qci;
+    uint8_t arp; // PCI, PL and PVI as sent
+    uint8_t fteidMask; // bit n set if fteid[n] is present
+    uint64_t mbrUplink; // kbps
+    uint64_t mbrDownlink;
+    uint64_t gbrUplink;
+    uint64_t gbrDownlink;
+    gtp_v2_bearer_fteid_t fteid[MAX_BEARER_FTEID]; // indexed by instance
+} gtp_v2_bearer_t;
+
+/* slots copied into gtp_t, further bearers are only counted in bearerTotal */
+#ifndef MAX_BEARER_CONTEXTS
+#define MAX_BEARER_CONTEXTS 4
+#endif
+
 typedef struct gtp_v2_body_s {
     char imsi[MAX_IMSI_BCD_LEN + 1];
     uint32_t teid;
+    uint8_t cause;
+    uint8_t recovery;
+    /*
+     * rat type values:
+     * 1 UTRAN
+     * 2 GERAN
+     * 6 EUTRAN
+     */
+    uint8_t ratType;
+    /*
+     * 1 IPv4
+     * 2 IPv6
+     * 3 IPv4v6
+     */
+    uint8_t pdnType;
+    uint8_t selectionMode;
+    uint8_t ebi; // EPS bearer id of instance 0, eg. the linked bearer
+    char msisdn[MAX_MSISDN_BCD_LEN + 1];
+    char mei[MAX_IMEISV_BCD_LEN + 1];
+    char apn[MAX_APN_LEN + 1];
+    char servingNetworkMcc[MAX_MCC_SIZE + 1];
+    char servingNetworkMnc[MAX_MNC_SIZE + 1];
+
+    /* user location information, uliFlags tells the parts present */
+#define GTPV2_ULI_CGI   0x01
+#define GTPV2_ULI_SAI   0x02
+#define GTPV2_ULI_RAI   0x04
+#define GTPV2_ULI_TAI   0x08
+#define GTPV2_ULI_ECGI  0x10
+#define GTPV2_ULI_LAI   0x20
+    uint8_t uliFlags;
+    char uliMcc[MAX_MCC_SIZE + 1]; // of the first part present
+    char uliMnc[MAX_MNC_SIZE + 1];
+    uint16_t uliLac;
+    uint16_t uliCi;
+    uint16_t uliSac;
+    uint16_t uliRac;
+    uint16_t uliTac;
+    uint32_t uliEci;
+
+    /* PDN address allocation, paaType has the values of pdnType */
+    uint8_t paaType;
+    uint8_t paaIpv6PrefixLen;
+    uint8_t paaIpv4[4];
+    uint8_t paaIpv6[16];
+    uint32_t ambrUplink; // kbps
+    uint32_t ambrDownlink;
+    uint8_t indicationLen;
+    uint8_t indication[MAX_INDICATION_LEN]; // flag octets as sent
+    gtp_v2_fteid_t senderFteid; // F-TEID instance 0
+    gtp_v2_fteid_t pgwFteid;    // F-TEID instance 1, PGW S5/S8 control plane
+    uint8_t bearerCount; // decoded into bearers
+    uint8_t bearerTotal; // present in the message, may exceed the slots
+    gtp_v2_bearer_t bearers[MAX_BEARER_CONTEXTS];
 } gtp_v2_body_t;
 
+/* decode error codes */
+#define GTP_ERR_NONE       0
+#define GTP_ERR_HEADER     1 // malformed or truncated header
+#define GTP_ERR_VERSION    2 // unsupported gtp version
+#define GTP_ERR_UNKNOWN_IE 3 // unknown TV IE, the IE chain can not be followed
+#define GTP_ERR_IE         4 // IE truncated or rejected by its parser
+#define GTP_ERR_MAX        5
+
+typedef struct gtp_error_s {
+    uint8_t code; // GTP_ERR_*
+    uint8_t ie;   // offending IE type, if any
+    uint32_t offset; // byte offset from the start of the message
+} gtp_error_t;
+
 typedef struct gtp_s {
     gtp_header_t hdr;
+    gtp_error_t err; // set when decoding fails
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
     union {
@@ -151,9 +268,25 @@ typedef struct gtp_s {
 
 } gtp_t;
 
+#define MAX_GTPC_VERSION 2
 #define MAX_IE 0xFF
 typedef int (*onIEParse)(uint8_t *data, uint32_t len, gtp_t *body);
 
+/* per version bitmap of interesting IE types */
+typedef struct gtp_ie_mask_s {
+    uint64_t bits[MAX_GTPC_VERSION + 1][(MAX_IE + 1) / 64];
+} gtp_ie_mask_t;
+#define GTP_IE_MASK_SET(m, v, ie) \
+    ((m)->bits[(v)][(ie) >> 6] |= 1ULL << ((ie) & 63))
+#define GTP_IE_MASK_CLEAR(m, v, ie) \
+    ((m)->bits[(v)][(ie) >> 6] &= ~(1ULL << ((ie) & 63)))
+#define GTP_IE_MASK_TEST(m, v, ie) \
+    (((m)->bits[(v)][(ie) >> 6] >> ((ie) & 63)) & 1)
+
+#define GCD_LOG_WARN  1
+#define GCD_LOG_ERROR 2
+typedef void (*onGcdLog)(int level, const char *msg, void *arg);
+
 /**
  * init all IEs
  * @return
@@ -170,13 +303,46 @@ GCD_PUBLIC int initIEParsers();
  */
 GCD_PUBLIC int registerIEParser(uint8_t version, uint8_t ie, onIEParse parser);
 /**
- * decode gtpc data
+ * route decoder diagnostics to logger, at most maxPerSecond messages per
+ * second (0 for no limit). no logger is set by default and decoding never
+ * does any I/O on its own, pass NULL to remove the logger
+ */
+GCD_PUBLIC void gcdSetLogger(onGcdLog logger, void *arg, uint32_t maxPerSecond);
+/**
+ * decode gtpc data, gtp->err tells what went wrong on failure
  * @return
  *   -1 on decode header error or not supported version
  *   0  on decode body error
  *   1  on success
  */
 GCD_PUBLIC int decodeGtpc(uint8_t *data, uint32_t len, gtp_t *gtp);
+/**
+ * decode gtpc data but only run the parsers of IEs set in mask, the others
+ * are skipped by length without touching gtp
+ * @return
+ *   same as decodeGtpc
+ */
+GCD_PUBLIC int decodeGtpcMasked(uint8_t *data, uint32_t len, gtp_t *gtp,
+                                const gtp_ie_mask_t *mask);
+/**
+ * decode a batch of gtpc messages, data[i] with len[i] is decoded into gtp[i]
+ * and its decodeGtpc() return value is stored in status[i]. the following
+ * packets and output slots are prefetched while the current one is decoded.
+ * @return
+ *   number of messages decoded successfully
+ */
+GCD_PUBLIC uint32_t decodeGtpcBatch(uint8_t **data, uint32_t *len, gtp_t *gtp,
+                                    int *status, uint32_t n);
+/**
+ * decode a datagram holding a gtpv2 message and the messages piggybacked
+ * on it in one pass, message i is decoded in place into gtp[i] with its
+ * decodeGtpc() return value in status[i]. decodeGtpc() alone only decodes
+ * the first message
+ * @return
+ *   number of messages found, at most max
+ */
+GCD_PUBLIC uint32_t decodeGtpcAll(uint8_t *data, uint32_t len, gtp_t *gtp,
+                                  int *status, uint32_t max);
 
 #ifdef __cplusplus
 }
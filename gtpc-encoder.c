@@ -0,0 +1,603 @@
+#include "gtpc-encoder.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#define GTPV0_HEADER_LEN             20
+#define GTPV1_HEADER_LEN             12
+#define GTPV1_INTERNATIONAL_NUMBER   0x91
+
+/* room for n more bytes, NULL once the buffer ran out */
+static inline uint8_t *reserve(gcd_encoder_t *enc, uint32_t n)
+{
+    if (enc->overflow || enc->cap - enc->len < n) {
+        enc->overflow = 1;
+        return NULL;
+    }
+    uint8_t *p = enc->buf + enc->len;
+    enc->len += n;
+    return p;
+}
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/*
+ * pack decimal digits into BCD, low nibble first, an odd count is padded
+ * with 0xF up to size bytes (0 for just enough)
+ * @return
+ *   bytes written
+ */
+static uint32_t packBcd(const char *digits, uint8_t *out, uint32_t size)
+{
+    uint32_t n = 0;
+    for (; digits[n] && n < 2 * MAX_IMEISV_LEN; n++) {
+        uint8_t d = digits[n] & 0x0F;
+        if (n % 2) {
+            out[n / 2] |= d << 4;
+        } else {
+            out[n / 2] = d;
+        }
+    }
+    if (n % 2) {
+        out[n / 2] |= 0xF0;
+    }
+    uint32_t len = (n + 1) / 2;
+    for (; len < size; len++) {
+        out[len] = 0xFF;
+    }
+    return len;
+}
+
+/* mcc and mnc digits in the 3 octet PLMN form of ts 24.008 */
+static void packPlmn(const char *mcc, const char *mnc, uint8_t *out)
+{
+    uint8_t m[3], n[3];
+    for (int i = 0; i < 3; i++) {
+        m[i] = mcc[i] ? mcc[i] & 0x0F : 0;
+    }
+    n[0] = mnc[0] ? mnc[0] & 0x0F : 0;
+    n[1] = mnc[0] && mnc[1] ? mnc[1] & 0x0F : 0;
+    n[2] = mnc[0] && mnc[1] && mnc[2] ? mnc[2] & 0x0F : 0x0F;
+    out[0] = m[1] << 4 | m[0];
+    out[1] = n[2] << 4 | m[2];
+    out[2] = n[1] << 4 | n[0];
+}
+
+void gcdEncodeNext(gcd_encoder_t *enc, const gtp_header_t *hdr)
+{
+    uint8_t *p;
+    enc->start = enc->len;
+    enc->version = hdr->version;
+    enc->depth = 0;
+    switch (hdr->version) {
+    case 0:
+        if ((p = reserve(enc, GTPV0_HEADER_LEN))) {
+            memset(p, 0, GTPV0_HEADER_LEN);
+            p[0] = 0x1E; // version 0, PT 1, spare bits set
+            p[1] = hdr->msgType;
+            put16(p + 4, hdr->sqn);
+            put16(p + 6, hdr->teid); // flow label
+            p[8] = 0xFF; // no SNDCP N-PDU LLC number
+            memset(p + 9, 0xFF, 3);
+        }
+        break;
+    case 1:
+        if ((p = reserve(enc, GTPV1_HEADER_LEN))) {
+            p[0] = 0x32; // version 1, PT 1, S
+            p[1] = hdr->msgType;
+            put32(p + 4, hdr->teid);
+            put16(p + 8, hdr->sqn);
+            p[10] = 0; // N-PDU number
+            p[11] = 0; // next extension header type
+        }
+        break;
+    case 2: {
+        // echo and version not supported indication go without TEID
+        int teid = hdr->msgType > 3;
+        if ((p = reserve(enc, teid ? 12 : 8))) {
+            p[0] = 0x40 | (hdr->piggyback ? 0x10 : 0) | (teid ? 0x08 : 0);
+            p[1] = hdr->msgType;
+            if (teid) {
+                put32(p + 4, hdr->teid);
+                p += 4;
+            }
+            put32(p + 4, hdr->sqn << 8);
+        }
+        break;
+    }
+    default:
+        enc->overflow = 1;
+        break;
+    }
+}
+
+void gcdEncodeBegin(gcd_encoder_t *enc, uint8_t *buf, uint32_t cap,
+                    const gtp_header_t *hdr)
+{
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->len = 0;
+    enc->overflow = 0;
+    gcdEncodeNext(enc, hdr);
+}
+
+void gcdEncodeTid(gcd_encoder_t *enc, const char *imsi, uint8_t nsapi)
+{
+    uint8_t tid[MAX_IMEISV_LEN];
+    if (enc->version != 0 || enc->overflow) {
+        return;
+    }
+    packBcd(imsi, tid, 8);
+    tid[7] = (tid[7] & 0x0F) | nsapi << 4;
+    memcpy(enc->buf + enc->start + 12, tid, 8);
+}
+
+void gcdEncodeTv(gcd_encoder_t *enc, uint8_t type, const void *value,
+                 uint8_t len)
+{
+    uint8_t *p = reserve(enc, 1 + len);
+    if (p) {
+        p[0] = type;
+        memcpy(p + 1, value, len);
+    }
+}
+
+void gcdEncodeTlv(gcd_encoder_t *enc, uint8_t type, uint8_t instance,
+                  const void *value, uint16_t len)
+{
+    uint32_t hlen = enc->version == 2 ? 4 : 3;
+    uint8_t *p = reserve(enc, hlen + len);
+    if (p) {
+        p[0] = type;
+        put16(p + 1, len);
+        if (hlen == 4) {
+            p[3] = instance & 0x0F;
+        }
+        if (len) {
+            memcpy(p + hlen, value, len);
+        }
+    }
+}
+
+void gcdEncodeDigits(gcd_encoder_t *enc, uint8_t type, uint8_t instance,
+                     const char *digits)
+{
+    uint8_t bcd[1 + MAX_IMEISV_LEN];
+    if (enc->version == 2) {
+        gcdEncodeTlv(enc, type, instance, bcd, packBcd(digits, bcd, 0));
+    } else if (type == GTPV1_IMSI) {
+        packBcd(digits, bcd, MAX_IMSI_LEN);
+        gcdEncodeTv(enc, type, bcd, MAX_IMSI_LEN);
+    } else if (type == GTPV1_MSISDN) {
+        bcd[0] = GTPV1_INTERNATIONAL_NUMBER;
+        gcdEncodeTlv(enc, type, 0, bcd, 1 + packBcd(digits, bcd + 1, 0));
+    } else {
+        gcdEncodeTlv(enc, type, 0, bcd, packBcd(digits, bcd, 0));
+    }
+}
+
+void gcdEncodeApn(gcd_encoder_t *enc, uint8_t type, uint8_t instance,
+                  const char *apn)
+{
+    uint8_t labels[MAX_APN_LEN + 1];
+    uint32_t len = 0, mark = 0;
+    for (; apn[len] && len < MAX_APN_LEN; len++) {
+        if (apn[len] == '.') {
+            labels[mark] = len - mark;
+            mark = len + 1;
+        } else {
+            labels[len + 1] = apn[len];
+        }
+    }
+    labels[mark] = len - mark;
+    gcdEncodeTlv(enc, type, instance, labels, len + 1);
+}
+
+void gcdEncodeFteid(gcd_encoder_t *enc, uint8_t instance,
+                    const gtp_v2_fteid_t *fteid)
+{
+    uint8_t v[25];
+    uint32_t len = 5;
+    v[0] = (fteid->hasIpv4 ? 0x80 : 0) | (fteid->hasIpv6 ? 0x40 : 0)
+           | (fteid->ifType & 0x3F);
+    put32(v + 1, fteid->teid);
+    if (fteid->hasIpv4) {
+        memcpy(v + len, fteid->ipv4, 4);
+        len += 4;
+    }
+    if (fteid->hasIpv6) {
+        memcpy(v + len, fteid->ipv6, 16);
+        len += 16;
+    }
+    gcdEncodeTlv(enc, GTPV2_FTEID, instance, v, len);
+}
+
+void gcdEncodeGroupBegin(gcd_encoder_t *enc, uint8_t type, uint8_t instance)
+{
+    if (enc->depth == MAX_IE_DEPTH) {
+        enc->overflow = 1;
+        return;
+    }
+    uint32_t offset = enc->len;
+    gcdEncodeTlv(enc, type, instance, NULL, 0);
+    enc->groups[enc->depth++] = offset;
+}
+
+void gcdEncodeGroupEnd(gcd_encoder_t *enc)
+{
+    if (enc->depth == 0) {
+        enc->overflow = 1;
+        return;
+    }
+    uint32_t offset = enc->groups[--enc->depth];
+    if (!enc->overflow) {
+        put16(enc->buf + offset + 1, enc->len - offset - 4);
+    }
+}
+
+int gcdEncodeEnd(gcd_encoder_t *enc)
+{
+    if (enc->overflow || enc->depth) {
+        return -1;
+    }
+    uint8_t *p = enc->buf + enc->start;
+    uint32_t len = enc->len - enc->start;
+    // the length leaves out the mandatory header part
+    uint32_t skip = enc->version == 0 ? GTPV0_HEADER_LEN
+                                      : (enc->version == 1 ? 8 : 4);
+    if (len - skip > UINT16_MAX) {
+        return -1;
+    }
+    put16(p + 2, len - skip);
+    return enc->len;
+}
+
+static void encodeU8(gcd_encoder_t *enc, uint8_t type, uint8_t value)
+{
+    if (value) {
+        if (enc->version == 2) {
+            gcdEncodeTlv(enc, type, 0, &value, 1);
+        } else {
+            gcdEncodeTv(enc, type, &value, 1);
+        }
+    }
+}
+
+static void encodeTv32(gcd_encoder_t *enc, uint8_t type, uint32_t value)
+{
+    uint8_t v[4];
+    if (value) {
+        put32(v, value);
+        gcdEncodeTv(enc, type, v, 4);
+    }
+}
+
+static void encodeString(gcd_encoder_t *enc, uint8_t type, const char *s)
+{
+    if (s[0]) {
+        gcdEncodeDigits(enc, type, 0, s);
+    }
+}
+
+static void encodeAddress(gcd_encoder_t *enc, uint8_t type, const char *ip)
+{
+    uint8_t addr[16];
+    if (inet_pton(AF_INET, ip, addr) == 1) {
+        gcdEncodeTlv(enc, type, 0, addr, 4);
+    } else if (inet_pton(AF_INET6, ip, addr) == 1) {
+        gcdEncodeTlv(enc, type, 0, addr, 16);
+    }
+}
+
+static void encodeEndUserAddress(gcd_encoder_t *enc, uint8_t org,
+                                 uint8_t num, const char *ip)
+{
+    uint8_t v[18];
+    uint16_t len = 2;
+    if (!org && !num && !ip[0]) {
+        return;
+    }
+    v[0] = 0xF0 | org;
+    v[1] = num;
+    if (inet_pton(AF_INET, ip, v + 2) == 1) {
+        len += 4;
+    } else if (inet_pton(AF_INET6, ip, v + 2) == 1) {
+        len += 16;
+    }
+    gcdEncodeTlv(enc, GTPV1_END_USER_ADDRESS, 0, v, len);
+}
+
+static void encodeRai(gcd_encoder_t *enc, const char *mcc, const char *mnc,
+                      uint16_t lac, uint8_t rac)
+{
+    uint8_t v[6];
+    if (!mcc[0]) {
+        return;
+    }
+    packPlmn(mcc, mnc, v);
+    put16(v + 3, lac);
+    v[5] = rac;
+    gcdEncodeTv(enc, GTPV1_ROUTING_AREA_IDENTITY, v, 6);
+}
+
+static void encodeGtpv0(gcd_encoder_t *enc, const gtp_v0_body_t *b)
+{
+    static const uint8_t noQos[3];
+    uint8_t v[2];
+    gcdEncodeTid(enc, b->imsi, 0);
+    encodeU8(enc, GTPV1_CAUSE, b->cause);
+    encodeString(enc, GTPV1_IMSI, b->imsi);
+    encodeRai(enc, b->routingAreaIdentityMcc, b->routingAreaIdentityMnc,
+              b->routingAreaIdentityLac, b->routingAreaIdentityRac);
+    if (memcmp(b->qos, noQos, 3)) {
+        gcdEncodeTv(enc, GTPV0_QUALITY_OF_SERVICE, b->qos, 3);
+    }
+    encodeU8(enc, GTPV1_REORDERING_REQUIRED, b->reordering);
+    encodeU8(enc, GTPV1_RECOVERY, b->recovery);
+    encodeU8(enc, GTPV1_SELECTION_MODE, b->selectionMode);
+    if (b->flowLabelData) {
+        put16(v, b->flowLabelData);
+        gcdEncodeTv(enc, GTPV0_FLOW_LABEL_DATA_I, v, 2);
+    }
+    if (b->flowLabelSignalling) {
+        put16(v, b->flowLabelSignalling);
+        gcdEncodeTv(enc, GTPV0_FLOW_LABEL_SIGNALLING, v, 2);
+    }
+    encodeU8(enc, GTPV0_MS_NOT_REACHABLE, b->msNotReachableReason);
+    encodeTv32(enc, GTPV1_CHARGING_ID, b->chargingId);
+    encodeEndUserAddress(enc, b->pdpTypeOrg, b->pdpTypeNum, b->endUserAddress);
+    if (b->apn[0]) {
+        gcdEncodeApn(enc, GTPV1_ACCESS_POINT_NAME, 0, b->apn);
+    }
+    if (b->gsnAddressSignal[0]) {
+        encodeAddress(enc, GTPV1_GSN_ADDRESS, b->gsnAddressSignal);
+        encodeAddress(enc, GTPV1_GSN_ADDRESS, b->gsnAddressUser);
+    }
+    encodeString(enc, GTPV1_MSISDN, b->msisdn);
+}
+
+static void encodeGtpv1(gcd_encoder_t *enc, const gtp_v1_body_t *b)
+{
+    uint8_t v[8];
+    encodeU8(enc, GTPV1_CAUSE, b->cause);
+    encodeString(enc, GTPV1_IMSI, b->imsi);
+    encodeRai(enc, b->routingAreaIdentityMcc, b->routingAreaIdentityMnc,
+              b->routingAreaIdentityLac, b->routingAreaIdentityRac);
+    encodeU8(enc, GTPV1_REORDERING_REQUIRED, b->reordering);
+    encodeU8(enc, GTPV1_RECOVERY, b->recovery);
+    encodeU8(enc, GTPV1_SELECTION_MODE, b->selectionMode);
+    encodeTv32(enc, GTPV1_TEID_DATA_I, b->teid);
+    encodeTv32(enc, GTPV1_TEID_CONTROL_PLANE, b->teidControlPlane);
+    encodeU8(enc, GTPV1_TEARDOWN_IND, b->teardownInd);
+    encodeU8(enc, GTPV1_NSAPI, b->nsapi);
+    if (b->chargingFlags) {
+        v[0] = b->chargingFlags;
+        v[1] = 0;
+        gcdEncodeTv(enc, GTPV1_CHARGING_CHARS, v, 2);
+    }
+    encodeTv32(enc, GTPV1_CHARGING_ID, b->chargingId);
+    encodeEndUserAddress(enc, b->pdpTypeOrg, b->pdpTypeNum, b->endUserAddress);
+    if (b->apn[0]) {
+        gcdEncodeApn(enc, GTPV1_ACCESS_POINT_NAME, 0, b->apn);
+    }
+    if (b->gsnAddressSignal[0]) {
+        encodeAddress(enc, GTPV1_GSN_ADDRESS, b->gsnAddressSignal);
+        encodeAddress(enc, GTPV1_GSN_ADDRESS, b->gsnAddressUser);
+    }
+    encodeString(enc, GTPV1_MSISDN, b->msisdn);
+    if (b->priority) {
+        // allocation/retention priority, the release 97 profile follows
+        v[0] = b->priority;
+        v[1] = 0x0B;
+        v[2] = 0x92;
+        v[3] = 0x1F;
+        gcdEncodeTlv(enc, GTPV1_QUALITY_OF_SERVICE, 0, v, 4);
+    }
+    if (b->commonFlags) {
+        gcdEncodeTlv(enc, GTPV1_COMMON_FLAGS, 0, &b->commonFlags, 1);
+    }
+    if (b->ratType) {
+        gcdEncodeTlv(enc, GTPV1_RAT_TYPE, 0, &b->ratType, 1);
+    }
+    if (b->userLocationInforMcc[0]) {
+        v[0] = 0; // CGI
+        packPlmn(b->userLocationInforMcc, b->userLocationInforMnc, v + 1);
+        put16(v + 4, b->userLocationInforLac);
+        put16(v + 6, b->userLocationInforCellId);
+        gcdEncodeTlv(enc, GTPV1_ULI, 0, v, 8);
+    }
+    if (b->timezone || b->dst) {
+        v[0] = b->timezone;
+        v[1] = b->dst;
+        gcdEncodeTlv(enc, GTPV1_MS_TIME_ZONE, 0, v, 2);
+    }
+    encodeString(enc, GTPV1_IMEI, b->imei);
+    if (b->bearerControlMode) {
+        gcdEncodeTlv(enc, GTPV1_BEARER_CONTROL_MODE, 0, &b->bearerControlMode,
+                     1);
+    }
+}
+
+/* 40 bit bit rate of the bearer qos */
+static inline void putBitRate(uint8_t *p, uint64_t rate)
+{
+    p[0] = rate >> 32;
+    put32(p + 1, rate);
+}
+
+static void encodeBearer(gcd_encoder_t *enc, const gtp_v2_bearer_t *bearer)
+{
+    uint8_t v[22];
+    gcdEncodeGroupBegin(enc, GTPV2_BEARER_CONTEXT, bearer->instance);
+    if (bearer->cause) {
+        v[0] = bearer->cause;
+        v[1] = 0;
+        gcdEncodeTlv(enc, GTPV2_CAUSE, 0, v, 2);
+    }
+    encodeU8(enc, GTPV2_EBI, bearer->ebi);
+    if (bearer->qci) {
+        v[0] = bearer->arp;
+        v[1] = bearer->qci;
+        putBitRate(v + 2, bearer->mbrUplink);
+        putBitRate(v + 7, bearer->mbrDownlink);
+        putBitRate(v + 12, bearer->gbrUplink);
+        putBitRate(v + 17, bearer->gbrDownlink);
+        gcdEncodeTlv(enc, GTPV2_BEARER_QOS, 0, v, 22);
+    }
+    for (uint8_t i = 0; i < MAX_BEARER_FTEID; i++) {
+        if (!(bearer->fteidMask & (1 << i))) {
+            continue;
+        }
+        // the compact form has no ipv6 address, only ipv4 is sent
+        const gtp_v2_bearer_fteid_t *f = &bearer->fteid[i];
+        gtp_v2_fteid_t fteid = {.present = 1,
+                                .ifType = f->ifType,
+                                .hasIpv4 = f->hasIpv4,
+                                .teid = f->teid};
+        memcpy(fteid.ipv4, f->ipv4, sizeof(fteid.ipv4));
+        gcdEncodeFteid(enc, i, &fteid);
+    }
+    gcdEncodeGroupEnd(enc);
+}
+
+static void encodeUli(gcd_encoder_t *enc, const gtp_v2_body_t *b)
+{
+    uint8_t v[1 + 7 * 4 + 5 * 2], plmn[3];
+    uint32_t len = 1;
+    packPlmn(b->uliMcc, b->uliMnc, plmn);
+    v[0] = b->uliFlags;
+    // the parts follow the order of their flags
+    if (b->uliFlags & GTPV2_ULI_CGI) {
+        memcpy(v + len, plmn, 3);
+        put16(v + len + 3, b->uliLac);
+        put16(v + len + 5, b->uliCi);
+        len += 7;
+    }
+    if (b->uliFlags & GTPV2_ULI_SAI) {
+        memcpy(v + len, plmn, 3);
+        put16(v + len + 3, b->uliLac);
+        put16(v + len + 5, b->uliSac);
+        len += 7;
+    }
+    if (b->uliFlags & GTPV2_ULI_RAI) {
+        memcpy(v + len, plmn, 3);
+        put16(v + len + 3, b->uliLac);
+        v[len + 5] = b->uliRac;
+        v[len + 6] = 0xFF;
+        len += 7;
+    }
+    if (b->uliFlags & GTPV2_ULI_TAI) {
+        memcpy(v + len, plmn, 3);
+        put16(v + len + 3, b->uliTac);
+        len += 5;
+    }
+    if (b->uliFlags & GTPV2_ULI_ECGI) {
+        memcpy(v + len, plmn, 3);
+        put32(v + len + 3, b->uliEci & 0x0FFFFFFF);
+        len += 7;
+    }
+    if (b->uliFlags & GTPV2_ULI_LAI) {
+        memcpy(v + len, plmn, 3);
+        put16(v + len + 3, b->uliLac);
+        len += 5;
+    }
+    gcdEncodeTlv(enc, GTPV2_ULI, 0, v, len);
+}
+
+static void encodeGtpv2(gcd_encoder_t *enc, const gtp_v2_body_t *b)
+{
+    uint8_t v[22];
+    uint32_t len;
+    encodeString(enc, GTPV2_IMSI, b->imsi);
+    if (b->cause) {
+        v[0] = b->cause;
+        v[1] = 0;
+        gcdEncodeTlv(enc, GTPV2_CAUSE, 0, v, 2);
+    }
+    encodeU8(enc, GTPV2_RECOVERY, b->recovery);
+    if (b->apn[0]) {
+        gcdEncodeApn(enc, GTPV2_APN, 0, b->apn);
+    }
+    if (b->ambrUplink || b->ambrDownlink) {
+        put32(v, b->ambrUplink);
+        put32(v + 4, b->ambrDownlink);
+        gcdEncodeTlv(enc, GTPV2_AMBR, 0, v, 8);
+    }
+    encodeU8(enc, GTPV2_EBI, b->ebi);
+    encodeString(enc, GTPV2_MEI, b->mei);
+    encodeString(enc, GTPV2_MSISDN, b->msisdn);
+    if (b->indicationLen) {
+        gcdEncodeTlv(enc, GTPV2_INDICATION, 0, b->indication,
+                     b->indicationLen);
+    }
+    if (b->paaType) {
+        v[0] = b->paaType;
+        len = 1;
+        if (b->paaType == 1) {
+            memcpy(v + 1, b->paaIpv4, 4);
+            len += 4;
+        } else {
+            v[1] = b->paaIpv6PrefixLen;
+            memcpy(v + 2, b->paaIpv6, 16);
+            len += 17;
+            if (b->paaType == 3) {
+                memcpy(v + 18, b->paaIpv4, 4);
+                len += 4;
+            }
+        }
+        gcdEncodeTlv(enc, GTPV2_PAA, 0, v, len);
+    }
+    encodeU8(enc, GTPV2_RAT_TYPE, b->ratType);
+    if (b->servingNetworkMcc[0]) {
+        packPlmn(b->servingNetworkMcc, b->servingNetworkMnc, v);
+        gcdEncodeTlv(enc, GTPV2_SERVING_NETWORK, 0, v, 3);
+    }
+    if (b->uliFlags) {
+        encodeUli(enc, b);
+    }
+    if (b->senderFteid.present) {
+        gcdEncodeFteid(enc, 0, &b->senderFteid);
+    }
+    if (b->pgwFteid.present) {
+        gcdEncodeFteid(enc, 1, &b->pgwFteid);
+    }
+    for (uint8_t i = 0; i < b->bearerCount && i < MAX_BEARER_CONTEXTS; i++) {
+        encodeBearer(enc, &b->bearers[i]);
+    }
+    encodeU8(enc, GTPV2_PDN_TYPE, b->pdnType);
+    encodeU8(enc, GTPV2_SELECTION_MODE, b->selectionMode);
+}
+
+int encodeGtpc(const gtp_t *gtp, uint8_t *buf, uint32_t len)
+{
+    gcd_encoder_t enc;
+    gtp_header_t hdr = gtp->hdr;
+    hdr.piggyback = 0;
+    gcdEncodeBegin(&enc, buf, len, &hdr);
+    switch (hdr.version) {
+    case 0:
+        encodeGtpv0(&enc, &gtp->b0);
+        break;
+    case 1:
+        encodeGtpv1(&enc, &gtp->b1);
+        break;
+    case 2:
+        encodeGtpv2(&enc, &gtp->b2);
+        break;
+    default:
+        return -1;
+    }
+    return gcdEncodeEnd(&enc);
+}
@@ -0,0 +1,149 @@
+#ifndef GTPC_ENCODER_H_
+#define GTPC_ENCODER_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+#include "gtpc-view.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * IE types written by encodeGtpc(), ts 29.060 (also v0) and ts 29.274,
+ * for the type argument of the gcdEncode* calls
+ */
+#define GTPV1_CAUSE                  0x01
+#define GTPV1_IMSI                   0x02
+#define GTPV1_ROUTING_AREA_IDENTITY  0x03
+#define GTPV0_QUALITY_OF_SERVICE     0x06
+#define GTPV1_REORDERING_REQUIRED    0x08
+#define GTPV1_RECOVERY               0x0E
+#define GTPV1_SELECTION_MODE         0x0F
+#define GTPV1_TEID_DATA_I            0x10
+#define GTPV1_TEID_CONTROL_PLANE     0x11
+#define GTPV0_FLOW_LABEL_DATA_I      0x10
+#define GTPV0_FLOW_LABEL_SIGNALLING  0x11
+#define GTPV0_MS_NOT_REACHABLE       0x13
+#define GTPV1_TEARDOWN_IND           0x13
+#define GTPV1_NSAPI                  0x14
+#define GTPV1_CHARGING_CHARS         0x1A
+#define GTPV1_CHARGING_ID            0x7F
+#define GTPV1_END_USER_ADDRESS       0x80
+#define GTPV1_ACCESS_POINT_NAME      0x83
+#define GTPV1_GSN_ADDRESS            0x85
+#define GTPV1_MSISDN                 0x86
+#define GTPV1_QUALITY_OF_SERVICE     0x87
+#define GTPV1_COMMON_FLAGS           0x94
+#define GTPV1_RAT_TYPE               0x97
+#define GTPV1_ULI                    0x98
+#define GTPV1_MS_TIME_ZONE           0x99
+#define GTPV1_IMEI                   0x9A
+#define GTPV1_BEARER_CONTROL_MODE    0xB8
+
+#define GTPV2_IMSI                   1
+#define GTPV2_CAUSE                  2
+#define GTPV2_RECOVERY               3
+#define GTPV2_APN                    71
+#define GTPV2_AMBR                   72
+#define GTPV2_EBI                    73
+#define GTPV2_MEI                    75
+#define GTPV2_MSISDN                 76
+#define GTPV2_INDICATION             77
+#define GTPV2_PAA                    79
+#define GTPV2_BEARER_QOS             80
+#define GTPV2_RAT_TYPE               82
+#define GTPV2_SERVING_NETWORK        83
+#define GTPV2_ULI                    86
+#define GTPV2_FTEID                  87
+#define GTPV2_BEARER_CONTEXT         93
+#define GTPV2_PDN_TYPE               99
+#define GTPV2_SELECTION_MODE         128
+
+/*
+ * message builder writing straight into a caller buffer, nothing is
+ * allocated. IEs are appended in the order they are encoded, running out
+ * of room is remembered and reported by gcdEncodeEnd()
+ */
+typedef struct gcd_encoder_s {
+    uint8_t *buf;
+    uint32_t cap;
+    uint32_t len;
+    uint32_t start; // of the current message
+    uint8_t version;
+    uint8_t overflow;
+    uint8_t depth; // open grouped IEs
+    uint32_t groups[MAX_IE_DEPTH];
+} gcd_encoder_t;
+
+/**
+ * start a message at the end of buf, hdr gives version, type, teid, sqn
+ * and for gtpv2 the piggyback flag. gtpv0 messages start with an all zero
+ * TID, see gcdEncodeTid()
+ */
+GCD_PUBLIC void gcdEncodeBegin(gcd_encoder_t *enc, uint8_t *buf, uint32_t cap,
+                               const gtp_header_t *hdr);
+/**
+ * start another message behind the one just ended, eg. a gtpv2 message
+ * piggybacked on the previous one
+ */
+GCD_PUBLIC void gcdEncodeNext(gcd_encoder_t *enc, const gtp_header_t *hdr);
+/**
+ * fill the gtpv0 TID of the current message from imsi and nsapi
+ */
+GCD_PUBLIC void gcdEncodeTid(gcd_encoder_t *enc, const char *imsi,
+                             uint8_t nsapi);
+/**
+ * append a gtpv0/v1 TV IE, len must be the fixed length of type
+ */
+GCD_PUBLIC void gcdEncodeTv(gcd_encoder_t *enc, uint8_t type,
+                            const void *value, uint8_t len);
+/**
+ * append a TLV IE, instance is only encoded for gtpv2
+ */
+GCD_PUBLIC void gcdEncodeTlv(gcd_encoder_t *enc, uint8_t type,
+                             uint8_t instance, const void *value,
+                             uint16_t len);
+/**
+ * append an IE holding the BCD digits of imsi, msisdn or imei in the form
+ * of the current version, eg. the gtpv0/v1 IMSI is a TV padded with 0xF
+ * and the gtpv1 MSISDN carries the international number prefix
+ */
+GCD_PUBLIC void gcdEncodeDigits(gcd_encoder_t *enc, uint8_t type,
+                                uint8_t instance, const char *digits);
+/**
+ * append an APN IE, the dotted name is turned into length prefixed labels
+ */
+GCD_PUBLIC void gcdEncodeApn(gcd_encoder_t *enc, uint8_t type,
+                             uint8_t instance, const char *apn);
+GCD_PUBLIC void gcdEncodeFteid(gcd_encoder_t *enc, uint8_t instance,
+                               const gtp_v2_fteid_t *fteid);
+/**
+ * open a gtpv2 grouped IE, the IEs encoded until gcdEncodeGroupEnd() are
+ * its children. at most MAX_IE_DEPTH groups can be open
+ */
+GCD_PUBLIC void gcdEncodeGroupBegin(gcd_encoder_t *enc, uint8_t type,
+                                    uint8_t instance);
+GCD_PUBLIC void gcdEncodeGroupEnd(gcd_encoder_t *enc);
+/**
+ * fill the length of the current message
+ * @return
+ *   -1 buf too small or a group is still open
+ *   otherwise bytes used in buf by all messages so far
+ */
+GCD_PUBLIC int gcdEncodeEnd(gcd_encoder_t *enc);
+/**
+ * encode the header and every field of gtp that is set, ie. non-zero
+ * numbers and non-empty strings, so decodeGtpc() gives those fields back
+ * @return
+ *   -1 buf too small or unsupported version
+ *   otherwise length of the message
+ */
+GCD_PUBLIC int encodeGtpc(const gtp_t *gtp, uint8_t *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
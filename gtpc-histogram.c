@@ -0,0 +1,95 @@
+#include "gtpc-histogram.h"
+
+#include <string.h>
+
+#define SUB_COUNT (1U << GCD_HISTOGRAM_SUB_BITS)
+
+/*
+ * values below SUB_COUNT get a bucket each, above that the top
+ * GCD_HISTOGRAM_SUB_BITS + 1 bits of the value pick the bucket
+ */
+static inline uint32_t bucketOf(uint64_t value)
+{
+    if (value < SUB_COUNT) {
+        return value;
+    }
+    uint32_t msb = 63 - __builtin_clzll(value);
+    if (msb >= GCD_HISTOGRAM_MAX_BITS) {
+        return GCD_HISTOGRAM_BUCKETS - 1;
+    }
+    uint32_t shift = msb - GCD_HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << GCD_HISTOGRAM_SUB_BITS)
+           + ((value >> shift) & (SUB_COUNT - 1));
+}
+
+/* largest value that lands in bucket b */
+static inline uint64_t bucketHigh(uint32_t b)
+{
+    if (b < 2 * SUB_COUNT) {
+        return b;
+    }
+    uint32_t shift = (b >> GCD_HISTOGRAM_SUB_BITS) - 1;
+    uint64_t base = (uint64_t)(SUB_COUNT | (b & (SUB_COUNT - 1))) << shift;
+    return base + (1ULL << shift) - 1;
+}
+
+void gcdHistogramReset(gcd_histogram_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void gcdHistogramRecord(gcd_histogram_t *h, uint64_t value)
+{
+    if (h->count == 0 || value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+    h->count++;
+    h->sum += value;
+    h->buckets[bucketOf(value)]++;
+}
+
+void gcdHistogramMerge(gcd_histogram_t *dst, const gcd_histogram_t *src)
+{
+    if (src->count == 0) {
+        return;
+    }
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    for (uint32_t i = 0; i < GCD_HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+uint64_t gcdHistogramPercentile(const gcd_histogram_t *h, double pct)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+    if (pct > 100) {
+        pct = 100;
+    } else if (!(pct >= 0)) {
+        pct = 0; // negative or nan
+    }
+    uint64_t rank = (uint64_t)(pct / 100 * h->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < GCD_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t high = bucketHigh(i);
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
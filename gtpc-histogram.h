@@ -0,0 +1,51 @@
+#ifndef GTPC_HISTOGRAM_H_
+#define GTPC_HISTOGRAM_H_
+
+#include <stdint.h>
+
+#include "macros.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * log-linear histogram in the style of HdrHistogram: every power of two is
+ * split into 2^GCD_HISTOGRAM_SUB_BITS buckets, so any recorded value is
+ * reported within 1/32 (~3%) of itself. values from 0 to 2^40 (~18 minutes
+ * in nanoseconds) fit, larger ones are clamped into the last bucket
+ */
+#define GCD_HISTOGRAM_SUB_BITS 5
+#define GCD_HISTOGRAM_MAX_BITS 40
+#define GCD_HISTOGRAM_BUCKETS                                                  \
+    ((GCD_HISTOGRAM_MAX_BITS - GCD_HISTOGRAM_SUB_BITS + 1)                     \
+     << GCD_HISTOGRAM_SUB_BITS)
+
+typedef struct gcd_histogram_s {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[GCD_HISTOGRAM_BUCKETS];
+} gcd_histogram_t;
+
+GCD_PUBLIC void gcdHistogramReset(gcd_histogram_t *h);
+GCD_PUBLIC void gcdHistogramRecord(gcd_histogram_t *h, uint64_t value);
+/**
+ * add the counts of src to dst, eg. to merge the histograms of threads
+ */
+GCD_PUBLIC void gcdHistogramMerge(gcd_histogram_t *dst,
+                                  const gcd_histogram_t *src);
+/**
+ * @return
+ *   the value below which pct percent (clamped to 0..100) of the recorded
+ *   values fall, as the upper bound of its bucket. 0 if nothing was recorded
+ */
+GCD_PUBLIC uint64_t gcdHistogramPercentile(const gcd_histogram_t *h,
+                                           double pct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
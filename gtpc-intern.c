@@ -0,0 +1,197 @@
+#include "gtpc-intern.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#define DEFAULT_MAX_APNS  4096
+#define DEFAULT_MAX_PLMNS 1024
+#define MAX_INTERN_IDS    65535
+#define PLMN_LEN          3
+
+/*
+ * one dictionary: an open addressing hash of ids over an arena of keys.
+ * everything an id refers to is written before the id is published in its
+ * slot, so readers need no lock
+ */
+typedef struct pool_s {
+    uint32_t *slots; // id, 0 empty
+    uint32_t mask;
+    uint32_t max;
+    uint32_t count;
+    uint32_t *hashes;  // by id
+    uint32_t *offsets; // by id, the key of id ends where the next starts
+    uint8_t *keys;
+} pool_t;
+
+struct gcd_intern_s {
+    pthread_mutex_t lock; // serializes learning
+    pool_t apns;
+    pool_t plmns;
+    uint64_t full;
+};
+
+/* word at a time multiply and mix over the raw bytes */
+static inline uint32_t hashBytes(const uint8_t *p, uint32_t len)
+{
+    uint64_t h = (len + 1) * 0x9E3779B97F4A7C15ULL;
+    uint64_t w;
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    w = 0;
+    memcpy(&w, p, len);
+    h = (h ^ w) * 0x94D049BB133111EBULL;
+    h ^= h >> 29;
+    return (uint32_t)(h >> 32) ^ (uint32_t)h;
+}
+
+static int poolInit(pool_t *p, uint32_t max, uint32_t keyLen)
+{
+    uint32_t nslots = 1;
+    while (nslots < max * 2) { // load factor at most 1/2
+        nslots <<= 1;
+    }
+    p->mask = nslots - 1;
+    p->max = max;
+    p->slots = calloc(nslots, sizeof(*p->slots));
+    p->hashes = calloc(max + 1, sizeof(*p->hashes));
+    p->offsets = calloc(max + 2, sizeof(*p->offsets));
+    p->keys = malloc((size_t)max * keyLen);
+    return p->slots && p->hashes && p->offsets && p->keys;
+}
+
+static void poolFree(pool_t *p)
+{
+    free(p->slots);
+    free(p->hashes);
+    free(p->offsets);
+    free(p->keys);
+}
+
+/*
+ * @return
+ *   0 not found, *slot is where it goes
+ *   id
+ */
+static inline uint32_t poolFind(const pool_t *p, const uint8_t *key,
+                                uint32_t len, uint32_t hash, uint32_t *slot)
+{
+    for (uint32_t i = hash & p->mask;; i = (i + 1) & p->mask) {
+        uint32_t id = __atomic_load_n(&p->slots[i], __ATOMIC_ACQUIRE);
+        if (!id) {
+            *slot = i;
+            return 0;
+        }
+        if (p->hashes[id] == hash && p->offsets[id + 1] - p->offsets[id] == len
+            && !memcmp(p->keys + p->offsets[id], key, len)) {
+            return id;
+        }
+    }
+}
+
+static uint32_t internKey(gcd_intern_t *t, pool_t *p, const uint8_t *key,
+                          uint32_t len)
+{
+    uint32_t hash = hashBytes(key, len);
+    uint32_t slot;
+    uint32_t id = poolFind(p, key, len, hash, &slot);
+    if (id) {
+        return id;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    id = poolFind(p, key, len, hash, &slot); // may have been learned since
+    if (!id) {
+        if (p->count == p->max) {
+            t->full++;
+        } else {
+            id = p->count + 1;
+            memcpy(p->keys + p->offsets[id], key, len);
+            p->offsets[id + 1] = p->offsets[id] + len;
+            p->hashes[id] = hash;
+            __atomic_store_n(&p->count, id, __ATOMIC_RELEASE);
+            __atomic_store_n(&p->slots[slot], id, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+    return id;
+}
+
+gcd_intern_t *gcdInternCreate(const gcd_intern_conf_t *conf)
+{
+    uint32_t maxApns = conf->maxApns ? conf->maxApns : DEFAULT_MAX_APNS;
+    uint32_t maxPlmns = conf->maxPlmns ? conf->maxPlmns : DEFAULT_MAX_PLMNS;
+    if (maxApns > MAX_INTERN_IDS || maxPlmns > MAX_INTERN_IDS) {
+        return NULL;
+    }
+    gcd_intern_t *t = calloc(1, sizeof(*t));
+    if (!t) {
+        return NULL;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    if (!poolInit(&t->apns, maxApns, MAX_APN_LEN)
+        || !poolInit(&t->plmns, maxPlmns, PLMN_LEN)) {
+        gcdInternDestroy(t);
+        return NULL;
+    }
+    return t;
+}
+
+void gcdInternDestroy(gcd_intern_t *intern)
+{
+    if (!intern) {
+        return;
+    }
+    poolFree(&intern->apns);
+    poolFree(&intern->plmns);
+    pthread_mutex_destroy(&intern->lock);
+    free(intern);
+}
+
+uint32_t gcdInternApn(gcd_intern_t *intern, const uint8_t *apn, uint32_t len)
+{
+    if (len > MAX_APN_LEN) {
+        return 0;
+    }
+    return internKey(intern, &intern->apns, apn, len);
+}
+
+uint32_t gcdInternPlmn(gcd_intern_t *intern, const uint8_t plmn[3])
+{
+    return internKey(intern, &intern->plmns, plmn, PLMN_LEN);
+}
+
+int gcdInternApnName(gcd_intern_t *intern, uint32_t id,
+                     char apn[MAX_APN_LEN + 1])
+{
+    pool_t *p = &intern->apns;
+    if (id == 0 || id > __atomic_load_n(&p->count, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    uint32_t len = p->offsets[id + 1] - p->offsets[id];
+    return APN2ASCII(p->keys + p->offsets[id], len, apn, MAX_APN_LEN + 1);
+}
+
+uint32_t gcdInternPlmnValue(gcd_intern_t *intern, uint32_t id)
+{
+    pool_t *p = &intern->plmns;
+    if (id == 0 || id > __atomic_load_n(&p->count, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    const uint8_t *v = p->keys + p->offsets[id];
+    return ((uint32_t)v[0] << 16) | ((uint32_t)v[1] << 8) | v[2];
+}
+
+void gcdInternStats(gcd_intern_t *intern, gcd_intern_stats_t *stats)
+{
+    pthread_mutex_lock(&intern->lock);
+    stats->apns = intern->apns.count;
+    stats->plmns = intern->plmns.count;
+    stats->full = intern->full;
+    pthread_mutex_unlock(&intern->lock);
+}
@@ -0,0 +1,72 @@
+#ifndef GTPC_INTERN_H_
+#define GTPC_INTERN_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gcd_intern_conf_s {
+    uint32_t maxApns;  // 0 for 4096, at most 65535
+    uint32_t maxPlmns; // 0 for 1024, at most 65535
+} gcd_intern_conf_t;
+
+typedef struct gcd_intern_stats_s {
+    uint32_t apns;
+    uint32_t plmns;
+    uint64_t full; // values left without an id, the table was full
+} gcd_intern_stats_t;
+
+/*
+ * insert only dictionary of the APNs and PLMNs seen on the wire, shared by
+ * any number of threads. known values are looked up without a lock, only
+ * learning a new value takes one
+ */
+typedef struct gcd_intern_s gcd_intern_t;
+
+/**
+ * @return
+ *   NULL on allocation failure or a limit over 65535
+ */
+GCD_PUBLIC gcd_intern_t *gcdInternCreate(const gcd_intern_conf_t *conf);
+GCD_PUBLIC void gcdInternDestroy(gcd_intern_t *intern);
+/**
+ * id of an APN in wire form, ie. length prefixed labels, learned on first
+ * sight
+ * @return
+ *   0  table full or apn longer than MAX_APN_LEN
+ *   id, numbered from 1 and stable for the life of the table
+ */
+GCD_PUBLIC uint32_t gcdInternApn(gcd_intern_t *intern, const uint8_t *apn,
+                                 uint32_t len);
+/**
+ * id of the 3 byte MCC/MNC of TS 24.008
+ * @return
+ *   same as gcdInternApn
+ */
+GCD_PUBLIC uint32_t gcdInternPlmn(gcd_intern_t *intern,
+                                  const uint8_t plmn[3]);
+/**
+ * dotted name of an APN id
+ * @return
+ *   length of the name, 0 for an unknown id
+ */
+GCD_PUBLIC int gcdInternApnName(gcd_intern_t *intern, uint32_t id,
+                                char apn[MAX_APN_LEN + 1]);
+/**
+ * 24-bit wire form of a PLMN id, see gtpcFormatPlmn()
+ * @return
+ *   0 for an unknown id
+ */
+GCD_PUBLIC uint32_t gcdInternPlmnValue(gcd_intern_t *intern, uint32_t id);
+GCD_PUBLIC void gcdInternStats(gcd_intern_t *intern,
+                               gcd_intern_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
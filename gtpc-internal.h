@@ -0,0 +1,123 @@
+#ifndef GTPC_INTERNAL_H_
+#define GTPC_INTERNAL_H_
+
+#include <stddef.h>
+
+#include "gtpc-context.h"
+#include "gtpc-decoder.h"
+#include "gtpc-stats.h"
+#include "gtpu-decoder.h"
+
+/* returned by the switch dispatchers for IEs without a built-in parser */
+#define GTPC_IE_NOT_BUILTIN (-2)
+
+struct gcd_parsers_s {
+    onIEParse table[MAX_GTPC_VERSION + 1][MAX_IE + 1];
+    /* IEs replaced through register, they skip the built-in switch */
+    gtp_ie_mask_t custom;
+    /* interest mask applied by decoders using this set */
+    gtp_ie_mask_t mask;
+    uint8_t masked;
+};
+
+/*
+ * reset a parser set to the built-in parsers
+ * @return
+ *   1  success
+ *   0  error
+ */
+GCD_LOCAL int initParserSet(gcd_parsers_t *parsers);
+/*
+ * @return
+ *   same as registerIEParser
+ */
+GCD_LOCAL int registerParserSet(gcd_parsers_t *parsers, uint8_t version,
+                                uint8_t ie, onIEParse parser);
+/*
+ * decode the IEs from offset to len, mask may be NULL. the IE chain is
+ * checked to fit in len once up front, parsers registered by the user still
+ * get the remaining length and check it themselves
+ * @return
+ *   0  error, gtp->err is set
+ *   1  success
+ */
+GCD_LOCAL int decodeGtpcBody(uint8_t *data, uint32_t len, uint32_t offset,
+                             gtp_t *gtp, const gcd_parsers_t *parsers,
+                             const gtp_ie_mask_t *mask);
+
+/*
+ * decode gtpc header, err may be NULL
+ * @return
+ *   -1 error, err is set
+ *   header length
+ */
+GCD_LOCAL int decodeGtpcHeader(uint8_t *data, uint32_t len, gtp_header_t *hdr,
+                               gtp_error_t *err);
+/*
+ * total length of the IE at data, TV from the length table and TLV from its
+ * length field
+ * @return
+ *   -1 on truncated IE
+ *   0  on unknown TV
+ *   IE length
+ */
+GCD_LOCAL int gtpcIELength(uint8_t version, uint8_t *data, uint32_t len);
+
+/*
+ * follow the gtpv1 extension header chain starting with type next at offset,
+ * gtpu may be NULL to only skip it
+ * @return
+ *   -1 chain runs past end
+ *   offset of the first byte after the chain
+ */
+GCD_LOCAL int gtpv1ExtensionChain(const uint8_t *data, uint32_t end,
+                                  uint32_t offset, uint8_t next,
+                                  gtpu_t *gtpu);
+
+/*
+ * length of the message starting at data as given by its header, a gtpv2
+ * message may be followed by a piggybacked one. decodeGtpcHeader() has
+ * checked it fits in the buffer
+ */
+static inline uint32_t gtpcMessageLen(const gtp_header_t *hdr)
+{
+    static const uint8_t fixed[MAX_GTPC_VERSION + 1] = {20, 8, 4};
+    return fixed[hdr->version] + (uint32_t)hdr->msgLen;
+}
+
+static inline void setGtpError(gtp_error_t *err, uint8_t code, uint8_t ie,
+                               uint32_t offset)
+{
+    if (err) {
+        err->code = code;
+        err->ie = ie;
+        err->offset = offset;
+    }
+}
+
+GCD_LOCAL extern int gcd_stats_enabled;
+/* counter block of the calling thread, allocated on first use */
+GCD_LOCAL gcd_stats_t *gcdStatsThread();
+
+/* counter block to update, NULL when statistics are off */
+static inline gcd_stats_t *statsLocal()
+{
+    if (!__atomic_load_n(&gcd_stats_enabled, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return gcdStatsThread();
+}
+
+/* single writer increment, readers may load the counter concurrently */
+#define GCD_STAT_INC(c) \
+    __atomic_store_n(&(c), __atomic_load_n(&(c), __ATOMIC_RELAXED) + 1, \
+                     __ATOMIC_RELAXED)
+
+/*
+ * hand a diagnostic to the logger registered with gcdSetLogger(), does
+ * nothing (and no I/O) when there is none
+ */
+GCD_LOCAL void gcdLog(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif
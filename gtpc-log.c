@@ -0,0 +1,79 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "gtpc-internal.h"
+
+static onGcdLog log_cb;
+static void *log_arg;
+static uint32_t log_rate;
+
+/* one second token window shared by every thread */
+static uint64_t log_window;
+static uint32_t log_count;
+static uint32_t log_suppressed;
+
+void gcdSetLogger(onGcdLog logger, void *arg, uint32_t maxPerSecond)
+{
+    __atomic_store_n(&log_cb, NULL, __ATOMIC_SEQ_CST);
+    log_arg = arg;
+    log_rate = maxPerSecond;
+    __atomic_store_n(&log_cb, logger, __ATOMIC_SEQ_CST);
+}
+
+static uint64_t nowSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+/*
+ * @return
+ *   number of messages suppressed in the previous window when a new window
+ *   starts, -1 if this message is over the limit
+ */
+static int64_t logAdmit()
+{
+    int64_t suppressed = 0;
+    if (log_rate == 0) {
+        return 0;
+    }
+    uint64_t now = nowSeconds();
+    uint64_t window = __atomic_load_n(&log_window, __ATOMIC_RELAXED);
+    if (now != window &&
+        __atomic_compare_exchange_n(&log_window, &window, now, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&log_count, 0, __ATOMIC_RELAXED);
+        suppressed = __atomic_exchange_n(&log_suppressed, 0, __ATOMIC_RELAXED);
+    }
+    if (__atomic_fetch_add(&log_count, 1, __ATOMIC_RELAXED) >= log_rate) {
+        __atomic_fetch_add(&log_suppressed, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return suppressed;
+}
+
+void gcdLog(int level, const char *fmt, ...)
+{
+    onGcdLog cb = __atomic_load_n(&log_cb, __ATOMIC_ACQUIRE);
+    if (!cb) {
+        return;
+    }
+    int64_t suppressed = logAdmit();
+    if (suppressed < 0) {
+        return;
+    }
+
+    char msg[256];
+    if (suppressed > 0) {
+        snprintf(msg, sizeof(msg), "%ld log messages suppressed",
+                 (long)suppressed);
+        cb(GCD_LOG_WARN, msg, log_arg);
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    cb(level, msg, log_arg);
+}
@@ -0,0 +1,670 @@
+#include "gtpc-packet.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ETH_P_IPV4    0x0800
+#define ETH_P_IPV6    0x86DD
+#define ETH_P_VLAN    0x8100
+#define ETH_P_QINQ    0x88A8
+#define ETH_P_QINQ1   0x9100 // pre-standard QinQ
+#define ETH_P_MPLS_UC 0x8847
+#define ETH_P_MPLS_MC 0x8848
+#define IPPROTO_UDP_  17
+
+/* IPv6 extension headers */
+#define IP6_EXT_HOPOPTS  0
+#define IP6_EXT_ROUTING  43
+#define IP6_EXT_FRAGMENT 44
+#define IP6_EXT_AH       51
+#define IP6_EXT_DSTOPTS  60
+
+#define LOCATE_FRAGMENT 2 // only returned when the caller takes fragments
+
+#define DEFAULT_REASM_DATAGRAMS  1024
+#define DEFAULT_REASM_BYTES      (4 << 20)
+#define DEFAULT_REASM_TIMEOUT_MS 2000
+#define REASM_MAX_FRAGS          16
+#define REASM_MAX_LEN            65535
+#define REASM_ADDRS              32 // src and dst ahead of the data
+#define REASM_NONE               UINT32_MAX
+
+/* an ip fragment of a udp datagram inside a frame */
+typedef struct frag_s {
+    uint8_t version;
+    uint8_t *src;
+    uint8_t *dst;
+    uint32_t id;
+    uint32_t offset; // of data in the reassembled ip payload
+    int more;
+    uint8_t *data;
+    uint32_t len;
+} frag_t;
+
+static inline uint16_t load16(uint8_t *p)
+{
+    return ntohs(*(uint16_t *)p);
+}
+
+static inline uint32_t load32(uint8_t *p)
+{
+    return ntohl(*(uint32_t *)p);
+}
+
+static inline int isGtpcPort(uint16_t port)
+{
+    return port == GTPC_PORT || port == GTP_PRIME_PORT;
+}
+
+static int locateUdp(uint8_t *udp, uint32_t len, gcd_payload_t *out)
+{
+    if (len < 8) {
+        return -1;
+    }
+    uint16_t sport = load16(udp);
+    uint16_t dport = load16(udp + 2);
+    uint16_t ulen = load16(udp + 4);
+    if (!isGtpcPort(sport) && !isGtpcPort(dport)) {
+        return 0;
+    }
+    if (ulen < 8 || ulen > len) {
+        return -1;
+    }
+    out->srcPort = sport;
+    out->dstPort = dport;
+    out->data = udp + 8;
+    out->len = ulen - 8;
+    return 1;
+}
+
+static int locateIpv4(uint8_t *ip, uint32_t len, gcd_payload_t *out,
+                      frag_t *frag)
+{
+    if (len < 20 || (ip[0] >> 4) != 4) {
+        return -1;
+    }
+    uint32_t ihl = (ip[0] & 0x0F) * 4;
+    uint32_t total = load16(ip + 2);
+    if (ihl < 20 || total < ihl || total > len) {
+        return -1;
+    }
+    if (ip[9] != IPPROTO_UDP_) {
+        return 0;
+    }
+    out->ipVersion = 4;
+    out->src = ip + 12;
+    out->dst = ip + 16;
+    uint16_t fo = load16(ip + 6);
+    if (fo & 0x3FFF) { // more fragments or an offset
+        if (!frag) {
+            return 0;
+        }
+        frag->version = 4;
+        frag->src = ip + 12;
+        frag->dst = ip + 16;
+        frag->id = load16(ip + 4);
+        frag->offset = (fo & 0x1FFF) * 8;
+        frag->more = !!(fo & 0x2000);
+        frag->data = ip + ihl;
+        frag->len = total - ihl;
+        return LOCATE_FRAGMENT;
+    }
+    return locateUdp(ip + ihl, total - ihl, out);
+}
+
+static int locateIpv6(uint8_t *ip, uint32_t len, gcd_payload_t *out,
+                      frag_t *frag)
+{
+    if (len < 40 || (ip[0] >> 4) != 6) {
+        return -1;
+    }
+    uint32_t left = load16(ip + 4);
+    if (40 + left > len) {
+        return -1;
+    }
+    out->ipVersion = 6;
+    out->src = ip + 8;
+    out->dst = ip + 24;
+    uint8_t next = ip[6];
+    uint8_t *p = ip + 40;
+    // every extension header is at least 8 bytes, so this ends
+    for (;;) {
+        uint32_t hlen;
+        switch (next) {
+        case IPPROTO_UDP_:
+            return locateUdp(p, left, out);
+        case IP6_EXT_HOPOPTS:
+        case IP6_EXT_ROUTING:
+        case IP6_EXT_DSTOPTS:
+            if (left < 8) {
+                return -1;
+            }
+            hlen = (p[1] + 1) * 8;
+            break;
+        case IP6_EXT_AH:
+            if (left < 8) {
+                return -1;
+            }
+            hlen = (p[1] + 2) * 4;
+            break;
+        case IP6_EXT_FRAGMENT: {
+            if (left < 8) {
+                return -1;
+            }
+            uint16_t fo = load16(p + 2);
+            if ((fo & 0xFFF9) == 0) { // atomic fragment, RFC 6946
+                hlen = 8;
+                break;
+            }
+            if (p[0] != IPPROTO_UDP_ || !frag) {
+                return 0;
+            }
+            frag->version = 6;
+            frag->src = ip + 8;
+            frag->dst = ip + 24;
+            frag->id = load32(p + 4);
+            frag->offset = fo & 0xFFF8;
+            frag->more = fo & 1;
+            frag->data = p + 8;
+            frag->len = left - 8;
+            return LOCATE_FRAGMENT;
+        }
+        default:
+            return 0; // ESP, no next header or not udp
+        }
+        if (hlen > left) {
+            return -1;
+        }
+        next = p[0];
+        p += hlen;
+        left -= hlen;
+    }
+}
+
+static int locateIp(uint8_t *ip, uint32_t len, gcd_payload_t *out,
+                    frag_t *frag)
+{
+    if (len < 1) {
+        return -1;
+    }
+    switch (ip[0] >> 4) {
+    case 4:
+        return locateIpv4(ip, len, out, frag);
+    case 6:
+        return locateIpv6(ip, len, out, frag);
+    default:
+        return 0;
+    }
+}
+
+static int locateEthertype(uint16_t type, uint8_t *p, uint32_t len,
+                           gcd_payload_t *out, frag_t *frag);
+
+/*
+ * pop the label stack, below the bottom label the first nibble tells ip
+ * from the control word of an ethernet pseudowire (RFC 4385)
+ */
+static int locateMpls(uint8_t *p, uint32_t len, gcd_payload_t *out,
+                      frag_t *frag)
+{
+    int bottom = 0;
+    while (!bottom) {
+        if (len < 4) {
+            return -1;
+        }
+        bottom = p[2] & 1;
+        p += 4;
+        len -= 4;
+    }
+    if (len < 1) {
+        return -1;
+    }
+    switch (p[0] >> 4) {
+    case 4:
+        return locateIpv4(p, len, out, frag);
+    case 6:
+        return locateIpv6(p, len, out, frag);
+    case 0:
+        if (len < 4 + 14) {
+            return -1;
+        }
+        return locateEthertype(load16(p + 4 + 12), p + 4 + 14, len - 4 - 14,
+                               out, frag);
+    default:
+        return 0;
+    }
+}
+
+static int locateEthertype(uint16_t type, uint8_t *p, uint32_t len,
+                           gcd_payload_t *out, frag_t *frag)
+{
+    // skip 802.1Q/802.1ad tags
+    while (type == ETH_P_VLAN || type == ETH_P_QINQ || type == ETH_P_QINQ1) {
+        if (len < 4) {
+            return -1;
+        }
+        type = load16(p + 2);
+        p += 4;
+        len -= 4;
+    }
+    switch (type) {
+    case ETH_P_IPV4:
+        return locateIpv4(p, len, out, frag);
+    case ETH_P_IPV6:
+        return locateIpv6(p, len, out, frag);
+    case ETH_P_MPLS_UC:
+    case ETH_P_MPLS_MC:
+        return locateMpls(p, len, out, frag);
+    default:
+        return 0;
+    }
+}
+
+static int locate(uint8_t *frame, uint32_t len, int linktype,
+                  gcd_payload_t *out, frag_t *frag)
+{
+    switch (linktype) {
+    case GCD_LINKTYPE_ETHERNET:
+        if (len < 14) {
+            return -1;
+        }
+        return locateEthertype(load16(frame + 12), frame + 14, len - 14, out,
+                               frag);
+    case GCD_LINKTYPE_LINUX_SLL:
+        if (len < 16) {
+            return -1;
+        }
+        return locateEthertype(load16(frame + 14), frame + 16, len - 16, out,
+                               frag);
+    case GCD_LINKTYPE_LINUX_SLL2:
+        if (len < 20) {
+            return -1;
+        }
+        return locateEthertype(load16(frame), frame + 20, len - 20, out,
+                               frag);
+    case GCD_LINKTYPE_NULL:
+        // host byte order address family, only the ip version matters
+        if (len < 4) {
+            return -1;
+        }
+        return locateIp(frame + 4, len - 4, out, frag);
+    case GCD_LINKTYPE_RAW:
+    case GCD_LINKTYPE_IPV4:
+    case GCD_LINKTYPE_IPV6:
+        return locateIp(frame, len, out, frag);
+    default:
+        return 0;
+    }
+}
+
+int gcdLocateGtpc(uint8_t *frame, uint32_t len, int linktype,
+                  gcd_payload_t *out)
+{
+    return locate(frame, len, linktype, out, NULL);
+}
+
+/*
+ * a datagram in reassembly. the data buffer starts with the addresses, so
+ * a completed datagram is self contained until it is released
+ */
+typedef struct reasm_entry_s {
+    uint8_t version;
+    uint8_t ignore; // the first fragment showed no gtpc port
+    uint8_t nfrags;
+    uint32_t id;
+    uint8_t src[16];
+    uint8_t dst[16];
+    uint64_t firstNs;
+    uint32_t total; // ip payload length, 0 until the last fragment came
+    uint32_t received;
+    struct {
+        uint16_t offset;
+        uint16_t len;
+    } frags[REASM_MAX_FRAGS];
+    uint8_t *buf;
+    uint32_t cap; // data bytes buf holds after the addresses
+    uint32_t next;  // hash chain or free list
+    uint32_t older; // age list
+    uint32_t newer;
+} reasm_entry_t;
+
+struct gcd_reasm_s {
+    reasm_entry_t *entries;
+    uint32_t max;
+    uint32_t *buckets;
+    uint32_t mask;
+    uint32_t free;
+    uint32_t oldest;
+    uint32_t newest;
+    uint64_t bytes;
+    uint64_t maxBytes;
+    uint64_t timeoutNs;
+    uint8_t **done; // completed, waiting for gcdReasmRelease()
+    uint32_t ndone;
+    uint32_t doneCap;
+    uint64_t doneBytes;
+    gcd_reasm_stats_t stats;
+};
+
+gcd_reasm_t *gcdReasmCreate(const gcd_reasm_conf_t *conf)
+{
+    gcd_reasm_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    r->max = conf->maxDatagrams ? conf->maxDatagrams : DEFAULT_REASM_DATAGRAMS;
+    r->maxBytes = conf->maxBytes ? conf->maxBytes : DEFAULT_REASM_BYTES;
+    r->timeoutNs = (uint64_t)(conf->timeoutMs ? conf->timeoutMs
+                                              : DEFAULT_REASM_TIMEOUT_MS)
+                   * 1000000ULL;
+    uint32_t nbuckets = 1;
+    while (nbuckets < r->max) {
+        nbuckets <<= 1;
+    }
+    r->mask = nbuckets - 1;
+    r->entries = calloc(r->max, sizeof(*r->entries));
+    r->buckets = malloc(sizeof(*r->buckets) * nbuckets);
+    if (!r->entries || !r->buckets) {
+        gcdReasmDestroy(r);
+        return NULL;
+    }
+    memset(r->buckets, 0xFF, sizeof(*r->buckets) * nbuckets);
+    for (uint32_t i = 0; i < r->max; i++) {
+        r->entries[i].next = i + 1 < r->max ? i + 1 : REASM_NONE;
+    }
+    r->free = 0;
+    r->oldest = r->newest = REASM_NONE;
+    return r;
+}
+
+void gcdReasmDestroy(gcd_reasm_t *reasm)
+{
+    if (!reasm) {
+        return;
+    }
+    gcdReasmRelease(reasm);
+    if (reasm->entries) {
+        for (uint32_t i = 0; i < reasm->max; i++) {
+            free(reasm->entries[i].buf);
+        }
+    }
+    free(reasm->entries);
+    free(reasm->buckets);
+    free(reasm->done);
+    free(reasm);
+}
+
+void gcdReasmRelease(gcd_reasm_t *reasm)
+{
+    for (uint32_t i = 0; i < reasm->ndone; i++) {
+        free(reasm->done[i]);
+    }
+    reasm->ndone = 0;
+    reasm->bytes -= reasm->doneBytes;
+    reasm->doneBytes = 0;
+}
+
+void gcdReasmStats(const gcd_reasm_t *reasm, gcd_reasm_stats_t *stats)
+{
+    *stats = reasm->stats;
+}
+
+static inline uint32_t addrLen(uint8_t version)
+{
+    return version == 6 ? 16 : 4;
+}
+
+static inline uint32_t hashKey(const frag_t *f)
+{
+    uint32_t n = addrLen(f->version);
+    uint32_t h = f->id * 0x9E3779B1U ^ f->version;
+    for (uint32_t i = 0; i < n; i += 4) {
+        uint32_t s, d;
+        memcpy(&s, f->src + i, 4);
+        memcpy(&d, f->dst + i, 4);
+        h = (h ^ s) * 0x85EBCA6BU;
+        h = (h ^ d) * 0xC2B2AE35U;
+    }
+    return h ^ (h >> 16);
+}
+
+static void unlinkEntry(gcd_reasm_t *r, uint32_t idx)
+{
+    reasm_entry_t *e = &r->entries[idx];
+    frag_t key = {.version = e->version, .src = e->src, .dst = e->dst,
+                  .id = e->id};
+    uint32_t *link = &r->buckets[hashKey(&key) & r->mask];
+    while (*link != idx) {
+        link = &r->entries[*link].next;
+    }
+    *link = e->next;
+    if (e->older != REASM_NONE) {
+        r->entries[e->older].newer = e->newer;
+    } else {
+        r->oldest = e->newer;
+    }
+    if (e->newer != REASM_NONE) {
+        r->entries[e->newer].older = e->older;
+    } else {
+        r->newest = e->older;
+    }
+}
+
+static void dropEntry(gcd_reasm_t *r, uint32_t idx)
+{
+    reasm_entry_t *e = &r->entries[idx];
+    unlinkEntry(r, idx);
+    free(e->buf);
+    r->bytes -= e->cap;
+    e->buf = NULL;
+    e->cap = 0;
+    e->next = r->free;
+    r->free = idx;
+}
+
+static uint32_t findEntry(gcd_reasm_t *r, const frag_t *f, uint32_t hash)
+{
+    uint32_t n = addrLen(f->version);
+    for (uint32_t i = r->buckets[hash & r->mask]; i != REASM_NONE;
+         i = r->entries[i].next) {
+        reasm_entry_t *e = &r->entries[i];
+        if (e->id == f->id && e->version == f->version
+            && !memcmp(e->src, f->src, n) && !memcmp(e->dst, f->dst, n)) {
+            return i;
+        }
+    }
+    return REASM_NONE;
+}
+
+static uint32_t newEntry(gcd_reasm_t *r, const frag_t *f, uint32_t hash,
+                         uint64_t tsNs)
+{
+    if (r->free == REASM_NONE) {
+        dropEntry(r, r->oldest);
+        r->stats.evicted++;
+    }
+    uint32_t idx = r->free;
+    reasm_entry_t *e = &r->entries[idx];
+    r->free = e->next;
+    uint32_t n = addrLen(f->version);
+    e->version = f->version;
+    e->id = f->id;
+    memcpy(e->src, f->src, n);
+    memcpy(e->dst, f->dst, n);
+    e->ignore = 0;
+    e->nfrags = 0;
+    e->total = 0;
+    e->received = 0;
+    e->firstNs = tsNs;
+    e->next = r->buckets[hash & r->mask];
+    r->buckets[hash & r->mask] = idx;
+    e->newer = REASM_NONE;
+    e->older = r->newest;
+    if (r->newest != REASM_NONE) {
+        r->entries[r->newest].newer = idx;
+    } else {
+        r->oldest = idx;
+    }
+    r->newest = idx;
+    return idx;
+}
+
+/* make room for the data up to end, within the memory limit */
+static int reserve(gcd_reasm_t *r, uint32_t idx, uint32_t end)
+{
+    reasm_entry_t *e = &r->entries[idx];
+    if (end <= e->cap) {
+        return 1;
+    }
+    uint32_t cap = e->cap ? e->cap * 2 : 2048;
+    if (cap < end) {
+        cap = end;
+    }
+    if (cap > REASM_MAX_LEN) {
+        cap = REASM_MAX_LEN;
+    }
+    while (r->bytes + cap - e->cap > r->maxBytes && r->oldest != idx) {
+        dropEntry(r, r->oldest);
+        r->stats.evicted++;
+    }
+    if (r->bytes + cap - e->cap > r->maxBytes) {
+        return 0;
+    }
+    uint8_t *buf = realloc(e->buf, REASM_ADDRS + cap);
+    if (!buf) {
+        return 0;
+    }
+    r->bytes += cap - e->cap;
+    e->buf = buf;
+    e->cap = cap;
+    return 1;
+}
+
+/*
+ * @return
+ *   -1 inconsistent with the fragments before
+ *   0  kept, or a duplicate
+ *   1  new and consistent
+ */
+static int checkFragment(reasm_entry_t *e, const frag_t *f, uint32_t end)
+{
+    if ((f->more && (f->len & 7)) || (f->more && !f->len)
+        || end > REASM_MAX_LEN) {
+        return -1;
+    }
+    if (e->total && (f->more ? end > e->total : end != e->total)) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < e->nfrags; i++) {
+        uint32_t o = e->frags[i].offset, l = e->frags[i].len;
+        if (f->offset < o + l && o < end) {
+            return o == f->offset && l == f->len ? 0 : -1; // RFC 5722
+        }
+        if (!f->more && o + l > end) {
+            return -1;
+        }
+    }
+    return e->nfrags < REASM_MAX_FRAGS ? 1 : -1;
+}
+
+static void expire(gcd_reasm_t *r, uint64_t tsNs)
+{
+    while (r->oldest != REASM_NONE
+           && r->entries[r->oldest].firstNs + r->timeoutNs < tsNs) {
+        dropEntry(r, r->oldest);
+        r->stats.timeouts++;
+    }
+}
+
+static int addFragment(gcd_reasm_t *r, const frag_t *f, uint64_t tsNs,
+                       gcd_payload_t *out)
+{
+    r->stats.fragments++;
+    expire(r, tsNs);
+    uint32_t hash = hashKey(f);
+    uint32_t idx = findEntry(r, f, hash);
+    if (idx == REASM_NONE) {
+        idx = newEntry(r, f, hash, tsNs);
+    }
+    reasm_entry_t *e = &r->entries[idx];
+    uint32_t end = f->offset + f->len;
+    int rc = checkFragment(e, f, end);
+    if (rc <= 0) {
+        if (rc < 0) {
+            dropEntry(r, idx);
+            r->stats.invalid++;
+        }
+        return rc;
+    }
+    e->frags[e->nfrags].offset = f->offset;
+    e->frags[e->nfrags].len = f->len;
+    e->nfrags++;
+    e->received += f->len;
+    if (!f->more) {
+        e->total = end;
+    }
+    if (f->offset == 0 && f->len >= 8 && !isGtpcPort(load16(f->data))
+        && !isGtpcPort(load16(f->data + 2))) {
+        e->ignore = 1; // only the offsets are tracked from here on
+        free(e->buf);
+        r->bytes -= e->cap;
+        e->buf = NULL;
+        e->cap = 0;
+    }
+    if (!e->ignore) {
+        if (!reserve(r, idx, end)) {
+            dropEntry(r, idx);
+            r->stats.evicted++;
+            return 0;
+        }
+        memcpy(e->buf + REASM_ADDRS + f->offset, f->data, f->len);
+    }
+    if (!e->total || e->received != e->total) {
+        return 0;
+    }
+
+    if (e->ignore) {
+        dropEntry(r, idx);
+        return 0;
+    }
+    if (r->ndone == r->doneCap) {
+        uint32_t cap = r->doneCap ? r->doneCap * 2 : 16;
+        uint8_t **done = realloc(r->done, sizeof(*done) * cap);
+        if (!done) {
+            dropEntry(r, idx);
+            r->stats.evicted++;
+            return 0;
+        }
+        r->done = done;
+        r->doneCap = cap;
+    }
+    /* the buffer moves to the done list and stays accounted until released */
+    uint8_t *buf = e->buf;
+    uint32_t total = e->total;
+    uint32_t n = addrLen(e->version);
+    memcpy(buf, e->src, n);
+    memcpy(buf + 16, e->dst, n);
+    r->done[r->ndone++] = buf;
+    r->doneBytes += e->cap;
+    e->buf = NULL;
+    e->cap = 0;
+    dropEntry(r, idx);
+    r->stats.reassembled++;
+
+    out->ipVersion = f->version;
+    out->src = buf;
+    out->dst = buf + 16;
+    return locateUdp(buf + REASM_ADDRS, total, out);
+}
+
+int gcdReasmLocate(gcd_reasm_t *reasm, uint8_t *frame, uint32_t len,
+                   int linktype, uint64_t tsNs, gcd_payload_t *out)
+{
+    frag_t frag;
+    int rc = locate(frame, len, linktype, out, &frag);
+    if (rc != LOCATE_FRAGMENT) {
+        return rc;
+    }
+    return addFragment(reasm, &frag, tsNs, out);
+}
@@ -0,0 +1,101 @@
+#ifndef GTPC_PACKET_H_
+#define GTPC_PACKET_H_
+
+#include <stdint.h>
+
+#include "macros.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* link types of pcap/pcapng captures */
+#define GCD_LINKTYPE_NULL       0
+#define GCD_LINKTYPE_ETHERNET   1
+#define GCD_LINKTYPE_RAW        101
+#define GCD_LINKTYPE_LINUX_SLL  113
+#define GCD_LINKTYPE_IPV4       228
+#define GCD_LINKTYPE_IPV6       229
+#define GCD_LINKTYPE_LINUX_SLL2 276
+
+#define GTPC_PORT       2123
+#define GTP_PRIME_PORT  3386
+
+/* a gtp payload located inside a captured frame, nothing is copied */
+typedef struct gcd_payload_s {
+    uint8_t *data;
+    uint32_t len;
+    uint8_t ipVersion; // 4 or 6
+    uint8_t *src;      // ip source address inside the frame
+    uint8_t *dst;      // ip destination address inside the frame
+    uint16_t srcPort;
+    uint16_t dstPort;
+    uint64_t tsNs; // capture time in nanoseconds, 0 if unknown
+} gcd_payload_t;
+
+/**
+ * walk the link, ip and udp headers of frame and locate a gtpc payload
+ * (udp port 2123 or 3386 on either side). VLAN/QinQ tags, MPLS labels
+ * (ip or ethernet pseudowire with a control word below them) and IPv6
+ * extension headers are skipped, ip fragments are left to gcdReasmLocate()
+ * @return
+ *   -1 malformed or truncated frame
+ *   0  not a gtpc packet, a fragment or unsupported encapsulation
+ *   1  found, out points into frame
+ */
+GCD_PUBLIC int gcdLocateGtpc(uint8_t *frame, uint32_t len, int linktype,
+                             gcd_payload_t *out);
+
+typedef struct gcd_reasm_conf_s {
+    uint32_t maxDatagrams; // datagrams in reassembly, 0 for 1024
+    uint32_t maxBytes;     // memory for their data, 0 for 4MB
+    uint32_t timeoutMs;    // of capture time since the first fragment, 0 for 2s
+} gcd_reasm_conf_t;
+
+typedef struct gcd_reasm_stats_s {
+    uint64_t fragments;
+    uint64_t reassembled; // gtpc datagrams completed
+    uint64_t timeouts;    // datagrams still incomplete after the timeout
+    uint64_t evicted;     // datagrams dropped to stay within the limits
+    uint64_t invalid;     // datagrams dropped for overlapping or bad fragments
+} gcd_reasm_stats_t;
+
+/*
+ * ip fragment reassembly in front of gcdLocateGtpc(): unfragmented frames
+ * cost nothing more, only fragments of udp datagrams are copied, and
+ * those of a first fragment without a gtpc port are counted but dropped.
+ * one reassembler is used by one thread at a time
+ */
+typedef struct gcd_reasm_s gcd_reasm_t;
+
+/**
+ * @return
+ *   NULL on allocation failure
+ */
+GCD_PUBLIC gcd_reasm_t *gcdReasmCreate(const gcd_reasm_conf_t *conf);
+GCD_PUBLIC void gcdReasmDestroy(gcd_reasm_t *reasm);
+/**
+ * gcdLocateGtpc() that keeps fragments until their datagram is complete,
+ * tsNs is the capture time of frame and drives the timeout
+ * @return
+ *   -1 malformed frame or a datagram dropped for bad fragments
+ *   0  not a gtpc packet or a fragment of an incomplete datagram
+ *   1  found, out points into frame, or into the reassembler for a
+ *      completed datagram until the next gcdReasmRelease()
+ */
+GCD_PUBLIC int gcdReasmLocate(gcd_reasm_t *reasm, uint8_t *frame,
+                              uint32_t len, int linktype, uint64_t tsNs,
+                              gcd_payload_t *out);
+/**
+ * free the datagrams completed since the last call, none of their
+ * payloads may be used afterwards
+ */
+GCD_PUBLIC void gcdReasmRelease(gcd_reasm_t *reasm);
+GCD_PUBLIC void gcdReasmStats(const gcd_reasm_t *reasm,
+                              gcd_reasm_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,488 @@
+#include "gtpc-pcap.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PCAP_MAGIC_US   0xA1B2C3D4
+#define PCAP_MAGIC_NS   0xA1B23C4D
+#define PCAPNG_SHB      0x0A0D0D0A
+#define PCAPNG_BOM      0x1A2B3C4D
+#define PCAPNG_IDB      1
+#define PCAPNG_SPB      3
+#define PCAPNG_EPB      6
+#define PCAPNG_MAX_IF   64
+
+#define STREAM_CHUNK    (4 << 20)
+
+struct gcd_pcap_s {
+    /* mapped file, or a window over the stream */
+    uint8_t *buf;
+    size_t len;
+    size_t pos;
+    size_t cap;
+    int mapped;
+    FILE *fp;
+    pid_t child; // gzip child of .gz captures
+    int eof;
+
+    int ng;
+    int swapped;
+    uint32_t snaplen;
+    /* pcap */
+    int linktype;
+    uint64_t tsMul; // units of the record timestamp fraction in ns
+    /* pcapng */
+    uint32_t ifCount;
+    uint16_t ifLinktype[PCAPNG_MAX_IF];
+    uint8_t ifTsResol[PCAPNG_MAX_IF]; // if_tsresol option
+
+    gcd_reasm_t *reasm; // NULL leaves fragments out
+    gcd_pcap_stats_t stats;
+};
+
+static inline uint32_t r32(const gcd_pcap_t *p, const uint8_t *b)
+{
+    uint32_t v;
+    memcpy(&v, b, 4);
+    return p->swapped ? __builtin_bswap32(v) : v;
+}
+
+static inline uint16_t r16(const gcd_pcap_t *p, const uint8_t *b)
+{
+    uint16_t v;
+    memcpy(&v, b, 2);
+    return p->swapped ? __builtin_bswap16(v) : v;
+}
+
+static inline int available(const gcd_pcap_t *p, size_t n)
+{
+    return p->len - p->pos >= n;
+}
+
+/*
+ * make n bytes available at pos, streams are compacted which moves the
+ * window, so no pointer into it survives this call
+ */
+static int refill(gcd_pcap_t *p, size_t n)
+{
+    if (p->mapped) {
+        return available(p, n);
+    }
+    if (p->pos) {
+        memmove(p->buf, p->buf + p->pos, p->len - p->pos);
+        p->len -= p->pos;
+        p->pos = 0;
+    }
+    if (n > p->cap) {
+        uint8_t *buf = realloc(p->buf, n);
+        if (!buf) {
+            return 0;
+        }
+        p->buf = buf;
+        p->cap = n;
+    }
+    while (p->len < n && !p->eof) {
+        size_t got = fread(p->buf + p->len, 1, p->cap - p->len, p->fp);
+        if (got == 0) {
+            p->eof = 1;
+        }
+        p->len += got;
+    }
+    return available(p, n);
+}
+
+static gcd_pcap_t *newPcap()
+{
+    gcd_pcap_t *p = calloc(1, sizeof(*p));
+    if (p) {
+        p->child = -1;
+    }
+    return p;
+}
+
+static int readFileHeader(gcd_pcap_t *p)
+{
+    if (!refill(p, 4)) {
+        return -1;
+    }
+    uint32_t magic;
+    memcpy(&magic, p->buf + p->pos, 4);
+    if (magic == PCAPNG_SHB) {
+        p->ng = 1; // the section header block is read as a regular block
+        return 0;
+    }
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        p->swapped = 0;
+    } else if (__builtin_bswap32(magic) == PCAP_MAGIC_US
+               || __builtin_bswap32(magic) == PCAP_MAGIC_NS) {
+        p->swapped = 1;
+        magic = __builtin_bswap32(magic);
+    } else {
+        return -1;
+    }
+    if (!refill(p, 24)) {
+        return -1;
+    }
+    p->tsMul = magic == PCAP_MAGIC_NS ? 1 : 1000;
+    p->snaplen = r32(p, p->buf + p->pos + 16);
+    p->linktype = r32(p, p->buf + p->pos + 20) & 0xFFFF;
+    p->pos += 24;
+    return 0;
+}
+
+gcd_pcap_t *gcdPcapOpenStream(FILE *fp)
+{
+    gcd_pcap_t *p = newPcap();
+    if (!p) {
+        return NULL;
+    }
+    p->fp = fp;
+    p->cap = STREAM_CHUNK;
+    p->buf = malloc(p->cap);
+    if (!p->buf || readFileHeader(p) < 0) {
+        p->fp = NULL; // owned by the caller
+        gcdPcapClose(p);
+        return NULL;
+    }
+    return p;
+}
+
+static FILE *gunzip(const char *path, pid_t *child)
+{
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return NULL;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execlp("gzip", "gzip", "-dc", "--", path, (char *)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    *child = pid;
+    return fdopen(fds[0], "rb");
+}
+
+gcd_pcap_t *gcdPcapOpen(const char *path)
+{
+    size_t plen = strlen(path);
+    if (strcmp(path, "-") == 0) {
+        return gcdPcapOpenStream(stdin);
+    }
+    if (plen > 3 && strcmp(path + plen - 3, ".gz") == 0) {
+        pid_t child = -1;
+        FILE *fp = gunzip(path, &child);
+        if (!fp) {
+            return NULL;
+        }
+        gcd_pcap_t *p = gcdPcapOpenStream(fp);
+        if (!p) {
+            fclose(fp);
+            waitpid(child, NULL, 0);
+            return NULL;
+        }
+        p->child = child;
+        return p;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    gcd_pcap_t *p = newPcap();
+    if (!p) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    p->mapped = 1;
+    p->buf = map;
+    p->len = st.st_size;
+    p->eof = 1;
+    if (readFileHeader(p) < 0) {
+        gcdPcapClose(p);
+        return NULL;
+    }
+    return p;
+}
+
+void gcdPcapClose(gcd_pcap_t *pcap)
+{
+    if (!pcap) {
+        return;
+    }
+    if (pcap->mapped) {
+        munmap(pcap->buf, pcap->len);
+    } else {
+        free(pcap->buf);
+        if (pcap->child > 0) {
+            fclose(pcap->fp);
+            waitpid(pcap->child, NULL, 0);
+        }
+    }
+    free(pcap);
+}
+
+void gcdPcapSetReassembly(gcd_pcap_t *pcap, gcd_reasm_t *reasm)
+{
+    pcap->reasm = reasm;
+}
+
+const gcd_pcap_stats_t *gcdPcapStats(const gcd_pcap_t *pcap)
+{
+    return &pcap->stats;
+}
+
+/* one captured frame of the current record */
+typedef struct frame_s {
+    uint32_t offset; // from pos
+    uint32_t caplen;
+    int linktype;
+    uint64_t tsNs;
+} frame_t;
+
+/*
+ * length of the record at pos, and its frame if it carries one
+ * @return
+ *   -1 malformed
+ *   0  record without a frame
+ *   1  frame
+ */
+static int parsePcapRecord(gcd_pcap_t *p, uint32_t *reclen, frame_t *frame)
+{
+    uint8_t *h = p->buf + p->pos;
+    uint32_t caplen = r32(p, h + 8);
+    if (caplen > (1 << 26)) {
+        return -1;
+    }
+    *reclen = 16 + caplen;
+    frame->offset = 16;
+    frame->caplen = caplen;
+    frame->linktype = p->linktype;
+    frame->tsNs = (uint64_t)r32(p, h) * 1000000000ULL
+                + (uint64_t)r32(p, h + 4) * p->tsMul;
+    return 1;
+}
+
+static void parseIdb(gcd_pcap_t *p, uint8_t *b, uint32_t blen)
+{
+    if (p->ifCount >= PCAPNG_MAX_IF || blen < 20) {
+        p->ifCount++;
+        return;
+    }
+    uint32_t id = p->ifCount++;
+    p->ifLinktype[id] = r16(p, b + 8);
+    p->ifTsResol[id] = 6; // microseconds unless if_tsresol says otherwise
+    uint32_t off = 16;
+    while (off + 4 <= blen - 4) {
+        uint16_t code = r16(p, b + off);
+        uint16_t olen = r16(p, b + off + 2);
+        if (code == 0 || off + 4 + olen > blen - 4) {
+            break;
+        }
+        if (code == 9 && olen >= 1) { // if_tsresol
+            p->ifTsResol[id] = b[off + 4];
+        }
+        off += 4 + ((olen + 3) & ~3u);
+    }
+}
+
+/* timestamp in units of 10^-res or 2^-res seconds to nanoseconds */
+static uint64_t ngTsToNs(uint64_t ts, uint8_t res)
+{
+    uint8_t exp = res & 0x7F;
+    if (res & 0x80) {
+        if (exp >= 64) {
+            return 0;
+        }
+        uint64_t sec = exp ? ts >> exp : ts;
+        uint64_t frac = exp ? ts & ((1ULL << exp) - 1) : 0;
+        if (exp > 32) { // keep frac * 10^9 within 64 bits
+            frac >>= exp - 32;
+            exp = 32;
+        }
+        return sec * 1000000000ULL + ((frac * 1000000000ULL) >> exp);
+    }
+    uint64_t scale = 1;
+    for (uint8_t i = exp < 9 ? exp : 9; i < (exp < 9 ? 9 : exp); i++) {
+        scale *= 10;
+    }
+    return exp <= 9 ? ts * scale : ts / scale;
+}
+
+static int parseNgBlock(gcd_pcap_t *p, uint32_t *reclen, frame_t *frame)
+{
+    uint8_t *b = p->buf + p->pos;
+    uint32_t type;
+    memcpy(&type, b, 4);
+    if (type == PCAPNG_SHB) {
+        uint32_t bom;
+        memcpy(&bom, b + 8, 4);
+        if (bom == PCAPNG_BOM) {
+            p->swapped = 0;
+        } else if (__builtin_bswap32(bom) == PCAPNG_BOM) {
+            p->swapped = 1;
+        } else {
+            return -1;
+        }
+        p->ifCount = 0; // interfaces are per section
+    } else {
+        type = r32(p, b);
+    }
+    uint32_t blen = r32(p, b + 4);
+    if (blen < 12 || blen % 4 || blen > (1 << 26)) {
+        return -1;
+    }
+    *reclen = blen;
+    if (!available(p, blen)) {
+        return 0; // the caller refills and parses again
+    }
+
+    switch (type) {
+    case PCAPNG_IDB:
+        parseIdb(p, b, blen);
+        return 0;
+    case PCAPNG_EPB: {
+        if (blen < 32) {
+            return -1;
+        }
+        uint32_t id = r32(p, b + 8);
+        uint32_t caplen = r32(p, b + 20);
+        if (id >= p->ifCount || id >= PCAPNG_MAX_IF || 28 + caplen > blen) {
+            return -1;
+        }
+        uint64_t ts = ((uint64_t)r32(p, b + 12) << 32) | r32(p, b + 16);
+        frame->offset = 28;
+        frame->caplen = caplen;
+        frame->linktype = p->ifLinktype[id];
+        frame->tsNs = ngTsToNs(ts, p->ifTsResol[id]);
+        return 1;
+    }
+    case PCAPNG_SPB: {
+        if (blen < 16 || p->ifCount == 0) {
+            return -1;
+        }
+        uint32_t caplen = r32(p, b + 8);
+        if (caplen > blen - 16) {
+            caplen = blen - 16;
+        }
+        frame->offset = 12;
+        frame->caplen = caplen;
+        frame->linktype = p->ifLinktype[0];
+        frame->tsNs = 0;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+int gcdPcapForEach(gcd_pcap_t *pcap, uint32_t batch, onGtpcBatch cb, void *arg)
+{
+    if (batch == 0) {
+        batch = 1;
+    }
+    gcd_payload_t *payloads = malloc(sizeof(*payloads) * batch);
+    if (!payloads) {
+        return -1;
+    }
+    uint32_t n = 0;
+    int ret = 0, stop = 0;
+    uint32_t hdrlen = pcap->ng ? 12 : 16;
+
+#define FLUSH()                                        \
+    do {                                               \
+        if (n) {                                       \
+            stop = cb(payloads, n, arg);               \
+            n = 0;                                     \
+            if (pcap->reasm) {                         \
+                gcdReasmRelease(pcap->reasm);          \
+            }                                          \
+        }                                              \
+    } while (0)
+
+    while (!stop) {
+        if (!available(pcap, hdrlen)) {
+            FLUSH();
+            if (stop) {
+                break;
+            }
+            if (!refill(pcap, hdrlen)) {
+                ret = available(pcap, 1) ? -1 : 0; // trailing garbage
+                break;
+            }
+        }
+        uint32_t reclen = 0;
+        frame_t frame;
+        int rc = pcap->ng ? parseNgBlock(pcap, &reclen, &frame)
+                          : parsePcapRecord(pcap, &reclen, &frame);
+        if (rc < 0) {
+            ret = -1;
+            break;
+        }
+        if (!available(pcap, reclen)) {
+            FLUSH();
+            if (stop) {
+                break;
+            }
+            if (!refill(pcap, reclen)) {
+                ret = -1; // truncated record
+                break;
+            }
+            continue; // parse again at the new position of the window
+        }
+        if (rc == 1) {
+            gcd_payload_t *out = &payloads[n];
+            pcap->stats.frames++;
+            pcap->stats.bytes += frame.caplen;
+            uint8_t *data = pcap->buf + pcap->pos + frame.offset;
+            int found = pcap->reasm
+                            ? gcdReasmLocate(pcap->reasm, data, frame.caplen,
+                                             frame.linktype, frame.tsNs, out)
+                            : gcdLocateGtpc(data, frame.caplen,
+                                            frame.linktype, out);
+            if (found > 0) {
+                out->tsNs = frame.tsNs;
+                pcap->stats.payloads++;
+                if (++n == batch) {
+                    FLUSH();
+                }
+            } else if (found < 0) {
+                pcap->stats.malformed++;
+            }
+        }
+        pcap->pos += reclen;
+    }
+    if (!stop) {
+        FLUSH();
+    }
+
+#undef FLUSH
+
+    free(payloads);
+    return ret;
+}
@@ -0,0 +1,64 @@
+#ifndef GTPC_PCAP_H_
+#define GTPC_PCAP_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gtpc-packet.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gcd_pcap_s gcd_pcap_t;
+
+typedef struct gcd_pcap_stats_s {
+    uint64_t frames;    // records read
+    uint64_t bytes;     // captured bytes of those records
+    uint64_t payloads;  // gtpc payloads located
+    uint64_t malformed; // frames with broken link/ip/udp headers
+} gcd_pcap_stats_t;
+
+/*
+ * called with up to the requested batch of payloads, they point into the
+ * capture and are only valid during the call
+ * @return
+ *   0 to continue, anything else stops the walk
+ */
+typedef int (*onGtpcBatch)(gcd_payload_t *payloads, uint32_t n, void *arg);
+
+/**
+ * open a pcap or pcapng capture. regular files are mapped into memory,
+ * "-" reads stdin and names ending in .gz are streamed through gzip -dc
+ * @return
+ *   NULL on error
+ */
+GCD_PUBLIC gcd_pcap_t *gcdPcapOpen(const char *path);
+/**
+ * read a capture from an already opened stream, eg. a pipe
+ * @return
+ *   NULL on error
+ */
+GCD_PUBLIC gcd_pcap_t *gcdPcapOpenStream(FILE *fp);
+GCD_PUBLIC void gcdPcapClose(gcd_pcap_t *pcap);
+/**
+ * locate every gtpc payload of the capture and hand them to cb in batches
+ * @return
+ *   -1 on a malformed or truncated capture
+ *   0  on end of capture or when cb asked to stop
+ */
+GCD_PUBLIC int gcdPcapForEach(gcd_pcap_t *pcap, uint32_t batch,
+                              onGtpcBatch cb, void *arg);
+/**
+ * reassemble ip fragments with reasm in gcdPcapForEach(), captures read
+ * one after the other may share it. reassembled payloads are valid during
+ * the callback like the others
+ */
+GCD_PUBLIC void gcdPcapSetReassembly(gcd_pcap_t *pcap, gcd_reasm_t *reasm);
+GCD_PUBLIC const gcd_pcap_stats_t *gcdPcapStats(const gcd_pcap_t *pcap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
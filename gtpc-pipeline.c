@@ -0,0 +1,478 @@
+#define _GNU_SOURCE
+#include "gtpc-pipeline.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GCD_CACHE_LINE     64
+#define DEFAULT_CHUNK_SIZE 256
+#define DEFAULT_MSG_BYTES  512
+#define CHUNKS_PER_WORKER  4
+#define SPIN_ROUNDS        256
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpuRelax() __builtin_ia32_pause()
+#else
+#define cpuRelax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+/* sleeping threads, wakers only take the lock when somebody sleeps */
+typedef struct park_s {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t sleepers;
+} park_t;
+
+/*
+ * single producer, multi consumer ring of chunks. it holds every chunk in
+ * flight, so it is never full and a slot is never reused while a consumer
+ * may still read it
+ */
+typedef struct ring_s {
+    uint64_t head __attribute__((aligned(GCD_CACHE_LINE)));
+    uint64_t tail __attribute__((aligned(GCD_CACHE_LINE)));
+    uint64_t mask;
+    gcd_chunk_t **slots;
+} ring_t;
+
+typedef struct worker_s {
+    ring_t ring;
+    struct gcd_pipeline_s *pipeline;
+    pthread_t thread;
+    uint32_t id;
+    int cpu; // -1 not pinned
+} __attribute__((aligned(GCD_CACHE_LINE))) worker_t;
+
+struct gcd_pipeline_s {
+    gcd_pipeline_conf_t conf;
+    worker_t *workers;
+    uint32_t nworkers;
+    uint32_t next; // worker getting the next chunk
+    uint64_t seq;
+    uint32_t stop;
+    park_t work;
+    uint32_t started; // workers done with their setup
+
+    /* lock-free stack of free chunks, only the producer pops */
+    gcd_chunk_t *free __attribute__((aligned(GCD_CACHE_LINE)));
+    park_t freed;
+    gcd_chunk_t *chunks;
+    uint32_t nchunks;
+
+    /* ordered mode, chunks wait in done[seq % nchunks] for their turn */
+    pthread_mutex_t sinkLock __attribute__((aligned(GCD_CACHE_LINE)));
+    uint64_t deliver;
+    gcd_chunk_t **done;
+};
+
+static void parkInit(park_t *pk)
+{
+    pthread_mutex_init(&pk->lock, NULL);
+    pthread_cond_init(&pk->cond, NULL);
+    pk->sleepers = 0;
+}
+
+static void parkWait(park_t *pk, int (*ready)(void *), void *arg)
+{
+    for (int i = 0; i < SPIN_ROUNDS; i++) {
+        if (ready(arg)) {
+            return;
+        }
+        cpuRelax();
+    }
+    pthread_mutex_lock(&pk->lock);
+    __atomic_add_fetch(&pk->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (!ready(arg)) {
+        pthread_cond_wait(&pk->cond, &pk->lock);
+    }
+    __atomic_sub_fetch(&pk->sleepers, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pk->lock);
+}
+
+/* the state waited for is published before this is called */
+static void parkWake(park_t *pk)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pk->sleepers, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&pk->lock);
+        pthread_cond_broadcast(&pk->cond);
+        pthread_mutex_unlock(&pk->lock);
+    }
+}
+
+static void ringPush(ring_t *ring, gcd_chunk_t *chunk)
+{
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->slots[tail & ring->mask], chunk, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static gcd_chunk_t *ringPop(ring_t *ring)
+{
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head >= tail) {
+            return NULL;
+        }
+        gcd_chunk_t *chunk =
+            __atomic_load_n(&ring->slots[head & ring->mask], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&ring->head, &head, head + 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return chunk;
+        }
+    }
+}
+
+static int ringEmpty(ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)
+           >= __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+static void releaseChunk(gcd_pipeline_t *p, gcd_chunk_t *chunk)
+{
+    chunk->count = 0;
+    chunk->ok = 0;
+    chunk->arenaUsed = 0;
+    chunk->next = __atomic_load_n(&p->free, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&p->free, &chunk->next, chunk, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    parkWake(&p->freed);
+}
+
+static void deliverOrdered(gcd_pipeline_t *p, gcd_chunk_t *chunk)
+{
+    __atomic_store_n(&p->done[chunk->seq % p->nchunks], chunk,
+                     __ATOMIC_RELEASE);
+    /*
+     * whoever holds the lock delivers every chunk that is due. a chunk
+     * stored while the holder is leaving is picked up by the recheck
+     */
+    for (;;) {
+        if (pthread_mutex_trylock(&p->sinkLock)) {
+            return;
+        }
+        for (;;) {
+            gcd_chunk_t **slot = &p->done[p->deliver % p->nchunks];
+            gcd_chunk_t *due = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+            if (!due) {
+                break;
+            }
+            __atomic_store_n(slot, NULL, __ATOMIC_RELAXED);
+            __atomic_store_n(&p->deliver, p->deliver + 1, __ATOMIC_RELEASE);
+            p->conf.sink(due, p->conf.arg);
+            releaseChunk(p, due);
+        }
+        uint64_t deliver = __atomic_load_n(&p->deliver, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&p->sinkLock);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&p->done[deliver % p->nchunks], __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+}
+
+static void processChunk(gcd_pipeline_t *p, gcd_chunk_t *chunk)
+{
+    memset(chunk->gtp, 0, sizeof(gtp_t) * chunk->count);
+    if (p->conf.decoder) {
+        for (uint32_t i = 0; i < chunk->count; i++) {
+            if (i + 1 < chunk->count) {
+                GCD_PREFETCH_R(chunk->data[i + 1]);
+            }
+            chunk->status[i] = gcdDecode(p->conf.decoder, chunk->data[i],
+                                         chunk->len[i], &chunk->gtp[i]);
+            chunk->ok += chunk->status[i] == 1;
+        }
+    } else {
+        chunk->ok = decodeGtpcBatch(chunk->data, chunk->len, chunk->gtp,
+                                    chunk->status, chunk->count);
+    }
+
+    if (p->conf.ordered) {
+        deliverOrdered(p, chunk);
+    } else {
+        p->conf.sink(chunk, p->conf.arg);
+        releaseChunk(p, chunk);
+    }
+}
+
+/* take work of the other workers, starting with the neighbour */
+static gcd_chunk_t *steal(gcd_pipeline_t *p, worker_t *self)
+{
+    for (uint32_t i = 1; i < p->nworkers; i++) {
+        worker_t *victim = &p->workers[(self->id + i) % p->nworkers];
+        gcd_chunk_t *chunk = ringPop(&victim->ring);
+        if (chunk) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+static int pendingWork(gcd_pipeline_t *p)
+{
+    for (uint32_t i = 0; i < p->nworkers; i++) {
+        if (!ringEmpty(&p->workers[i].ring)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int workReady(void *arg)
+{
+    gcd_pipeline_t *p = arg;
+    return __atomic_load_n(&p->stop, __ATOMIC_ACQUIRE) || pendingWork(p);
+}
+
+static void *workerMain(void *arg)
+{
+    worker_t *self = arg;
+    gcd_pipeline_t *p = self->pipeline;
+
+    if (self->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(self->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    /* first touch after pinning keeps the ring on the worker's node */
+    memset(self->ring.slots, 0, sizeof(gcd_chunk_t *) * (self->ring.mask + 1));
+    __atomic_add_fetch(&p->started, 1, __ATOMIC_RELEASE);
+
+    for (;;) {
+        gcd_chunk_t *chunk = ringPop(&self->ring);
+        if (!chunk) {
+            chunk = steal(p, self);
+        }
+        if (chunk) {
+            processChunk(p, chunk);
+            continue;
+        }
+        /* the producer has stopped once stop is set, rings only drain */
+        if (__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE) && !pendingWork(p)) {
+            break;
+        }
+        parkWait(&p->work, workReady, p);
+    }
+    return NULL;
+}
+
+static int chunkFree(void *arg)
+{
+    gcd_pipeline_t *p = arg;
+    return __atomic_load_n(&p->free, __ATOMIC_ACQUIRE) != NULL;
+}
+
+gcd_chunk_t *gcdPipelineAcquire(gcd_pipeline_t *pipeline)
+{
+    for (;;) {
+        gcd_chunk_t *chunk = __atomic_load_n(&pipeline->free, __ATOMIC_ACQUIRE);
+        /* single consumer, so the head cannot be popped and pushed back
+         * behind our back and the exchange is free of ABA */
+        while (chunk
+               && !__atomic_compare_exchange_n(&pipeline->free, &chunk,
+                                               chunk->next, 1, __ATOMIC_ACQUIRE,
+                                               __ATOMIC_ACQUIRE)) {
+        }
+        if (chunk) {
+            return chunk;
+        }
+        parkWait(&pipeline->freed, chunkFree, pipeline);
+    }
+}
+
+void gcdPipelineSubmit(gcd_pipeline_t *pipeline, gcd_chunk_t *chunk)
+{
+    chunk->seq = pipeline->seq++;
+    worker_t *w = &pipeline->workers[pipeline->next];
+    if (++pipeline->next == pipeline->nworkers) {
+        pipeline->next = 0;
+    }
+    ringPush(&w->ring, chunk);
+    parkWake(&pipeline->work);
+}
+
+int gcdChunkAdd(gcd_chunk_t *chunk, uint8_t *data, uint32_t len)
+{
+    if (chunk->count == chunk->capacity) {
+        return -1;
+    }
+    chunk->data[chunk->count] = data;
+    chunk->len[chunk->count] = len;
+    return chunk->count++;
+}
+
+int gcdChunkAppend(gcd_chunk_t *chunk, const uint8_t *data, uint32_t len)
+{
+    if (chunk->count == chunk->capacity
+        || len > chunk->arenaSize - chunk->arenaUsed) {
+        return -1;
+    }
+    uint8_t *copy = chunk->arena + chunk->arenaUsed;
+    memcpy(copy, data, len);
+    chunk->arenaUsed += (len + 7) & ~7u;
+    if (chunk->arenaUsed > chunk->arenaSize) {
+        chunk->arenaUsed = chunk->arenaSize;
+    }
+    return gcdChunkAdd(chunk, copy, len);
+}
+
+static uint32_t allowedCpus(int *cpus, uint32_t max)
+{
+    cpu_set_t set;
+    uint32_t n = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        return 0;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus[n++] = cpu;
+        }
+    }
+    return n;
+}
+
+static int initChunk(gcd_pipeline_t *p, gcd_chunk_t *chunk)
+{
+    const gcd_pipeline_conf_t *conf = &p->conf;
+    chunk->capacity = conf->chunkSize;
+    chunk->userSize = conf->userSize;
+    chunk->arenaSize = conf->arenaSize;
+    chunk->data = calloc(conf->chunkSize, sizeof(*chunk->data));
+    chunk->len = calloc(conf->chunkSize, sizeof(*chunk->len));
+    chunk->status = calloc(conf->chunkSize, sizeof(*chunk->status));
+    chunk->gtp = calloc(conf->chunkSize, sizeof(*chunk->gtp));
+    chunk->user = calloc(conf->chunkSize, conf->userSize ? conf->userSize : 1);
+    chunk->arena = malloc(conf->arenaSize ? conf->arenaSize : 1);
+    return chunk->data && chunk->len && chunk->status && chunk->gtp
+           && chunk->user && chunk->arena;
+}
+
+static void freeChunk(gcd_chunk_t *chunk)
+{
+    free(chunk->data);
+    free(chunk->len);
+    free(chunk->status);
+    free(chunk->gtp);
+    free(chunk->user);
+    free(chunk->arena);
+}
+
+static void freePipeline(gcd_pipeline_t *p)
+{
+    for (uint32_t i = 0; p->chunks && i < p->nchunks; i++) {
+        freeChunk(&p->chunks[i]);
+    }
+    for (uint32_t i = 0; p->workers && i < p->nworkers; i++) {
+        free(p->workers[i].ring.slots);
+    }
+    free(p->chunks);
+    free(p->workers);
+    free(p->done);
+    free(p);
+}
+
+static void stopWorkers(gcd_pipeline_t *p, uint32_t running)
+{
+    __atomic_store_n(&p->stop, 1, __ATOMIC_RELEASE);
+    parkWake(&p->work);
+    for (uint32_t i = 0; i < running; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+}
+
+gcd_pipeline_t *gcdPipelineCreate(const gcd_pipeline_conf_t *conf)
+{
+    if (!conf->sink) {
+        return NULL;
+    }
+    gcd_pipeline_t *p = NULL;
+    if (posix_memalign((void **)&p, GCD_CACHE_LINE, sizeof(*p))) {
+        return NULL;
+    }
+    memset(p, 0, sizeof(*p));
+    p->conf = *conf;
+
+    int cpus[CPU_SETSIZE];
+    uint32_t ncpus = allowedCpus(cpus, CPU_SETSIZE);
+    p->nworkers = conf->workers ? conf->workers : (ncpus ? ncpus : 1);
+    if (!p->conf.chunkSize) {
+        p->conf.chunkSize = DEFAULT_CHUNK_SIZE;
+    }
+    if (!p->conf.arenaSize) {
+        p->conf.arenaSize = p->conf.chunkSize * DEFAULT_MSG_BYTES;
+    }
+    if (!p->conf.inflight) {
+        p->conf.inflight = p->nworkers * CHUNKS_PER_WORKER;
+    }
+    p->nchunks = p->conf.inflight;
+
+    uint64_t ringSize = 1;
+    while (ringSize < p->nchunks) {
+        ringSize <<= 1;
+    }
+    p->chunks = calloc(p->nchunks, sizeof(*p->chunks));
+    p->done = calloc(p->nchunks, sizeof(*p->done));
+    if (posix_memalign((void **)&p->workers, GCD_CACHE_LINE,
+                       sizeof(*p->workers) * p->nworkers)) {
+        p->workers = NULL;
+    }
+    if (!p->chunks || !p->done || !p->workers) {
+        freePipeline(p);
+        return NULL;
+    }
+    memset(p->workers, 0, sizeof(*p->workers) * p->nworkers);
+    for (uint32_t i = 0; i < p->nworkers; i++) {
+        worker_t *w = &p->workers[i];
+        w->pipeline = p;
+        w->id = i;
+        w->cpu = conf->pin && ncpus ? cpus[i % ncpus] : -1;
+        w->ring.mask = ringSize - 1;
+        w->ring.slots = malloc(sizeof(gcd_chunk_t *) * ringSize);
+        if (!w->ring.slots) {
+            freePipeline(p);
+            return NULL;
+        }
+    }
+    for (uint32_t i = 0; i < p->nchunks; i++) {
+        if (!initChunk(p, &p->chunks[i])) {
+            freePipeline(p);
+            return NULL;
+        }
+        p->chunks[i].next = i + 1 < p->nchunks ? &p->chunks[i + 1] : NULL;
+    }
+    p->free = &p->chunks[0];
+
+    parkInit(&p->work);
+    parkInit(&p->freed);
+    pthread_mutex_init(&p->sinkLock, NULL);
+    for (uint32_t i = 0; i < p->nworkers; i++) {
+        if (pthread_create(&p->workers[i].thread, NULL, workerMain,
+                           &p->workers[i])) {
+            stopWorkers(p, i);
+            freePipeline(p);
+            return NULL;
+        }
+    }
+    /* the rings are touched by their workers before anything is pushed */
+    while (__atomic_load_n(&p->started, __ATOMIC_ACQUIRE) < p->nworkers) {
+        sched_yield();
+    }
+    return p;
+}
+
+void gcdPipelineDestroy(gcd_pipeline_t *pipeline)
+{
+    if (!pipeline) {
+        return;
+    }
+    stopWorkers(pipeline, pipeline->nworkers);
+    pthread_mutex_destroy(&pipeline->sinkLock);
+    freePipeline(pipeline);
+}
@@ -0,0 +1,103 @@
+#ifndef GTPC_PIPELINE_H_
+#define GTPC_PIPELINE_H_
+
+#include <stdint.h>
+
+#include "gtpc-context.h"
+#include "gtpc-decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * a chunk carries a batch of messages from the producer to a worker and
+ * then, decoded, to the sink. messages either reference memory of the
+ * producer (gcdChunkAdd), which must stay valid until the sink has seen
+ * the chunk, or are copied into the chunk (gcdChunkAppend)
+ */
+typedef struct gcd_chunk_s {
+    uint64_t seq;      // submission order, starting at 0
+    uint32_t count;    // messages in the chunk
+    uint32_t capacity; // maximum messages
+    uint32_t ok;       // messages decoded successfully
+    uint8_t **data;
+    uint32_t *len;
+    int *status; // decodeGtpc() return value of each message
+    gtp_t *gtp;
+    uint8_t *user; // userSize bytes per message for the producer, see conf
+    uint32_t userSize;
+    uint32_t arenaSize;
+    uint32_t arenaUsed;
+    uint8_t *arena;
+    struct gcd_chunk_s *next;
+} gcd_chunk_t;
+
+/*
+ * called with every decoded chunk, the chunk is recycled on return. in
+ * ordered mode calls are serialized and follow submission order, otherwise
+ * workers call it concurrently
+ */
+typedef void (*onGcdChunk)(gcd_chunk_t *chunk, void *arg);
+
+typedef struct gcd_pipeline_conf_s {
+    uint32_t workers;   // decoding threads, 0 for one per allowed cpu
+    uint32_t chunkSize; // messages per chunk, 0 for 256
+    uint32_t arenaSize; // bytes per chunk for gcdChunkAppend, 0 for 512/msg
+    uint32_t userSize;  // producer bytes per message
+    uint32_t inflight;  // chunks in flight, 0 for 4 per worker
+    int pin;            // pin worker i to the i-th cpu of the affinity mask
+    int ordered;        // restore submission order before the sink
+    gcd_decoder_t *decoder; // NULL decodes with the global parsers
+    onGcdChunk sink;
+    void *arg;
+} gcd_pipeline_conf_t;
+
+typedef struct gcd_pipeline_s gcd_pipeline_t;
+
+/**
+ * start the workers of a pipeline
+ * @return
+ *   NULL on error
+ */
+GCD_PUBLIC gcd_pipeline_t *gcdPipelineCreate(const gcd_pipeline_conf_t *conf);
+/**
+ * wait for every submitted chunk to reach the sink, then stop the workers
+ */
+GCD_PUBLIC void gcdPipelineDestroy(gcd_pipeline_t *pipeline);
+/**
+ * take an empty chunk, blocks while every chunk is in flight. chunks are
+ * acquired and submitted by a single producer thread
+ */
+GCD_PUBLIC gcd_chunk_t *gcdPipelineAcquire(gcd_pipeline_t *pipeline);
+/**
+ * hand a filled chunk to the workers
+ */
+GCD_PUBLIC void gcdPipelineSubmit(gcd_pipeline_t *pipeline,
+                                  gcd_chunk_t *chunk);
+/**
+ * add a message referencing data
+ * @return
+ *   -1 chunk full
+ *   index of the message otherwise
+ */
+GCD_PUBLIC int gcdChunkAdd(gcd_chunk_t *chunk, uint8_t *data, uint32_t len);
+/**
+ * add a copy of data
+ * @return
+ *   -1 chunk or its arena full
+ *   index of the message otherwise
+ */
+GCD_PUBLIC int gcdChunkAppend(gcd_chunk_t *chunk, const uint8_t *data,
+                              uint32_t len);
+
+static inline void *gcdChunkUser(gcd_chunk_t *chunk, uint32_t i)
+{
+    return chunk->user + (uint64_t)i * chunk->userSize;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,294 @@
+#include "gtpc-record.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "util.h"
+
+static inline uint32_t loadPlmn(uint8_t *p)
+{
+    return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+static int loadAddr(uint8_t *p, uint16_t len, gtp_addr_t *addr)
+{
+    if (len == 4) {
+        addr->family = GTP_ADDR_IPV4;
+    } else if (len == 16) {
+        addr->family = GTP_ADDR_IPV6;
+    } else {
+        return 0;
+    }
+    memcpy(addr->addr, p, len);
+    return 1;
+}
+
+/* BCD2U64 counts digits in a uint8_t, longer values are rejected first */
+static int loadDigits(uint8_t *v, uint16_t len, uint16_t max,
+                      uint64_t *value, uint8_t *digits)
+{
+    if (len > max) {
+        return 0;
+    }
+    *digits = BCD2U64(v, len * 2, value);
+    return 1;
+}
+
+static int recordGtpv1IE(uint8_t *v, const gtp_ie_ref_t *ie, uint16_t seen,
+                         gcd_intern_t *intern, gtp_record_t *rec)
+{
+    uint16_t len = ie->length;
+    switch (ie->type) {
+    case 0x01: // cause
+        rec->cause = v[0];
+        break;
+    case 0x02: // imsi
+        return loadDigits(v, len, MAX_IMSI_LEN, &rec->imsi, &rec->imsiDigits);
+    case 0x03: // routing area identity
+        rec->raiPlmn = loadPlmn(v);
+        rec->raiLac = ntohs(*(uint16_t *)(v + 3));
+        rec->raiRac = v[5];
+        if (intern) {
+            rec->raiPlmnId = gcdInternPlmn(intern, v);
+        }
+        break;
+    case 0x0F: // selection mode
+        rec->selectionMode = v[0] & 0x03;
+        break;
+    case 0x10: // teid data I, flow label data I on v0
+        rec->teid = rec->hdr.version == 0 ? ntohs(*(uint16_t *)v)
+                                          : ntohl(*(uint32_t *)v);
+        break;
+    case 0x11: // teid control plane, flow label signalling on v0
+        rec->teidControlPlane = rec->hdr.version == 0
+                                    ? ntohs(*(uint16_t *)v)
+                                    : ntohl(*(uint32_t *)v);
+        break;
+    case 0x14: // nsapi
+        if (rec->hdr.version == 1) {
+            rec->nsapi = v[0] & 0x0F;
+        }
+        break;
+    case 0x7F: // charging id
+        rec->chargingId = ntohl(*(uint32_t *)v);
+        break;
+    case 0x80: // end user address
+        if (len < 2) {
+            return 0;
+        }
+        if (len == 6 || len == 22) {
+            loadAddr(v + 2, 4, &rec->endUserAddress);
+        } else if (len == 18) {
+            loadAddr(v + 2, 16, &rec->endUserAddress);
+        }
+        break;
+    case 0x83: // access point name
+        if (intern) {
+            rec->apnId = gcdInternApn(intern, v, len);
+        }
+        break;
+    case 0x85: // gsn address, signalling first then user plane
+        // later ones are the alternative addresses, bad lengths are skipped
+        if (seen < 2) {
+            loadAddr(v, len, seen ? &rec->gsnAddressUser
+                                  : &rec->gsnAddressSignal);
+        }
+        break;
+    case 0x86: // msisdn, skip the extension/numbering plan octet
+        if (len < 1) {
+            return 0;
+        }
+        return loadDigits(v + 1, len - 1, MAX_MSISDN_LEN, &rec->msisdn,
+                          &rec->msisdnDigits);
+    case 0x97: // rat type
+        if (len < 1) {
+            return 0;
+        }
+        rec->ratType = v[0];
+        break;
+    case 0x98: // user location information, CGI only
+        if (len < 8) {
+            return 0;
+        }
+        if (v[0] == 0) {
+            rec->uliPlmn = loadPlmn(v + 1);
+            rec->uliLac = ntohs(*(uint16_t *)(v + 4));
+            rec->uliCellId = ntohs(*(uint16_t *)(v + 6));
+            if (intern) {
+                rec->uliPlmnId = gcdInternPlmn(intern, v + 1);
+            }
+        }
+        break;
+    case 0x9A: // imei(sv)
+        return loadDigits(v, len, MAX_IMEISV_LEN, &rec->imei,
+                          &rec->imeiDigits);
+    default:
+        break;
+    }
+    return 1;
+}
+
+static int recordGtpv2IE(uint8_t *v, const gtp_ie_ref_t *ie, uint16_t seen,
+                         gcd_intern_t *intern, gtp_record_t *rec)
+{
+    uint16_t len = ie->length;
+    switch (ie->type) {
+    case 1: // imsi
+        return loadDigits(v, len, MAX_IMSI_LEN, &rec->imsi, &rec->imsiDigits);
+    case 2: // cause
+        if (len < 2) {
+            return 0;
+        }
+        rec->cause = v[0];
+        break;
+    case 71: // apn
+        if (intern) {
+            rec->apnId = gcdInternApn(intern, v, len);
+        }
+        break;
+    case 73: // eps bearer id
+        if (len < 1) {
+            return 0;
+        }
+        rec->nsapi = v[0] & 0x0F;
+        break;
+    case 75: // mei
+        return loadDigits(v, len, MAX_IMEISV_LEN, &rec->imei,
+                          &rec->imeiDigits);
+    case 76: // msisdn
+        return loadDigits(v, len, MAX_MSISDN_LEN, &rec->msisdn,
+                          &rec->msisdnDigits);
+    case 79: // pdn address allocation
+        if (len < 1) {
+            return 0;
+        }
+        if ((v[0] & 0x07) == 1 && len >= 5) {
+            loadAddr(v + 1, 4, &rec->endUserAddress);
+        } else if ((v[0] & 0x07) == 2 && len >= 18) {
+            loadAddr(v + 2, 16, &rec->endUserAddress);
+        } else if ((v[0] & 0x07) == 3 && len >= 22) {
+            loadAddr(v + 18, 4, &rec->endUserAddress);
+        }
+        break;
+    case 82: // rat type
+        if (len < 1) {
+            return 0;
+        }
+        rec->ratType = v[0];
+        break;
+    case 87: // f-teid, the sender's control plane endpoint is instance 0
+        if (len < 5) {
+            return 0;
+        }
+        if (ie->instance == 0 && rec->teidControlPlane == 0) {
+            rec->teidControlPlane = ntohl(*(uint32_t *)(v + 1));
+            if (v[0] & 0x80 && len >= 9) {
+                loadAddr(v + 5, 4, &rec->gsnAddressSignal);
+            } else if (v[0] & 0x40 && len >= 21) {
+                loadAddr(v + 5, 16, &rec->gsnAddressSignal);
+            }
+        }
+        break;
+    case 94: // charging id
+        if (len < 4) {
+            return 0;
+        }
+        rec->chargingId = ntohl(*(uint32_t *)v);
+        break;
+    case 128: // selection mode
+        if (len < 1) {
+            return 0;
+        }
+        rec->selectionMode = v[0] & 0x03;
+        break;
+    default:
+        break;
+    }
+    return 1;
+}
+
+int gtpcRecordFromView(const gtp_view_t *view, gtp_record_t *rec)
+{
+    return gtpcRecordFromViewIntern(view, NULL, rec);
+}
+
+int gtpcRecordFromViewIntern(const gtp_view_t *view, gcd_intern_t *intern,
+                             gtp_record_t *rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->hdr = view->hdr;
+    uint16_t seen = 0; // earlier IEs of the same type in a row
+    for (uint16_t i = 0; i < view->count; i++) {
+        const gtp_ie_ref_t *ie = &view->ies[i];
+        uint8_t *v = view->data + ie->offset;
+        seen = i && view->ies[i - 1].type == ie->type ? seen + 1 : 0;
+        int ret = view->hdr.version == 2
+                      ? recordGtpv2IE(v, ie, seen, intern, rec)
+                      : recordGtpv1IE(v, ie, seen, intern, rec);
+        if (!ret) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int decodeGtpcRecord(uint8_t *data, uint32_t len, gtp_record_t *rec)
+{
+    return decodeGtpcRecordIntern(data, len, NULL, rec);
+}
+
+int decodeGtpcRecordIntern(uint8_t *data, uint32_t len, gcd_intern_t *intern,
+                           gtp_record_t *rec)
+{
+    gtp_view_t view;
+    int ret = decodeGtpcView(data, len, &view);
+    if (ret != 1) {
+        return ret;
+    }
+    return gtpcRecordFromViewIntern(&view, intern, rec);
+}
+
+int gtpcFormatDigits(uint64_t value, uint8_t digits, char *out,
+                     uint32_t outLen)
+{
+    if (digits == 0 || outLen <= digits) {
+        return 0;
+    }
+    out[digits] = 0;
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return digits;
+}
+
+int gtpcFormatPlmn(uint32_t plmn, char mcc[MAX_MCC_SIZE + 1],
+                   char mnc[MAX_MNC_SIZE + 1])
+{
+    static const char hex[] = "0123456789abcdef";
+    uint8_t b0 = plmn >> 16, b1 = plmn >> 8, b2 = plmn;
+    mcc[0] = hex[b0 & 0x0F];
+    mcc[1] = hex[b0 >> 4];
+    mcc[2] = hex[b1 & 0x0F];
+    mcc[3] = 0;
+    mnc[0] = hex[b2 & 0x0F];
+    mnc[1] = hex[b2 >> 4];
+    if ((b1 >> 4) == 0x0F) {
+        mnc[2] = 0;
+        return 2;
+    }
+    mnc[2] = hex[b1 >> 4];
+    mnc[3] = 0;
+    return 3;
+}
+
+int gtpcFormatAddr(const gtp_addr_t *addr, char *out, uint32_t outLen)
+{
+    int af = addr->family == GTP_ADDR_IPV4   ? AF_INET
+             : addr->family == GTP_ADDR_IPV6 ? AF_INET6
+                                             : 0;
+    if (!af || !inet_ntop(af, addr->addr, out, outLen)) {
+        return 0;
+    }
+    return strlen(out);
+}
@@ -0,0 +1,98 @@
+#ifndef GTPC_RECORD_H_
+#define GTPC_RECORD_H_
+
+#include <stdint.h>
+
+#include "gtpc-intern.h"
+#include "gtpc-view.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GTP_ADDR_NONE 0
+#define GTP_ADDR_IPV4 4
+#define GTP_ADDR_IPV6 6
+typedef struct gtp_addr_s {
+    uint8_t family; // GTP_ADDR_NONE/IPV4/IPV6
+    uint8_t addr[16]; // network byte order, ipv4 uses the first 4 bytes
+} gtp_addr_t;
+
+/*
+ * compact binary form of a decoded message, identifiers are kept as packed
+ * integers and addresses in binary, nothing is formatted until asked for
+ */
+typedef struct gtp_record_s {
+    gtp_header_t hdr;
+    uint32_t teid;             // TEID data I (v1) / flow label data (v0)
+    uint32_t teidControlPlane; // TEID control plane (v1)
+    uint32_t chargingId;
+    uint32_t raiPlmn; // 24-bit wire form of MCC/MNC, see gtpcFormatPlmn()
+    uint32_t uliPlmn;
+    uint64_t imsi; // decimal value, imsiDigits keeps leading zeros
+    uint64_t msisdn;
+    uint64_t imei;
+    uint16_t raiLac;
+    uint16_t uliLac;
+    uint16_t uliCellId;
+    uint8_t raiRac;
+    uint8_t imsiDigits;
+    uint8_t msisdnDigits;
+    uint8_t imeiDigits;
+    uint8_t cause;
+    uint8_t ratType;
+    uint8_t selectionMode;
+    uint8_t nsapi;
+    uint16_t apnId; // ids of a gcd_intern_t, 0 when decoded without one
+    uint16_t raiPlmnId;
+    uint16_t uliPlmnId;
+    gtp_addr_t endUserAddress;
+    gtp_addr_t gsnAddressSignal;
+    gtp_addr_t gsnAddressUser;
+} gtp_record_t;
+
+/**
+ * fill a compact record from an indexed message
+ * @return
+ *   0  a present IE is malformed
+ *   1  success
+ */
+GCD_PUBLIC int gtpcRecordFromView(const gtp_view_t *view, gtp_record_t *rec);
+/**
+ * gtpcRecordFromView() also filling the APN and PLMN ids from intern
+ */
+GCD_PUBLIC int gtpcRecordFromViewIntern(const gtp_view_t *view,
+                                        gcd_intern_t *intern,
+                                        gtp_record_t *rec);
+/**
+ * decode gtpc data straight into a compact record
+ * @return
+ *   same as decodeGtpc
+ */
+GCD_PUBLIC int decodeGtpcRecord(uint8_t *data, uint32_t len,
+                                gtp_record_t *rec);
+GCD_PUBLIC int decodeGtpcRecordIntern(uint8_t *data, uint32_t len,
+                                      gcd_intern_t *intern, gtp_record_t *rec);
+
+/**
+ * formatting helpers, only needed when a string is actually wanted
+ * @return
+ *   length of the string written, 0 if out is too small or value is absent
+ */
+GCD_PUBLIC int gtpcFormatDigits(uint64_t value, uint8_t digits, char *out,
+                                uint32_t outLen);
+GCD_PUBLIC int gtpcFormatAddr(const gtp_addr_t *addr, char *out,
+                              uint32_t outLen);
+/**
+ * split a 24-bit plmn into mcc and mnc strings
+ * @return
+ *   number of mnc digits
+ */
+GCD_PUBLIC int gtpcFormatPlmn(uint32_t plmn, char mcc[MAX_MCC_SIZE + 1],
+                              char mnc[MAX_MNC_SIZE + 1]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
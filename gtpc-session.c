@@ -0,0 +1,431 @@
+#include "gtpc-session.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GCD_CACHE_LINE         64
+#define DEFAULT_MAX_SESSIONS   (1 << 20)
+#define DEFAULT_SHARDS         64
+#define NIL                    UINT32_MAX
+#define FIND_BATCH_PREFETCH    8
+
+/* message types of ts 29.060 and ts 29.274 */
+#define GTPV1_CREATE_PDP_REQ   16
+#define GTPV1_CREATE_PDP_RSP   17
+#define GTPV1_DELETE_PDP_RSP   21
+#define GTPV1_ACCEPTED         128
+#define GTPV2_CREATE_SESS_REQ  32
+#define GTPV2_CREATE_SESS_RSP  33
+#define GTPV2_DELETE_SESS_RSP  37
+#define GTPV2_ACCEPTED         16
+
+/* open addressing slot, entry is the index + 1 so zeroed slots are empty */
+typedef struct slot_s {
+    uint32_t teid;
+    uint32_t entry;
+} slot_t;
+
+/*
+ * one entry per TEID, the two TEIDs of a session each get a copy so an
+ * entry never has to reach into another shard
+ */
+typedef struct entry_s {
+    gcd_session_t session;
+    uint32_t teid;
+    uint32_t prev; // lru list, head is the most recently used
+    uint32_t next;
+    uint64_t lastSeen;
+} entry_t;
+
+typedef struct shard_s {
+    pthread_mutex_t lock;
+    slot_t *slots;
+    uint32_t mask;
+    entry_t *entries;
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t freeList; // through next
+    uint32_t head;
+    uint32_t tail;
+    gcd_session_stats_t stats;
+} __attribute__((aligned(GCD_CACHE_LINE))) shard_t;
+
+struct gcd_session_table_s {
+    shard_t *shards;
+    uint32_t nshards;
+    uint32_t shardShift;
+    uint64_t idleNs;
+};
+
+static inline uint64_t hashTeid(uint32_t teid)
+{
+    return (teid + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+static inline shard_t *shardOf(gcd_session_table_t *t, uint64_t hash)
+{
+    return &t->shards[t->nshards > 1 ? hash >> t->shardShift : 0];
+}
+
+static inline uint32_t slotOf(const shard_t *s, uint64_t hash)
+{
+    return (uint32_t)(hash >> 16) & s->mask;
+}
+
+static uint32_t lookup(shard_t *s, uint32_t teid, uint64_t hash)
+{
+    for (uint32_t i = slotOf(s, hash);; i = (i + 1) & s->mask) {
+        slot_t *slot = &s->slots[i];
+        if (slot->entry == 0) {
+            return NIL;
+        }
+        if (slot->teid == teid) {
+            return slot->entry - 1;
+        }
+    }
+}
+
+static void lruUnlink(shard_t *s, uint32_t e)
+{
+    entry_t *entry = &s->entries[e];
+    if (entry->prev != NIL) {
+        s->entries[entry->prev].next = entry->next;
+    } else {
+        s->head = entry->next;
+    }
+    if (entry->next != NIL) {
+        s->entries[entry->next].prev = entry->prev;
+    } else {
+        s->tail = entry->prev;
+    }
+}
+
+static void lruPush(shard_t *s, uint32_t e)
+{
+    entry_t *entry = &s->entries[e];
+    entry->prev = NIL;
+    entry->next = s->head;
+    if (s->head != NIL) {
+        s->entries[s->head].prev = e;
+    } else {
+        s->tail = e;
+    }
+    s->head = e;
+}
+
+static void touch(shard_t *s, uint32_t e, uint64_t nowNs)
+{
+    s->entries[e].lastSeen = nowNs;
+    if (s->head != e) {
+        lruUnlink(s, e);
+        lruPush(s, e);
+    }
+}
+
+/* backward shift deletion keeps probe chains intact without tombstones */
+static void removeSlot(shard_t *s, uint32_t teid, uint64_t hash)
+{
+    uint32_t i = slotOf(s, hash);
+    while (s->slots[i].teid != teid || s->slots[i].entry == 0) {
+        if (s->slots[i].entry == 0) {
+            return;
+        }
+        i = (i + 1) & s->mask;
+    }
+    for (uint32_t j = (i + 1) & s->mask;; j = (j + 1) & s->mask) {
+        if (s->slots[j].entry == 0) {
+            break;
+        }
+        uint32_t home = slotOf(s, hashTeid(s->slots[j].teid));
+        // move j back unless its home lies cyclically in (i, j]
+        if (((j - home) & s->mask) >= ((j - i) & s->mask)) {
+            s->slots[i] = s->slots[j];
+            i = j;
+        }
+    }
+    s->slots[i].entry = 0;
+}
+
+static void removeEntry(shard_t *s, uint32_t e)
+{
+    entry_t *entry = &s->entries[e];
+    removeSlot(s, entry->teid, hashTeid(entry->teid));
+    lruUnlink(s, e);
+    entry->next = s->freeList;
+    s->freeList = e;
+    s->used--;
+    s->stats.entries--;
+}
+
+static void store(gcd_session_table_t *t, uint32_t teid,
+                  const gcd_session_t *session, uint64_t nowNs)
+{
+    uint64_t hash = hashTeid(teid);
+    shard_t *s = shardOf(t, hash);
+    pthread_mutex_lock(&s->lock);
+    uint32_t e = lookup(s, teid, hash);
+    if (e == NIL) {
+        if (s->used == s->capacity) {
+            removeEntry(s, s->tail);
+            s->stats.evicted++;
+        }
+        e = s->freeList;
+        s->freeList = s->entries[e].next;
+        s->used++;
+        s->stats.entries++;
+        s->entries[e].teid = teid;
+        uint32_t i = slotOf(s, hash);
+        while (s->slots[i].entry) {
+            i = (i + 1) & s->mask;
+        }
+        s->slots[i].teid = teid;
+        s->slots[i].entry = e + 1;
+        lruPush(s, e);
+    } else {
+        touch(s, e, nowNs);
+    }
+    s->entries[e].session = *session;
+    s->entries[e].lastSeen = nowNs;
+    s->stats.learned++;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* forget a TEID, its session is copied into session if not NULL */
+static int forget(gcd_session_table_t *t, uint32_t teid,
+                  gcd_session_t *session)
+{
+    uint64_t hash = hashTeid(teid);
+    shard_t *s = shardOf(t, hash);
+    pthread_mutex_lock(&s->lock);
+    uint32_t e = lookup(s, teid, hash);
+    if (e != NIL) {
+        if (session) {
+            *session = s->entries[e].session;
+        }
+        removeEntry(s, e);
+        s->stats.removed++;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return e != NIL;
+}
+
+int gcdSessionFind(gcd_session_table_t *table, uint32_t teid,
+                   gcd_session_t *session, uint64_t nowNs)
+{
+    uint64_t hash = hashTeid(teid);
+    shard_t *s = shardOf(table, hash);
+    pthread_mutex_lock(&s->lock);
+    uint32_t e = lookup(s, teid, hash);
+    if (e != NIL) {
+        touch(s, e, nowNs);
+        if (session) {
+            *session = s->entries[e].session;
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return e != NIL;
+}
+
+uint32_t gcdSessionFindBatch(gcd_session_table_t *table, const uint32_t *teids,
+                             gcd_session_t *sessions, int *found, uint32_t n,
+                             uint64_t nowNs)
+{
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < n && i < FIND_BATCH_PREFETCH; i++) {
+        uint64_t hash = hashTeid(teids[i]);
+        shard_t *s = shardOf(table, hash);
+        GCD_PREFETCH_R(&s->slots[slotOf(s, hash)]);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (i + FIND_BATCH_PREFETCH < n) {
+            uint64_t hash = hashTeid(teids[i + FIND_BATCH_PREFETCH]);
+            shard_t *s = shardOf(table, hash);
+            GCD_PREFETCH_R(&s->slots[slotOf(s, hash)]);
+        }
+        found[i] = gcdSessionFind(table, teids[i], &sessions[i], nowNs);
+        hits += found[i];
+    }
+    return hits;
+}
+
+static void fillSession(const gtp_view_t *view, const gtp_record_t *rec,
+                        gcd_session_t *session)
+{
+    memset(session, 0, sizeof(*session));
+    session->version = rec->hdr.version;
+    session->imsi = rec->imsi;
+    session->imsiDigits = rec->imsiDigits;
+    session->msisdn = rec->msisdn;
+    session->msisdnDigits = rec->msisdnDigits;
+    session->ratType = rec->ratType;
+    session->requesterTeid = rec->teidControlPlane;
+    session->requester = rec->gsnAddressSignal;
+    session->ueAddress = rec->endUserAddress;
+    if (gtpcViewGetApn(view, session->apn) != 1) {
+        session->apn[0] = 0;
+    }
+}
+
+int gcdSessionLearn(gcd_session_table_t *table, const gtp_view_t *view,
+                    uint64_t nowNs)
+{
+    gtp_record_t rec;
+    gcd_session_t session;
+    uint8_t version = view->hdr.version;
+    uint8_t type = view->hdr.msgType;
+    if (version == 0 || !gtpcRecordFromView(view, &rec)) {
+        return 0;
+    }
+    uint8_t accepted = version == 1 ? GTPV1_ACCEPTED : GTPV2_ACCEPTED;
+
+    if ((version == 1 && type == GTPV1_CREATE_PDP_REQ)
+        || (version == 2 && type == GTPV2_CREATE_SESS_REQ)) {
+        // the answer and later messages to the requester carry this TEID
+        if (rec.teidControlPlane == 0) {
+            return 0;
+        }
+        fillSession(view, &rec, &session);
+        store(table, rec.teidControlPlane, &session, nowNs);
+        return 1;
+    }
+    if ((version == 1 && type == GTPV1_CREATE_PDP_RSP)
+        || (version == 2 && type == GTPV2_CREATE_SESS_RSP)) {
+        if (!gcdSessionFind(table, rec.hdr.teid, &session, nowNs)) {
+            return -1;
+        }
+        if (rec.cause != accepted) {
+            forget(table, rec.hdr.teid, NULL);
+            return 1;
+        }
+        session.responderTeid = rec.teidControlPlane;
+        session.responder = rec.gsnAddressSignal;
+        if (rec.endUserAddress.family != GTP_ADDR_NONE) {
+            session.ueAddress = rec.endUserAddress;
+        }
+        store(table, rec.hdr.teid, &session, nowNs);
+        if (rec.teidControlPlane) {
+            store(table, rec.teidControlPlane, &session, nowNs);
+        }
+        return 1;
+    }
+    if ((version == 1 && type == GTPV1_DELETE_PDP_RSP)
+        || (version == 2 && type == GTPV2_DELETE_SESS_RSP)) {
+        if (rec.cause != accepted) {
+            return gcdSessionFind(table, rec.hdr.teid, NULL, nowNs) ? 0 : -1;
+        }
+        if (!forget(table, rec.hdr.teid, &session)) {
+            return -1;
+        }
+        // the other direction of the same session
+        uint32_t other = session.requesterTeid == rec.hdr.teid
+                             ? session.responderTeid
+                             : session.requesterTeid;
+        if (other) {
+            forget(table, other, NULL);
+        }
+        return 1;
+    }
+    if (rec.hdr.teid == 0) {
+        return 0;
+    }
+    return gcdSessionFind(table, rec.hdr.teid, NULL, nowNs) ? 0 : -1;
+}
+
+uint32_t gcdSessionExpire(gcd_session_table_t *table, uint64_t nowNs)
+{
+    uint32_t expired = 0;
+    if (table->idleNs == 0) {
+        return 0;
+    }
+    // the lru list is ordered by last use, so it is also the expiry queue
+    for (uint32_t i = 0; i < table->nshards; i++) {
+        shard_t *s = &table->shards[i];
+        pthread_mutex_lock(&s->lock);
+        while (s->tail != NIL
+               && s->entries[s->tail].lastSeen + table->idleNs <= nowNs) {
+            removeEntry(s, s->tail);
+            s->stats.expired++;
+            expired++;
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    return expired;
+}
+
+void gcdSessionTableStats(gcd_session_table_t *table,
+                          gcd_session_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < table->nshards; i++) {
+        shard_t *s = &table->shards[i];
+        pthread_mutex_lock(&s->lock);
+        stats->entries += s->stats.entries;
+        stats->learned += s->stats.learned;
+        stats->removed += s->stats.removed;
+        stats->evicted += s->stats.evicted;
+        stats->expired += s->stats.expired;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+gcd_session_table_t *gcdSessionTableCreate(const gcd_session_conf_t *conf)
+{
+    uint32_t nshards = conf->shards ? conf->shards : DEFAULT_SHARDS;
+    uint32_t max = conf->maxSessions ? conf->maxSessions : DEFAULT_MAX_SESSIONS;
+    if (nshards & (nshards - 1) || nshards > max) {
+        return NULL;
+    }
+    gcd_session_table_t *t = calloc(1, sizeof(*t));
+    if (!t) {
+        return NULL;
+    }
+    t->nshards = nshards;
+    t->shardShift = 64 - __builtin_ctz(nshards);
+    t->idleNs = conf->idleNs;
+    if (posix_memalign((void **)&t->shards, GCD_CACHE_LINE,
+                       sizeof(shard_t) * nshards)) {
+        free(t);
+        return NULL;
+    }
+    memset(t->shards, 0, sizeof(shard_t) * nshards);
+
+    uint32_t capacity = (max + nshards - 1) / nshards;
+    uint32_t nslots = 1;
+    while (nslots < capacity * 2) { // load factor at most 1/2
+        nslots <<= 1;
+    }
+    for (uint32_t i = 0; i < nshards; i++) {
+        shard_t *s = &t->shards[i];
+        pthread_mutex_init(&s->lock, NULL);
+        s->capacity = capacity;
+        s->mask = nslots - 1;
+        s->slots = calloc(nslots, sizeof(slot_t));
+        s->entries = malloc(sizeof(entry_t) * capacity);
+        if (!s->slots || !s->entries) {
+            t->nshards = i + 1;
+            gcdSessionTableDestroy(t);
+            return NULL;
+        }
+        for (uint32_t e = 0; e < capacity; e++) {
+            s->entries[e].next = e + 1 < capacity ? e + 1 : NIL;
+        }
+        s->freeList = 0;
+        s->head = s->tail = NIL;
+    }
+    return t;
+}
+
+void gcdSessionTableDestroy(gcd_session_table_t *table)
+{
+    if (!table) {
+        return;
+    }
+    for (uint32_t i = 0; i < table->nshards; i++) {
+        pthread_mutex_destroy(&table->shards[i].lock);
+        free(table->shards[i].slots);
+        free(table->shards[i].entries);
+    }
+    free(table->shards);
+    free(table);
+}
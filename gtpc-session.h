@@ -0,0 +1,96 @@
+#ifndef GTPC_SESSION_H_
+#define GTPC_SESSION_H_
+
+#include <stdint.h>
+
+#include "gtpc-record.h"
+#include "gtpc-view.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* subscriber context learned from a create pdp context/session exchange */
+typedef struct gcd_session_s {
+    uint64_t imsi;
+    uint64_t msisdn;
+    uint8_t imsiDigits;
+    uint8_t msisdnDigits;
+    uint8_t version;
+    uint8_t ratType;
+    uint32_t requesterTeid; // control plane TEID of sgsn/mme/sgw
+    uint32_t responderTeid; // control plane TEID of ggsn/sgw/pgw, 0 unknown
+    gtp_addr_t requester;   // control plane address of sgsn/mme/sgw
+    gtp_addr_t responder;
+    gtp_addr_t ueAddress;
+    char apn[MAX_APN_LEN + 1];
+} gcd_session_t;
+
+typedef struct gcd_session_conf_s {
+    uint32_t maxSessions; // memory cap, 0 for 1M TEIDs
+    uint32_t shards;      // lock stripes, power of two, 0 for 64
+    uint64_t idleNs;      // idle time before expiry, 0 never expires
+} gcd_session_conf_t;
+
+typedef struct gcd_session_stats_s {
+    uint64_t entries; // TEIDs currently known, two per answered session
+    uint64_t learned;
+    uint64_t removed; // by delete exchanges
+    uint64_t evicted; // least recently used, to stay within maxSessions
+    uint64_t expired; // idle
+} gcd_session_stats_t;
+
+typedef struct gcd_session_table_s gcd_session_table_t;
+
+/**
+ * @return
+ *   NULL on allocation failure, every entry is allocated up front
+ */
+GCD_PUBLIC gcd_session_table_t *
+gcdSessionTableCreate(const gcd_session_conf_t *conf);
+GCD_PUBLIC void gcdSessionTableDestroy(gcd_session_table_t *table);
+/**
+ * learn from create requests and answers, forget on accepted deletes.
+ * other messages refresh the idle time of their session
+ * @return
+ *   -1 message does not belong to a known session
+ *   0  nothing to learn
+ *   1  table updated
+ */
+GCD_PUBLIC int gcdSessionLearn(gcd_session_table_t *table,
+                               const gtp_view_t *view, uint64_t nowNs);
+/**
+ * find the session of a control plane TEID, eg. the header TEID of an
+ * update or delete message, and mark it as used
+ * @return
+ *   0 not found
+ *   1 copied into session
+ */
+GCD_PUBLIC int gcdSessionFind(gcd_session_table_t *table, uint32_t teid,
+                              gcd_session_t *session, uint64_t nowNs);
+/**
+ * gcdSessionFind() for n TEIDs, table slots are prefetched ahead of the
+ * lookups
+ * @return
+ *   number of sessions found, found[i] tells which
+ */
+GCD_PUBLIC uint32_t gcdSessionFindBatch(gcd_session_table_t *table,
+                                        const uint32_t *teids,
+                                        gcd_session_t *sessions, int *found,
+                                        uint32_t n, uint64_t nowNs);
+/**
+ * expire sessions idle for longer than idleNs, cheap enough to be called
+ * once per received batch
+ * @return
+ *   number of TEIDs expired
+ */
+GCD_PUBLIC uint32_t gcdSessionExpire(gcd_session_table_t *table,
+                                     uint64_t nowNs);
+GCD_PUBLIC void gcdSessionTableStats(gcd_session_table_t *table,
+                                     gcd_session_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,283 @@
+#include "gtpc-stats.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "gtpc-internal.h"
+
+#define GCD_CACHE_LINE 64
+
+typedef struct stats_block_s {
+    gcd_stats_t stats;
+    struct stats_block_s *next;
+    uint32_t inUse; // owned by a live thread
+} __attribute__((aligned(GCD_CACHE_LINE))) stats_block_t;
+
+int gcd_stats_enabled;
+
+static stats_block_t *stats_blocks;
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static __thread stats_block_t *stats_local;
+
+/* the block outlives its thread and is handed to the next new thread */
+static void releaseBlock(void *block)
+{
+    __atomic_store_n(&((stats_block_t *)block)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static void initStatsKey()
+{
+    pthread_key_create(&stats_key, releaseBlock);
+}
+
+static stats_block_t *acquireBlock()
+{
+    for (stats_block_t *b = __atomic_load_n(&stats_blocks, __ATOMIC_ACQUIRE);
+         b; b = b->next) {
+        uint32_t unused = 0;
+        if (__atomic_compare_exchange_n(&b->inUse, &unused, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return b;
+        }
+    }
+
+    stats_block_t *b = NULL;
+    if (posix_memalign((void **)&b, GCD_CACHE_LINE, sizeof(*b))) {
+        return NULL;
+    }
+    memset(b, 0, sizeof(*b));
+    b->inUse = 1;
+    b->next = __atomic_load_n(&stats_blocks, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&stats_blocks, &b->next, b, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return b;
+}
+
+gcd_stats_t *gcdStatsThread()
+{
+    if (!stats_local) {
+        pthread_once(&stats_once, initStatsKey);
+        stats_local = acquireBlock();
+        if (!stats_local) {
+            return NULL;
+        }
+        pthread_setspecific(stats_key, stats_local);
+    }
+    return &stats_local->stats;
+}
+
+void gcdStatsEnable(int enable)
+{
+    __atomic_store_n(&gcd_stats_enabled, !!enable, __ATOMIC_RELAXED);
+}
+
+static void addCounters(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+void gcdStatsRead(gcd_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (stats_block_t *b = __atomic_load_n(&stats_blocks, __ATOMIC_ACQUIRE);
+         b; b = b->next) {
+        addCounters((uint64_t *)stats, (const uint64_t *)&b->stats,
+                    sizeof(*stats) / sizeof(uint64_t));
+    }
+}
+
+void gcdStatsReset()
+{
+    for (stats_block_t *b = __atomic_load_n(&stats_blocks, __ATOMIC_ACQUIRE);
+         b; b = b->next) {
+        uint64_t *c = (uint64_t *)&b->stats;
+        for (size_t i = 0; i < sizeof(b->stats) / sizeof(uint64_t); i++) {
+            __atomic_store_n(&c[i], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static const char *error_names[GTP_ERR_MAX] = {
+    "none", "header", "version", "unknown_ie", "ie",
+};
+
+#define APPEND(...)                                                          \
+    do {                                                                     \
+        int n = snprintf(buf + (off < len ? off : len),                      \
+                         off < len ? len - off : 0, __VA_ARGS__);            \
+        off += n > 0 ? n : 0;                                                \
+    } while (0)
+
+int gcdStatsFormat(char *buf, uint32_t len)
+{
+    gcd_stats_t *stats = malloc(sizeof(*stats));
+    if (!stats) {
+        return -1;
+    }
+    gcdStatsRead(stats);
+
+    uint32_t off = 0;
+    if (len) {
+        buf[0] = 0;
+    }
+    APPEND("# TYPE gcd_messages_total counter\n");
+    for (int v = 0; v <= MAX_GTPC_VERSION; v++) {
+        APPEND("gcd_messages_total{version=\"%d\"} %llu\n", v,
+               (unsigned long long)stats->messages[v]);
+    }
+    APPEND("# TYPE gcd_message_types_total counter\n");
+    for (int v = 0; v <= MAX_GTPC_VERSION; v++) {
+        for (int t = 0; t < 256; t++) {
+            if (stats->msgTypes[v][t]) {
+                APPEND("gcd_message_types_total{version=\"%d\",type=\"%d\"} "
+                       "%llu\n",
+                       v, t, (unsigned long long)stats->msgTypes[v][t]);
+            }
+        }
+    }
+    APPEND("# TYPE gcd_ie_total counter\n");
+    for (int v = 0; v <= MAX_GTPC_VERSION; v++) {
+        for (int ie = 0; ie <= MAX_IE; ie++) {
+            if (stats->ieHits[v][ie]) {
+                APPEND("gcd_ie_total{version=\"%d\",ie=\"%d\"} %llu\n", v, ie,
+                       (unsigned long long)stats->ieHits[v][ie]);
+            }
+        }
+    }
+    APPEND("# TYPE gcd_ie_fallback_total counter\n");
+    for (int v = 0; v <= MAX_GTPC_VERSION; v++) {
+        for (int ie = 0; ie <= MAX_IE; ie++) {
+            if (stats->ieFallbacks[v][ie]) {
+                APPEND("gcd_ie_fallback_total{version=\"%d\",ie=\"%d\"} %llu\n",
+                       v, ie, (unsigned long long)stats->ieFallbacks[v][ie]);
+            }
+        }
+    }
+    APPEND("# TYPE gcd_decode_errors_total counter\n");
+    for (int e = 1; e < GTP_ERR_MAX; e++) {
+        APPEND("gcd_decode_errors_total{reason=\"%s\"} %llu\n", error_names[e],
+               (unsigned long long)stats->errors[e]);
+    }
+    free(stats);
+    return off;
+}
+
+#undef APPEND
+
+#define SERVE_TIMEOUT_S 1
+
+static int server_fd = -1;
+static pthread_t server_thread;
+
+/* one read of the counters, so the length always matches the body */
+static char *formatBody(int *len)
+{
+    int cap = 16384;
+    for (;;) {
+        char *body = malloc(cap);
+        if (!body) {
+            return NULL;
+        }
+        int n = gcdStatsFormat(body, cap);
+        if (n >= 0 && n < cap) {
+            *len = n;
+            return body;
+        }
+        free(body);
+        if (n < 0) {
+            return NULL;
+        }
+        cap = n + 4096; // room for counters that appear meanwhile
+    }
+}
+
+static void *serveStats(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    for (;;) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            break; // listening socket shut down
+        }
+        // an idle client must neither stall other scrapes nor the stop
+        struct timeval tv = {.tv_sec = SERVE_TIMEOUT_S};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        char req[1024];
+        if (read(client, req, sizeof(req)) <= 0) {
+            close(client); // failed, timed out or already hung up
+            continue;
+        }
+        int need;
+        char *body = formatBody(&need);
+        if (body) {
+            char hdr[128];
+            int n = snprintf(hdr, sizeof(hdr),
+                             "HTTP/1.0 200 OK\r\n"
+                             "Content-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: %d\r\n\r\n",
+                             need);
+            // a scraper hanging up mid-reply must not SIGPIPE the host
+            if (send(client, hdr, n, MSG_NOSIGNAL) == n) {
+                for (int sent = 0, w; sent < need; sent += w) {
+                    w = send(client, body + sent, need - sent, MSG_NOSIGNAL);
+                    if (w <= 0) {
+                        break;
+                    }
+                }
+            }
+            free(body);
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+int gcdStatsServe(uint16_t port)
+{
+    if (server_fd >= 0) {
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(fd, 16) < 0
+        || pthread_create(&server_thread, NULL, serveStats,
+                          (void *)(intptr_t)fd)) {
+        close(fd);
+        return -1;
+    }
+    server_fd = fd;
+    return 0;
+}
+
+void gcdStatsStopServer()
+{
+    if (server_fd < 0) {
+        return;
+    }
+    shutdown(server_fd, SHUT_RDWR);
+    pthread_join(server_thread, NULL);
+    close(server_fd);
+    server_fd = -1;
+}
@@ -0,0 +1,57 @@
+#ifndef GTPC_STATS_H_
+#define GTPC_STATS_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gcd_stats_s {
+    uint64_t messages[MAX_GTPC_VERSION + 1];
+    uint64_t msgTypes[MAX_GTPC_VERSION + 1][256];
+    /* IEs handled by a registered or built-in parser */
+    uint64_t ieHits[MAX_GTPC_VERSION + 1][MAX_IE + 1];
+    /* unknown IEs skipped by the fallback TLV decoder */
+    uint64_t ieFallbacks[MAX_GTPC_VERSION + 1][MAX_IE + 1];
+    uint64_t errors[GTP_ERR_MAX];
+} gcd_stats_t;
+
+/**
+ * turn statistics on or off, they are off by default. every decoding thread
+ * counts into its own cache line aligned block, so the decode path never
+ * shares a written cache line with another thread
+ */
+GCD_PUBLIC void gcdStatsEnable(int enable);
+/**
+ * sum the counters of every thread into stats without locking, counters
+ * of exited threads are kept
+ */
+GCD_PUBLIC void gcdStatsRead(gcd_stats_t *stats);
+/**
+ * zero the counters of every thread
+ */
+GCD_PUBLIC void gcdStatsReset();
+/**
+ * format the current counters in the prometheus text exposition format
+ * @return
+ *   length of the full text, like snprintf, buf is truncated if smaller
+ */
+GCD_PUBLIC int gcdStatsFormat(char *buf, uint32_t len);
+/**
+ * serve the prometheus text on http://127.0.0.1:port/ from a background
+ * thread, only one server can run at a time
+ * @return
+ *   -1 error
+ *   0  success
+ */
+GCD_PUBLIC int gcdStatsServe(uint16_t port);
+GCD_PUBLIC void gcdStatsStopServer();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
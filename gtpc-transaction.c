@@ -0,0 +1,462 @@
+#include "gtpc-transaction.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MAX_PENDING (1 << 20)
+#define DEFAULT_MAX_PEERS   1024
+#define DEFAULT_TIMEOUT_NS  10000000000ULL
+#define DEFAULT_TICK_NS     1000000ULL
+#define NIL                 UINT32_MAX
+
+/*
+ * requests answered by type + 1, ts 29.060 chapter 7.1 (also used for v0)
+ * and ts 29.274 chapter 6.1. commands, notifications without an ack and
+ * acks answering responses are left out
+ */
+// clang-format off
+#define GTPV1_REQUESTS(X)                                                    \
+    X(1)   X(4)   X(6)   X(16)  X(18)  X(20)  X(22)  X(27)  X(29)  X(32)     \
+    X(34)  X(36)  X(48)  X(50)  X(53)  X(56)  X(61)  X(96)  X(98)  X(100)    \
+    X(102) X(104) X(112) X(114) X(116) X(118) X(120) X(128) X(240)
+#define GTPV2_REQUESTS(X)                                                    \
+    X(1)   X(32)  X(34)  X(36)  X(38)  X(40)  X(95)  X(97)  X(99)  X(101)    \
+    X(103) X(128) X(130) X(133) X(135) X(137) X(139) X(149) X(153) X(155)    \
+    X(160) X(162) X(164) X(166) X(168) X(170) X(176) X(179) X(200) X(211)    \
+    X(231) X(233) X(235)
+// clang-format on
+
+/* filled at compile time, gcdMatcherIsRequest() needs no matcher */
+#define REQUEST(type) [type] = 1,
+static const uint8_t requests[MAX_GTPC_VERSION + 1][256] = {
+    {GTPV1_REQUESTS(REQUEST)},
+    {GTPV1_REQUESTS(REQUEST)},
+    {GTPV2_REQUESTS(REQUEST)},
+};
+#undef REQUEST
+
+/* 40 bytes without padding, so it is hashed and compared as a whole */
+typedef struct txn_key_s {
+    uint8_t requester[16];
+    uint8_t responder[16];
+    uint32_t sqn;
+    uint16_t requesterPort;
+    uint8_t version;
+    uint8_t type; // of the request
+} txn_key_t;
+
+typedef struct txn_s {
+    txn_key_t key;
+    uint64_t firstNs;
+    uint64_t deadline; // tick
+    uint32_t prev;     // wheel slot list, next also links the free list
+    uint32_t next;
+    uint32_t peer;
+} txn_t;
+
+typedef struct slot_s {
+    uint32_t hash;
+    uint32_t entry; // index + 1, 0 is empty
+} slot_t;
+
+struct gcd_matcher_s {
+    txn_t *txns;
+    uint32_t capacity;
+    uint32_t freeList;
+    slot_t *slots;
+    uint32_t slotMask;
+
+    uint32_t *wheel; // head of each tick's list
+    uint32_t wheelMask;
+    uint64_t tickNs;
+    uint64_t timeoutTicks;
+    uint64_t tick; // last tick advanced to
+    int started;
+
+    gcd_txn_peer_t **peers;
+    uint32_t *peerSlots; // index + 1, 0 is empty
+    uint32_t peerMask;
+    uint32_t maxPeers;
+    uint32_t npeers;
+
+    gcd_txn_stats_t *types[MAX_GTPC_VERSION + 1][256];
+    gcd_matcher_totals_t totals;
+};
+
+int gcdMatcherIsRequest(uint8_t version, uint8_t type)
+{
+    if (version > MAX_GTPC_VERSION) {
+        return 0;
+    }
+    return requests[version][type];
+}
+
+static uint32_t hashKey(const txn_key_t *key)
+{
+    uint64_t w[sizeof(txn_key_t) / 8];
+    uint64_t h = 0;
+    memcpy(w, key, sizeof(w));
+    for (uint32_t i = 0; i < sizeof(w) / 8; i++) {
+        h = (h ^ w[i]) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    return h >> 32;
+}
+
+static uint32_t lookup(gcd_matcher_t *m, const txn_key_t *key, uint32_t hash)
+{
+    for (uint32_t i = hash & m->slotMask;; i = (i + 1) & m->slotMask) {
+        slot_t *slot = &m->slots[i];
+        if (slot->entry == 0) {
+            return NIL;
+        }
+        if (slot->hash == hash
+            && !memcmp(&m->txns[slot->entry - 1].key, key, sizeof(*key))) {
+            return slot->entry - 1;
+        }
+    }
+}
+
+/* backward shift deletion, like the session table */
+static void removeSlot(gcd_matcher_t *m, uint32_t e, uint32_t hash)
+{
+    uint32_t i = hash & m->slotMask;
+    while (m->slots[i].entry != e + 1) {
+        i = (i + 1) & m->slotMask;
+    }
+    for (uint32_t j = (i + 1) & m->slotMask;; j = (j + 1) & m->slotMask) {
+        if (m->slots[j].entry == 0) {
+            break;
+        }
+        uint32_t home = m->slots[j].hash & m->slotMask;
+        if (((j - home) & m->slotMask) >= ((j - i) & m->slotMask)) {
+            m->slots[i] = m->slots[j];
+            i = j;
+        }
+    }
+    m->slots[i].entry = 0;
+}
+
+static void wheelLink(gcd_matcher_t *m, uint32_t e, uint64_t deadline)
+{
+    txn_t *t = &m->txns[e];
+    if (deadline <= m->tick) {
+        deadline = m->tick + 1; // capture time went backwards
+    }
+    uint32_t *head = &m->wheel[deadline & m->wheelMask];
+    t->deadline = deadline;
+    t->prev = NIL;
+    t->next = *head;
+    if (*head != NIL) {
+        m->txns[*head].prev = e;
+    }
+    *head = e;
+}
+
+static void wheelUnlink(gcd_matcher_t *m, uint32_t e)
+{
+    txn_t *t = &m->txns[e];
+    if (t->prev != NIL) {
+        m->txns[t->prev].next = t->next;
+    } else {
+        m->wheel[t->deadline & m->wheelMask] = t->next;
+    }
+    if (t->next != NIL) {
+        m->txns[t->next].prev = t->prev;
+    }
+}
+
+static void release(gcd_matcher_t *m, uint32_t e)
+{
+    wheelUnlink(m, e);
+    removeSlot(m, e, hashKey(&m->txns[e].key));
+    m->txns[e].next = m->freeList;
+    m->freeList = e;
+    m->totals.pending--;
+}
+
+static gcd_txn_stats_t *typeStats(gcd_matcher_t *m, uint8_t version,
+                                  uint8_t type)
+{
+    if (!m->types[version][type]) {
+        m->types[version][type] = calloc(1, sizeof(gcd_txn_stats_t));
+    }
+    return m->types[version][type];
+}
+
+static gcd_txn_stats_t *peerStats(gcd_matcher_t *m, uint32_t peer)
+{
+    return peer == NIL ? NULL : &m->peers[peer]->stats;
+}
+
+static uint32_t findPeer(gcd_matcher_t *m, const uint8_t *addr, uint8_t family)
+{
+    uint64_t w[2];
+    memcpy(w, addr, sizeof(w));
+    uint32_t i = ((w[0] ^ w[1]) * 0x9E3779B97F4A7C15ULL) >> 32;
+    for (;; i++) {
+        uint32_t *slot = &m->peerSlots[i & m->peerMask];
+        if (*slot == 0) {
+            if (m->npeers == m->maxPeers) {
+                m->totals.otherPeers++;
+                return NIL;
+            }
+            gcd_txn_peer_t *peer = calloc(1, sizeof(gcd_txn_peer_t));
+            if (!peer) {
+                return NIL;
+            }
+            peer->addr.family = family;
+            memcpy(peer->addr.addr, addr, sizeof(peer->addr.addr));
+            m->peers[m->npeers] = peer;
+            *slot = ++m->npeers;
+            return *slot - 1;
+        }
+        gcd_txn_peer_t *peer = m->peers[*slot - 1];
+        if (peer->addr.family == family
+            && !memcmp(peer->addr.addr, addr, sizeof(peer->addr.addr))) {
+            return *slot - 1;
+        }
+    }
+}
+
+static void timeout(gcd_matcher_t *m, uint32_t e)
+{
+    txn_t *t = &m->txns[e];
+    gcd_txn_stats_t *s = typeStats(m, t->key.version, t->key.type);
+    gcd_txn_stats_t *p = peerStats(m, t->peer);
+    if (s) {
+        s->timeouts++;
+    }
+    if (p) {
+        p->timeouts++;
+    }
+    m->totals.timeouts++;
+    release(m, e);
+}
+
+uint32_t gcdMatcherAdvance(gcd_matcher_t *m, uint64_t nowNs)
+{
+    uint64_t target = nowNs / m->tickNs;
+    uint32_t expired = 0;
+    if (!m->started) {
+        m->started = 1;
+        m->tick = target;
+        return 0;
+    }
+    if (target <= m->tick) {
+        return 0;
+    }
+    // a gap longer than a turn visits every slot once
+    uint64_t steps = target - m->tick;
+    if (steps > m->wheelMask + 1ULL) {
+        steps = m->wheelMask + 1ULL;
+    }
+    for (uint64_t tick = m->tick + 1; tick <= m->tick + steps; tick++) {
+        uint32_t e = m->wheel[tick & m->wheelMask];
+        while (e != NIL) {
+            uint32_t next = m->txns[e].next;
+            if (m->txns[e].deadline <= target) { // later turns stay
+                timeout(m, e);
+                expired++;
+            }
+            e = next;
+        }
+    }
+    m->tick = target;
+    return expired;
+}
+
+static void makeKey(const gtp_header_t *hdr, const gcd_payload_t *pkt,
+                    int response, txn_key_t *key)
+{
+    uint32_t alen = pkt->ipVersion == 6 ? 16 : 4;
+    memset(key, 0, sizeof(*key));
+    memcpy(key->requester, response ? pkt->dst : pkt->src, alen);
+    memcpy(key->responder, response ? pkt->src : pkt->dst, alen);
+    key->requesterPort = response ? pkt->dstPort : pkt->srcPort;
+    key->sqn = hdr->sqn;
+    key->version = hdr->version;
+    key->type = response ? hdr->msgType - 1 : hdr->msgType;
+}
+
+static int request(gcd_matcher_t *m, const gtp_header_t *hdr,
+                   const gcd_payload_t *pkt)
+{
+    txn_key_t key;
+    makeKey(hdr, pkt, 0, &key);
+    uint32_t hash = hashKey(&key);
+    uint32_t e = lookup(m, &key, hash);
+    uint64_t deadline = pkt->tsNs / m->tickNs + m->timeoutTicks;
+    if (e != NIL) {
+        // the latency still counts from the first transmission
+        gcd_txn_stats_t *s = typeStats(m, hdr->version, hdr->msgType);
+        gcd_txn_stats_t *p = peerStats(m, m->txns[e].peer);
+        if (s) {
+            s->retransmissions++;
+        }
+        if (p) {
+            p->retransmissions++;
+        }
+        m->totals.retransmissions++;
+        wheelUnlink(m, e);
+        wheelLink(m, e, deadline);
+        return GCD_TXN_RETRANSMISSION;
+    }
+    if (m->freeList == NIL) {
+        m->totals.overflows++;
+        return GCD_TXN_OVERFLOW;
+    }
+    e = m->freeList;
+    txn_t *t = &m->txns[e];
+    m->freeList = t->next;
+    t->key = key;
+    t->firstNs = pkt->tsNs;
+    t->peer = findPeer(m, key.responder, pkt->ipVersion);
+    uint32_t i = hash & m->slotMask;
+    while (m->slots[i].entry) {
+        i = (i + 1) & m->slotMask;
+    }
+    m->slots[i].hash = hash;
+    m->slots[i].entry = e + 1;
+    wheelLink(m, e, deadline);
+
+    gcd_txn_stats_t *s = typeStats(m, hdr->version, hdr->msgType);
+    gcd_txn_stats_t *p = peerStats(m, t->peer);
+    if (s) {
+        s->requests++;
+    }
+    if (p) {
+        p->requests++;
+    }
+    m->totals.requests++;
+    m->totals.pending++;
+    return GCD_TXN_REQUEST;
+}
+
+static int response(gcd_matcher_t *m, const gtp_header_t *hdr,
+                    const gcd_payload_t *pkt, uint64_t *latencyNs)
+{
+    txn_key_t key;
+    makeKey(hdr, pkt, 1, &key);
+    uint32_t e = lookup(m, &key, hashKey(&key));
+    gcd_txn_stats_t *s = typeStats(m, key.version, key.type);
+    if (e == NIL) {
+        if (s) {
+            s->unmatched++;
+        }
+        m->totals.unmatched++;
+        return GCD_TXN_UNMATCHED;
+    }
+    txn_t *t = &m->txns[e];
+    uint64_t latency = pkt->tsNs > t->firstNs ? pkt->tsNs - t->firstNs : 0;
+    gcd_txn_stats_t *p = peerStats(m, t->peer);
+    if (s) {
+        s->responses++;
+        gcdHistogramRecord(&s->latency, latency);
+    }
+    if (p) {
+        p->responses++;
+        gcdHistogramRecord(&p->latency, latency);
+    }
+    m->totals.responses++;
+    release(m, e);
+    if (latencyNs) {
+        *latencyNs = latency;
+    }
+    return GCD_TXN_RESPONSE;
+}
+
+int gcdMatcherFeed(gcd_matcher_t *m, const gtp_header_t *hdr,
+                   const gcd_payload_t *pkt, uint64_t *latencyNs)
+{
+    if (hdr->version > MAX_GTPC_VERSION) {
+        return GCD_TXN_IGNORED;
+    }
+    gcdMatcherAdvance(m, pkt->tsNs);
+    if (gcdMatcherIsRequest(hdr->version, hdr->msgType)) {
+        return request(m, hdr, pkt);
+    }
+    if (hdr->msgType > 0
+        && gcdMatcherIsRequest(hdr->version, hdr->msgType - 1)) {
+        return response(m, hdr, pkt, latencyNs);
+    }
+    return GCD_TXN_IGNORED;
+}
+
+const gcd_txn_stats_t *gcdMatcherTypeStats(const gcd_matcher_t *m,
+                                           uint8_t version, uint8_t type)
+{
+    return version > MAX_GTPC_VERSION ? NULL : m->types[version][type];
+}
+
+const gcd_txn_peer_t *gcdMatcherPeer(const gcd_matcher_t *m, uint32_t i)
+{
+    return i < m->npeers ? m->peers[i] : NULL;
+}
+
+void gcdMatcherTotals(const gcd_matcher_t *m, gcd_matcher_totals_t *totals)
+{
+    *totals = m->totals;
+}
+
+static uint32_t pow2(uint64_t n)
+{
+    uint32_t size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+gcd_matcher_t *gcdMatcherCreate(const gcd_matcher_conf_t *conf)
+{
+    gcd_matcher_t *m = calloc(1, sizeof(*m));
+    if (!m) {
+        return NULL;
+    }
+    uint64_t timeoutNs = conf->timeoutNs ? conf->timeoutNs : DEFAULT_TIMEOUT_NS;
+    m->capacity = conf->maxPending ? conf->maxPending : DEFAULT_MAX_PENDING;
+    m->maxPeers = conf->maxPeers ? conf->maxPeers : DEFAULT_MAX_PEERS;
+    m->tickNs = conf->tickNs ? conf->tickNs : DEFAULT_TICK_NS;
+    m->timeoutTicks = (timeoutNs + m->tickNs - 1) / m->tickNs;
+    // one turn covers the timeout, so most slots hold a single deadline
+    m->wheelMask = pow2(m->timeoutTicks + 1) - 1;
+    m->slotMask = pow2(m->capacity * 2ULL) - 1;
+    m->peerMask = pow2(m->maxPeers * 2ULL) - 1;
+
+    m->txns = malloc(sizeof(txn_t) * m->capacity);
+    m->slots = calloc(m->slotMask + 1ULL, sizeof(slot_t));
+    m->wheel = malloc(sizeof(uint32_t) * (m->wheelMask + 1ULL));
+    m->peers = calloc(m->maxPeers, sizeof(gcd_txn_peer_t *));
+    m->peerSlots = calloc(m->peerMask + 1ULL, sizeof(uint32_t));
+    if (!m->txns || !m->slots || !m->wheel || !m->peers || !m->peerSlots) {
+        gcdMatcherDestroy(m);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < m->capacity; i++) {
+        m->txns[i].next = i + 1 < m->capacity ? i + 1 : NIL;
+    }
+    memset(m->wheel, 0xff, sizeof(uint32_t) * (m->wheelMask + 1ULL));
+    return m;
+}
+
+void gcdMatcherDestroy(gcd_matcher_t *m)
+{
+    if (!m) {
+        return;
+    }
+    for (uint32_t v = 0; v <= MAX_GTPC_VERSION; v++) {
+        for (uint32_t t = 0; t < 256; t++) {
+            free(m->types[v][t]);
+        }
+    }
+    for (uint32_t i = 0; i < m->npeers; i++) {
+        free(m->peers[i]);
+    }
+    free(m->txns);
+    free(m->slots);
+    free(m->wheel);
+    free(m->peers);
+    free(m->peerSlots);
+    free(m);
+}
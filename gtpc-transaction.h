@@ -0,0 +1,109 @@
+#ifndef GTPC_TRANSACTION_H_
+#define GTPC_TRANSACTION_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+#include "gtpc-histogram.h"
+#include "gtpc-packet.h"
+#include "gtpc-record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* what gcdMatcherFeed() made of a message */
+#define GCD_TXN_IGNORED        0 // not a request or response, or no sqn
+#define GCD_TXN_REQUEST        1
+#define GCD_TXN_RETRANSMISSION 2 // request already outstanding
+#define GCD_TXN_RESPONSE       3 // matched, latency recorded
+#define GCD_TXN_UNMATCHED      4 // response to an unseen or expired request
+#define GCD_TXN_OVERFLOW       5 // request not tracked, maxPending reached
+
+typedef struct gcd_txn_stats_s {
+    uint64_t requests; // first transmissions
+    uint64_t retransmissions;
+    uint64_t responses;
+    uint64_t timeouts;
+    uint64_t unmatched;
+    gcd_histogram_t latency; // first transmission to response, ns
+} gcd_txn_stats_t;
+
+/* stats of the requests answered, or not, by one node */
+typedef struct gcd_txn_peer_s {
+    gtp_addr_t addr;
+    gcd_txn_stats_t stats;
+} gcd_txn_peer_t;
+
+typedef struct gcd_matcher_totals_s {
+    uint64_t pending;
+    uint64_t requests;
+    uint64_t retransmissions;
+    uint64_t responses;
+    uint64_t timeouts;
+    uint64_t unmatched;
+    uint64_t overflows;
+    uint64_t otherPeers; // requests to peers beyond maxPeers
+} gcd_matcher_totals_t;
+
+typedef struct gcd_matcher_conf_s {
+    uint32_t maxPending; // outstanding requests, 0 for 1M
+    uint32_t maxPeers;   // peers with their own stats, 0 for 1024
+    uint64_t timeoutNs;  // since the last transmission, 0 for 10s
+    uint64_t tickNs;     // timeout resolution, 0 for 1ms
+} gcd_matcher_conf_t;
+
+/*
+ * pairs requests and responses on (requester, responder, sqn, type) and
+ * keeps their latency per request type and per responding peer. outstanding
+ * requests sit in a hashed timing wheel, so tracking and timing them out
+ * costs O(1) per message. a matcher is not thread safe, feed it from one
+ * thread in capture order, eg. an ordered pipeline sink
+ */
+typedef struct gcd_matcher_s gcd_matcher_t;
+
+/**
+ * @return
+ *   NULL on allocation failure
+ */
+GCD_PUBLIC gcd_matcher_t *gcdMatcherCreate(const gcd_matcher_conf_t *conf);
+GCD_PUBLIC void gcdMatcherDestroy(gcd_matcher_t *m);
+/**
+ * match one message, pkt gives the addresses and the capture time. expired
+ * requests are timed out first
+ * @return
+ *   one of GCD_TXN_*, latencyNs is set for GCD_TXN_RESPONSE
+ */
+GCD_PUBLIC int gcdMatcherFeed(gcd_matcher_t *m, const gtp_header_t *hdr,
+                              const gcd_payload_t *pkt, uint64_t *latencyNs);
+/**
+ * time out the requests unanswered at nowNs, eg. when the capture is idle
+ * @return
+ *   number of timeouts
+ */
+GCD_PUBLIC uint32_t gcdMatcherAdvance(gcd_matcher_t *m, uint64_t nowNs);
+/**
+ * @return
+ *   1 if type is a request whose response is type + 1
+ */
+GCD_PUBLIC int gcdMatcherIsRequest(uint8_t version, uint8_t type);
+/**
+ * @return
+ *   stats of a request type, NULL if none was seen
+ */
+GCD_PUBLIC const gcd_txn_stats_t *
+gcdMatcherTypeStats(const gcd_matcher_t *m, uint8_t version, uint8_t type);
+/**
+ * @return
+ *   the i-th peer in order of appearance, NULL past the last one
+ */
+GCD_PUBLIC const gcd_txn_peer_t *gcdMatcherPeer(const gcd_matcher_t *m,
+                                                uint32_t i);
+GCD_PUBLIC void gcdMatcherTotals(const gcd_matcher_t *m,
+                                 gcd_matcher_totals_t *totals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
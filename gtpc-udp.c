@@ -0,0 +1,609 @@
+#define _GNU_SOURCE
+#include "gtpc-udp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GCD_CACHE_LINE 64
+
+#define DEFAULT_BATCH    64
+#define DEFAULT_BUFFERS  1024
+#define DEFAULT_BUF_SIZE 4096
+#define WAIT_MS          100 // how often a worker looks at the stop flag
+#define URING_SQ_ENTRIES 4
+#define URING_BGID       0
+
+/* io_uring by raw syscalls, the rings are mapped as the kernel lays them */
+typedef struct uring_s {
+    int fd;
+    uint8_t *sq;
+    size_t sqSize;
+    uint8_t *cq; // same mapping as sq with IORING_FEAT_SINGLE_MMAP
+    size_t cqSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    uint32_t *sqTail;
+    uint32_t sqMask;
+    uint32_t *sqArray;
+    uint32_t *cqHead;
+    uint32_t *cqTail;
+    uint32_t cqMask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *bufs;
+    size_t bufsSize;
+    uint16_t bufTail;
+    struct msghdr msg; // layout of every multishot completion
+} uring_t;
+
+typedef struct worker_s {
+    struct gcd_udp_s *udp;
+    int fd;
+    int cpu; // -1 not pinned
+    int ret;
+    pthread_t thread;
+    uint8_t *buffers; // buffers * bufSize
+    gcd_payload_t *payloads;
+    /* GCD_UDP_RECVMMSG */
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    struct sockaddr_storage *names;
+    /* GCD_UDP_URING */
+    uring_t ring;
+    uint16_t *used; // buffer ids of the payloads of a batch
+    gcd_udp_stats_t stats; // updated once per syscall
+} __attribute__((aligned(GCD_CACHE_LINE))) worker_t;
+
+struct gcd_udp_s {
+    worker_t *workers;
+    uint32_t nworkers;
+    uint32_t batch;
+    uint32_t buffers;
+    uint32_t bufSize;
+    int mode;
+    struct sockaddr_storage local;
+    socklen_t localLen;
+    uint8_t *localAddr; // dst of every payload
+    uint16_t port;
+    onGtpcBatch cb;
+    void *arg;
+    int stop;
+};
+
+static inline uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void setSource(gcd_payload_t *p, struct sockaddr *sa)
+{
+    if (sa->sa_family == AF_INET6) {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)sa;
+        p->srcPort = ntohs(in6->sin6_port);
+        if (IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)) {
+            p->ipVersion = 4;
+            p->src = in6->sin6_addr.s6_addr + 12;
+        } else {
+            p->ipVersion = 6;
+            p->src = in6->sin6_addr.s6_addr;
+        }
+    } else {
+        struct sockaddr_in *in = (struct sockaddr_in *)sa;
+        p->ipVersion = 4;
+        p->srcPort = ntohs(in->sin_port);
+        p->src = (uint8_t *)&in->sin_addr;
+    }
+}
+
+static void addStats(worker_t *w, uint64_t datagrams, uint64_t bytes,
+                     uint64_t truncated)
+{
+    __atomic_fetch_add(&w->stats.datagrams, datagrams, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->stats.bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->stats.truncated, truncated, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->stats.syscalls, 1, __ATOMIC_RELAXED);
+}
+
+/* one call receives up to a batch, blocking only for the first datagram */
+static int runRecvmmsg(worker_t *w, onGtpcBatch cb, void *arg)
+{
+    gcd_udp_t *u = w->udp;
+    while (!__atomic_load_n(&u->stop, __ATOMIC_RELAXED)) {
+        for (uint32_t i = 0; i < u->batch; i++) {
+            w->msgs[i].msg_hdr.msg_namelen = sizeof(w->names[i]);
+        }
+        int n = recvmmsg(w->fd, w->msgs, u->batch, MSG_WAITFORONE, NULL);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                return -1;
+            }
+            continue;
+        }
+        uint64_t ts = nowNs(), bytes = 0, truncated = 0;
+        for (int i = 0; i < n; i++) {
+            gcd_payload_t *p = &w->payloads[i];
+            p->data = w->iovs[i].iov_base;
+            p->len = w->msgs[i].msg_len;
+            p->tsNs = ts;
+            setSource(p, (struct sockaddr *)&w->names[i]);
+            p->dst = u->localAddr;
+            p->dstPort = u->port;
+            bytes += p->len;
+            truncated += !!(w->msgs[i].msg_hdr.msg_flags & MSG_TRUNC);
+        }
+        addStats(w, n, bytes, truncated);
+        if (cb(w->payloads, n, arg)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int initRecvmmsg(gcd_udp_t *u, worker_t *w)
+{
+    w->msgs = calloc(u->batch, sizeof(*w->msgs));
+    w->iovs = calloc(u->batch, sizeof(*w->iovs));
+    w->names = calloc(u->batch, sizeof(*w->names));
+    w->buffers = malloc((size_t)u->batch * u->bufSize);
+    if (!w->msgs || !w->iovs || !w->names || !w->buffers) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (uint32_t i = 0; i < u->batch; i++) {
+        w->iovs[i].iov_base = w->buffers + (size_t)i * u->bufSize;
+        w->iovs[i].iov_len = u->bufSize;
+        w->msgs[i].msg_hdr.msg_iov = &w->iovs[i];
+        w->msgs[i].msg_hdr.msg_iovlen = 1;
+        w->msgs[i].msg_hdr.msg_name = &w->names[i];
+    }
+    return 0;
+}
+
+static inline int uringEnter(int fd, uint32_t submit, uint32_t wait,
+                             uint32_t flags, void *arg, size_t argLen)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg,
+                        argLen);
+}
+
+static void *mapRing(int fd, size_t size, off_t offset)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, offset);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static void recycle(gcd_udp_t *u, worker_t *w, uint32_t n)
+{
+    uring_t *r = &w->ring;
+    uint32_t mask = u->buffers - 1;
+    for (uint32_t i = 0; i < n; i++) {
+        struct io_uring_buf *b = &r->bufs->bufs[r->bufTail++ & mask];
+        b->addr = (uintptr_t)(w->buffers + (size_t)w->used[i] * u->bufSize);
+        b->len = u->bufSize;
+        b->bid = w->used[i];
+    }
+    __atomic_store_n(&r->bufs->tail, r->bufTail, __ATOMIC_RELEASE);
+}
+
+/*
+ * the ring is created disabled and enabled by its worker, which makes the
+ * worker the single issuer and lets completions run when it waits
+ */
+static int initUring(gcd_udp_t *u, worker_t *w)
+{
+    uring_t *r = &w->ring;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED
+              | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = u->buffers * 2; // one completion per buffer at most
+    r->fd = (int)syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &p);
+    if (r->fd < 0 && errno == EINVAL) { // kernels before 6.1
+        p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED;
+        r->fd = (int)syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &p);
+    }
+    if (r->fd < 0) {
+        return -1;
+    }
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        errno = ENOSYS; // waiting with a timeout needs 5.11
+        return -1;
+    }
+
+    r->sqSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    r->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cqSize > r->sqSize) {
+            r->sqSize = r->cqSize;
+        }
+        r->sq = mapRing(r->fd, r->sqSize, IORING_OFF_SQ_RING);
+        r->cq = r->sq;
+    } else {
+        r->sq = mapRing(r->fd, r->sqSize, IORING_OFF_SQ_RING);
+        r->cq = mapRing(r->fd, r->cqSize, IORING_OFF_CQ_RING);
+    }
+    r->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mapRing(r->fd, r->sqesSize, IORING_OFF_SQES);
+    if (!r->sq || !r->cq || !r->sqes) {
+        return -1;
+    }
+    r->sqTail = (uint32_t *)(r->sq + p.sq_off.tail);
+    r->sqMask = *(uint32_t *)(r->sq + p.sq_off.ring_mask);
+    r->sqArray = (uint32_t *)(r->sq + p.sq_off.array);
+    r->cqHead = (uint32_t *)(r->cq + p.cq_off.head);
+    r->cqTail = (uint32_t *)(r->cq + p.cq_off.tail);
+    r->cqMask = *(uint32_t *)(r->cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(r->cq + p.cq_off.cqes);
+
+    /* provided buffers, handed back by the worker after the callback */
+    w->buffers = malloc((size_t)u->buffers * u->bufSize);
+    w->used = malloc(sizeof(*w->used) * u->batch);
+    r->bufsSize = u->buffers * sizeof(struct io_uring_buf);
+    r->bufs = mmap(NULL, r->bufsSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r->bufs == MAP_FAILED) {
+        r->bufs = NULL;
+    }
+    if (!w->buffers || !w->used || !r->bufs) {
+        errno = ENOMEM;
+        return -1;
+    }
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (uintptr_t)r->bufs,
+        .ring_entries = u->buffers,
+        .bgid = URING_BGID,
+    };
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < u->buffers; i++) {
+        struct io_uring_buf *b = &r->bufs->bufs[i];
+        b->addr = (uintptr_t)(w->buffers + (size_t)i * u->bufSize);
+        b->len = u->bufSize;
+        b->bid = i;
+    }
+    r->bufTail = u->buffers;
+    __atomic_store_n(&r->bufs->tail, r->bufTail, __ATOMIC_RELEASE);
+
+    r->msg.msg_namelen = sizeof(struct sockaddr_in6);
+    return 0;
+}
+
+static void freeUring(worker_t *w)
+{
+    uring_t *r = &w->ring;
+    if (r->fd >= 0) {
+        close(r->fd); // cancels the receive before its buffers go
+    }
+    if (r->cq && r->cq != r->sq) {
+        munmap(r->cq, r->cqSize);
+    }
+    if (r->sq) {
+        munmap(r->sq, r->sqSize);
+    }
+    if (r->sqes) {
+        munmap(r->sqes, r->sqesSize);
+    }
+    if (r->bufs) {
+        munmap(r->bufs, r->bufsSize);
+    }
+}
+
+/* queue the multishot recvmsg, it stays armed until buffers run out */
+static void armUring(worker_t *w)
+{
+    uring_t *r = &w->ring;
+    uint32_t tail = *r->sqTail;
+    uint32_t idx = tail & r->sqMask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = w->fd;
+    sqe->addr = (uintptr_t)&r->msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    r->sqArray[idx] = idx;
+    __atomic_store_n(r->sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * one receive request yields a completion per datagram, every datagram in
+ * a buffer of the ring as io_uring_recvmsg_out, the source address and the
+ * payload. one enter waits for completions and submits the rearm
+ */
+static int runUring(worker_t *w, onGtpcBatch cb, void *arg)
+{
+    gcd_udp_t *u = w->udp;
+    uring_t *r = &w->ring;
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_ENABLE_RINGS,
+                NULL, 0) < 0) {
+        return -1;
+    }
+    struct __kernel_timespec timeout = {.tv_nsec = WAIT_MS * 1000000L};
+    struct io_uring_getevents_arg wait = {.ts = (uintptr_t)&timeout};
+    size_t skip = sizeof(struct io_uring_recvmsg_out) + r->msg.msg_namelen;
+    uint32_t submit = 1, armed = 1;
+    armUring(w);
+
+    while (!__atomic_load_n(&u->stop, __ATOMIC_RELAXED)) {
+        int rc = uringEnter(r->fd, submit, 1,
+                            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                            &wait, sizeof(wait));
+        if (rc < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+            return -1;
+        }
+        if (rc >= 0) {
+            submit = 0;
+        }
+        uint64_t ts = nowNs(), bytes = 0, truncated = 0, datagrams = 0;
+        uint32_t head = *r->cqHead, n = 0;
+        uint32_t tail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+        int stop = 0;
+        for (; head != tail && !stop; head++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & r->cqMask];
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                armed = 0;
+            }
+            if (cqe->res < 0) {
+                if (cqe->res != -ENOBUFS) {
+                    errno = -cqe->res;
+                    return -1;
+                }
+                continue;
+            }
+            if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+                continue;
+            }
+            uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            uint8_t *buf = w->buffers + (size_t)bid * u->bufSize;
+            struct io_uring_recvmsg_out *out = (void *)buf;
+            gcd_payload_t *p = &w->payloads[n];
+            p->data = buf + skip;
+            p->len = out->payloadlen;
+            if (out->flags & MSG_TRUNC) {
+                p->len = u->bufSize - skip; // payloadlen is the full length
+                truncated++;
+            }
+            p->tsNs = ts;
+            setSource(p, (struct sockaddr *)(out + 1));
+            p->dst = u->localAddr;
+            p->dstPort = u->port;
+            bytes += p->len;
+            datagrams++;
+            w->used[n] = bid;
+            if (++n == u->batch) {
+                stop = cb(w->payloads, n, arg);
+                recycle(u, w, n);
+                n = 0;
+            }
+        }
+        __atomic_store_n(r->cqHead, head, __ATOMIC_RELEASE);
+        if (n) {
+            stop = cb(w->payloads, n, arg);
+            recycle(u, w, n);
+        }
+        addStats(w, datagrams, bytes, truncated);
+        if (stop) {
+            return 1;
+        }
+        if (!armed) { // ran out of buffers, they are back now
+            armUring(w);
+            submit = armed = 1;
+            __atomic_fetch_add(&w->stats.rearms, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return 0;
+}
+
+static void *workerMain(void *arg)
+{
+    worker_t *w = arg;
+    gcd_udp_t *u = w->udp;
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    int rc = u->mode == GCD_UDP_URING ? runUring(w, u->cb, u->arg)
+                                      : runRecvmmsg(w, u->cb, u->arg);
+    if (rc) { // an error or the callback, either stops every worker
+        w->ret = rc < 0 ? -1 : 0;
+        __atomic_store_n(&u->stop, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static uint32_t allowedCpus(int *cpus, uint32_t max)
+{
+    cpu_set_t set;
+    uint32_t n = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        return 0;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus[n++] = cpu;
+        }
+    }
+    return n;
+}
+
+static int parseLocal(gcd_udp_t *u, const char *addr)
+{
+    struct sockaddr_in *in = (struct sockaddr_in *)&u->local;
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&u->local;
+    if (!addr || inet_pton(AF_INET, addr, &in->sin_addr) == 1) {
+        in->sin_family = AF_INET;
+        in->sin_port = htons(u->port);
+        u->localLen = sizeof(*in);
+        u->localAddr = (uint8_t *)&in->sin_addr;
+        return 0;
+    }
+    if (inet_pton(AF_INET6, addr, &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(u->port);
+        u->localLen = sizeof(*in6);
+        u->localAddr = in6->sin6_addr.s6_addr;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static int openSocket(gcd_udp_t *u, worker_t *w, int rcvbuf)
+{
+    int one = 1;
+    struct timeval tv = {.tv_usec = WAIT_MS * 1000};
+    w->fd = socket(u->local.ss_family, SOCK_DGRAM, 0);
+    if (w->fd < 0
+        || setsockopt(w->fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0
+        || (rcvbuf && setsockopt(w->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                                 sizeof(rcvbuf)) < 0)
+        || setsockopt(w->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0
+        || bind(w->fd, (struct sockaddr *)&u->local, u->localLen) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void freeWorker(gcd_udp_t *u, worker_t *w)
+{
+    if (u->mode == GCD_UDP_URING) {
+        freeUring(w);
+    }
+    if (w->fd >= 0) {
+        close(w->fd);
+    }
+    free(w->buffers);
+    free(w->payloads);
+    free(w->msgs);
+    free(w->iovs);
+    free(w->names);
+    free(w->used);
+}
+
+gcd_udp_t *gcdUdpOpen(const gcd_udp_conf_t *conf)
+{
+    gcd_udp_t *u = calloc(1, sizeof(*u));
+    if (!u) {
+        return NULL;
+    }
+    u->nworkers = conf->workers ? conf->workers : 1;
+    u->batch = conf->batch ? conf->batch : DEFAULT_BATCH;
+    u->buffers = conf->buffers ? conf->buffers : DEFAULT_BUFFERS;
+    u->bufSize = conf->bufSize ? conf->bufSize : DEFAULT_BUF_SIZE;
+    u->port = conf->port ? conf->port : GTPC_PORT;
+    u->mode = conf->mode;
+    /* a uring buffer also holds the recvmsg header and source address */
+    uint32_t minSize = conf->mode == GCD_UDP_URING
+                           ? sizeof(struct io_uring_recvmsg_out)
+                                 + sizeof(struct sockaddr_in6) + 1
+                           : 1;
+    if ((u->buffers & (u->buffers - 1)) || u->buffers > 32768
+        || u->bufSize < minSize
+        || (conf->mode != GCD_UDP_RECVMMSG && conf->mode != GCD_UDP_URING)
+        || parseLocal(u, conf->addr) < 0) {
+        free(u);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (posix_memalign((void **)&u->workers, GCD_CACHE_LINE,
+                       sizeof(*u->workers) * u->nworkers)) {
+        free(u);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(u->workers, 0, sizeof(*u->workers) * u->nworkers);
+    int cpus[CPU_SETSIZE];
+    uint32_t ncpus = conf->pin ? allowedCpus(cpus, CPU_SETSIZE) : 0;
+    for (uint32_t i = 0; i < u->nworkers; i++) {
+        worker_t *w = &u->workers[i];
+        w->udp = u;
+        w->fd = -1;
+        w->ring.fd = -1;
+        w->cpu = ncpus ? cpus[i % ncpus] : -1;
+    }
+    for (uint32_t i = 0; i < u->nworkers; i++) {
+        worker_t *w = &u->workers[i];
+        w->payloads = malloc(sizeof(*w->payloads) * u->batch);
+        if (!w->payloads || openSocket(u, w, conf->rcvbuf) < 0
+            || (u->mode == GCD_UDP_URING ? initUring(u, w)
+                                         : initRecvmmsg(u, w)) < 0) {
+            int err = w->payloads ? errno : ENOMEM;
+            gcdUdpClose(u);
+            errno = err;
+            return NULL;
+        }
+    }
+    return u;
+}
+
+void gcdUdpClose(gcd_udp_t *udp)
+{
+    if (!udp) {
+        return;
+    }
+    for (uint32_t i = 0; i < udp->nworkers; i++) {
+        freeWorker(udp, &udp->workers[i]);
+    }
+    free(udp->workers);
+    free(udp);
+}
+
+int gcdUdpRun(gcd_udp_t *udp, onGtpcBatch cb, void *arg)
+{
+    udp->cb = cb;
+    udp->arg = arg;
+    uint32_t started = 0;
+    int ret = 0;
+    for (; started < udp->nworkers; started++) {
+        worker_t *w = &udp->workers[started];
+        if (pthread_create(&w->thread, NULL, workerMain, w)) {
+            ret = -1;
+            __atomic_store_n(&udp->stop, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(udp->workers[i].thread, NULL);
+        if (udp->workers[i].ret < 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+void gcdUdpStop(gcd_udp_t *udp)
+{
+    __atomic_store_n(&udp->stop, 1, __ATOMIC_RELAXED);
+}
+
+void gcdUdpStats(gcd_udp_t *udp, gcd_udp_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < udp->nworkers; i++) {
+        gcd_udp_stats_t *s = &udp->workers[i].stats;
+        stats->datagrams += __atomic_load_n(&s->datagrams, __ATOMIC_RELAXED);
+        stats->bytes += __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+        stats->truncated += __atomic_load_n(&s->truncated, __ATOMIC_RELAXED);
+        stats->syscalls += __atomic_load_n(&s->syscalls, __ATOMIC_RELAXED);
+        stats->rearms += __atomic_load_n(&s->rearms, __ATOMIC_RELAXED);
+    }
+}
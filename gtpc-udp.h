@@ -0,0 +1,72 @@
+#ifndef GTPC_UDP_H_
+#define GTPC_UDP_H_
+
+#include <stdint.h>
+
+#include "gtpc-pcap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* how the workers of a gcd_udp_t receive */
+enum {
+    GCD_UDP_RECVMMSG, // batches of recvmmsg()
+    GCD_UDP_URING,    // io_uring multishot recvmsg into a provided buffer ring
+};
+
+typedef struct gcd_udp_conf_s {
+    const char *addr; // local IPv4/IPv6 address, NULL for any IPv4
+    uint16_t port;    // 0 for 2123
+    uint32_t workers; // SO_REUSEPORT sockets, a thread each, 0 for 1
+    uint32_t batch;   // datagrams per callback, 0 for 64
+    uint32_t buffers; // receive buffers per worker, power of 2, 0 for 1024
+    uint32_t bufSize; // bytes per buffer, 0 for 4096
+    int mode;         // GCD_UDP_*
+    int pin;          // pin worker i to the i-th cpu of the affinity mask
+    int rcvbuf;       // SO_RCVBUF bytes, 0 leaves the system default
+} gcd_udp_conf_t;
+
+typedef struct gcd_udp_stats_s {
+    uint64_t datagrams;
+    uint64_t bytes;
+    uint64_t truncated; // longer than a buffer, cut to what fit
+    uint64_t syscalls;  // recvmmsg or io_uring_enter calls
+    uint64_t rearms;    // io_uring multishot receives restarted
+} gcd_udp_stats_t;
+
+/*
+ * gtpc endpoint side receiver: every worker owns a socket of a
+ * SO_REUSEPORT group on the port and hands what it receives to a callback
+ * without copying, the payloads point into the receive buffers, which are
+ * only reused after the callback returned. src is the sender, dst the
+ * local address given in the conf, tsNs the time of the receiving syscall
+ */
+typedef struct gcd_udp_s gcd_udp_t;
+
+/**
+ * bind the sockets and set up the receive buffers
+ * @return
+ *   NULL on error, errno is set
+ */
+GCD_PUBLIC gcd_udp_t *gcdUdpOpen(const gcd_udp_conf_t *conf);
+GCD_PUBLIC void gcdUdpClose(gcd_udp_t *udp);
+/**
+ * receive on every worker until gcdUdpStop() or cb asks to stop, cb is
+ * called concurrently from the workers
+ * @return
+ *   -1 on error
+ *   0  stopped
+ */
+GCD_PUBLIC int gcdUdpRun(gcd_udp_t *udp, onGtpcBatch cb, void *arg);
+/**
+ * make gcdUdpRun() return, safe to call from a signal handler
+ */
+GCD_PUBLIC void gcdUdpStop(gcd_udp_t *udp);
+GCD_PUBLIC void gcdUdpStats(gcd_udp_t *udp, gcd_udp_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
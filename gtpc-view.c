@@ -0,0 +1,191 @@
+#include "gtpc-view.h"
+
+#include <stddef.h>
+
+#include "gtpc-internal.h"
+#include "util.h"
+
+/* IE types used by the accessors, indexed by version */
+static const uint8_t ie_cause[] = {0x01, 0x01, 0x02};
+static const uint8_t ie_imsi[] = {0x02, 0x02, 0x01};
+static const uint8_t ie_msisdn[] = {0x86, 0x86, 0x4C};
+static const uint8_t ie_imei[] = {0, 0x9A, 0x4B};
+static const uint8_t ie_apn[] = {0x83, 0x83, 0x47};
+
+/* grouped IEs of ts 29.274 */
+static const uint8_t grouped_ies[] = {
+    93,  // Bearer Context
+    109, // PDN Connection
+    180, // Overload Control Information
+    181, // Load Control Information
+    191, // Remote UE Context
+    195, // SCEF PDN Connection
+};
+
+int gtpv2IsGroupedIE(uint8_t type)
+{
+    for (size_t i = 0; i < sizeof(grouped_ies); i++) {
+        if (grouped_ies[i] == type) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void gtpcIEWalkInit(gtp_ie_walk_t *walk, uint8_t *data, uint32_t offset,
+                    uint32_t end)
+{
+    gtpcIEIterInit(&walk->stack[0], data, offset, end);
+    walk->depth = 0;
+}
+
+int gtpcIEWalkNext(gtp_ie_walk_t *walk, gtp_ie_ref_t *ref, uint8_t *depth)
+{
+    for (;;) {
+        gtp_ie_iter_t *it = &walk->stack[walk->depth];
+        int ret = gtpcIEIterNext(it, ref);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret == 0) {
+            if (walk->depth == 0) {
+                return 0;
+            }
+            walk->depth--; // back to the parent
+            continue;
+        }
+        *depth = walk->depth;
+        if (gtpv2IsGroupedIE(ref->type)) {
+            if (walk->depth + 1 == MAX_IE_DEPTH) {
+                return -1;
+            }
+            walk->depth++;
+            gtpcIEIterChildren(&walk->stack[walk->depth], it->data, ref);
+        }
+        return 1;
+    }
+}
+
+int decodeGtpcView(uint8_t *data, uint32_t len, gtp_view_t *view)
+{
+    view->err.code = GTP_ERR_NONE;
+    int hdr_offset = decodeGtpcHeader(data, len, &view->hdr, &view->err);
+    if (hdr_offset == -1) {
+        return -1;
+    }
+
+    uint8_t version = view->hdr.version;
+    uint32_t idx = hdr_offset;
+    len = gtpcMessageLen(&view->hdr); // leave piggybacked messages out
+    view->data = data;
+    view->count = 0;
+    while (idx < len) {
+        int ielen = gtpcIELength(version, data + idx, len - idx);
+        if (ielen <= 0 || view->count == MAX_VIEW_IE) {
+            setGtpError(&view->err,
+                        ielen == 0 ? GTP_ERR_UNKNOWN_IE : GTP_ERR_IE,
+                        data[idx], idx);
+            return 0;
+        }
+        uint8_t hdrlen = version == 2 ? 4 : (data[idx] & 0x80 ? 3 : 1);
+
+        gtp_ie_ref_t *ref = &view->ies[view->count++];
+        ref->type = data[idx];
+        ref->instance = version == 2 ? data[idx + 3] & 0x0F : 0;
+        ref->offset = idx + hdrlen;
+        ref->length = ielen - hdrlen;
+        idx += ielen;
+    }
+    return 1;
+}
+
+const gtp_ie_ref_t *gtpcViewFind(const gtp_view_t *view, uint8_t type,
+                                 uint8_t instance)
+{
+    for (uint16_t i = 0; i < view->count; i++) {
+        if (view->ies[i].type == type && view->ies[i].instance == instance) {
+            return &view->ies[i];
+        }
+    }
+    return NULL;
+}
+
+static const gtp_ie_ref_t *findByVersion(const gtp_view_t *view,
+                                         const uint8_t types[3])
+{
+    if (view->hdr.version > 2 || types[view->hdr.version] == 0) {
+        return NULL;
+    }
+    return gtpcViewFind(view, types[view->hdr.version], 0);
+}
+
+int gtpcViewGetCause(const gtp_view_t *view, uint8_t *cause)
+{
+    const gtp_ie_ref_t *ref = findByVersion(view, ie_cause);
+    if (!ref) {
+        return 0;
+    }
+    if (ref->length < 1) {
+        return -1;
+    }
+    *cause = view->data[ref->offset];
+    return 1;
+}
+
+int gtpcViewGetImsi(const gtp_view_t *view, char imsi[MAX_IMSI_BCD_LEN + 1])
+{
+    const gtp_ie_ref_t *ref = findByVersion(view, ie_imsi);
+    if (!ref) {
+        return 0;
+    }
+    if (ref->length > MAX_IMSI_LEN) {
+        return -1;
+    }
+    BCD2ASCII(view->data + ref->offset, ref->length * 2, imsi,
+              MAX_IMSI_BCD_LEN + 1);
+    return 1;
+}
+
+int gtpcViewGetMsisdn(const gtp_view_t *view,
+                      char msisdn[MAX_MSISDN_BCD_LEN + 1])
+{
+    const gtp_ie_ref_t *ref = findByVersion(view, ie_msisdn);
+    if (!ref) {
+        return 0;
+    }
+    // gtp v0/v1 carry an extension/numbering plan octet before the digits
+    uint16_t skip = view->hdr.version == 2 ? 0 : 1;
+    if (ref->length <= skip || ref->length - skip > MAX_MSISDN_LEN) {
+        return -1;
+    }
+    BCD2ASCII(view->data + ref->offset + skip, (ref->length - skip) * 2, msisdn,
+              MAX_MSISDN_BCD_LEN + 1);
+    return 1;
+}
+
+int gtpcViewGetImei(const gtp_view_t *view, char imei[MAX_IMEISV_BCD_LEN + 1])
+{
+    const gtp_ie_ref_t *ref = findByVersion(view, ie_imei);
+    if (!ref) {
+        return 0;
+    }
+    if (ref->length > MAX_IMEISV_LEN) {
+        return -1;
+    }
+    BCD2ASCII(view->data + ref->offset, ref->length * 2, imei,
+              MAX_IMEISV_BCD_LEN + 1);
+    return 1;
+}
+
+int gtpcViewGetApn(const gtp_view_t *view, char apn[MAX_APN_LEN + 1])
+{
+    const gtp_ie_ref_t *ref = findByVersion(view, ie_apn);
+    if (!ref) {
+        return 0;
+    }
+    if (ref->length >= MAX_APN_LEN) {
+        return -1;
+    }
+    APN2ASCII(view->data + ref->offset, ref->length, apn, MAX_APN_LEN + 1);
+    return 1;
+}
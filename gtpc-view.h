@@ -0,0 +1,147 @@
+#ifndef GTPC_VIEW_H_
+#define GTPC_VIEW_H_
+
+#include <stdint.h>
+
+#include "gtpc-decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* position of one IE value inside the caller's buffer */
+typedef struct gtp_ie_ref_s {
+    uint8_t type;
+    uint8_t instance; // always 0 for gtp v0/v1
+    uint16_t offset;  // value offset from the start of the message
+    uint16_t length;  // value length
+} gtp_ie_ref_t;
+
+#define MAX_VIEW_IE 64
+typedef struct gtp_view_s {
+    gtp_header_t hdr;
+    gtp_error_t err; // set when decoding fails
+    uint8_t *data; // the caller's buffer, must outlive the view
+    uint16_t count;
+    gtp_ie_ref_t ies[MAX_VIEW_IE];
+} gtp_view_t;
+
+/*
+ * allocation free iterator over a gtpv2 IE chain, eg. the children of a
+ * grouped IE. values are yielded in place as offsets into data
+ */
+typedef struct gtp_ie_iter_s {
+    uint8_t *data;
+    uint32_t offset; // next IE
+    uint32_t end;
+} gtp_ie_iter_t;
+
+static inline void gtpcIEIterInit(gtp_ie_iter_t *it, uint8_t *data,
+                                  uint32_t offset, uint32_t end)
+{
+    it->data = data;
+    it->offset = offset;
+    it->end = end;
+}
+
+/* iterate the children of a grouped IE of the message data */
+static inline void gtpcIEIterChildren(gtp_ie_iter_t *it, uint8_t *data,
+                                      const gtp_ie_ref_t *grouped)
+{
+    gtpcIEIterInit(it, data, grouped->offset,
+                   grouped->offset + grouped->length);
+}
+
+/**
+ * @return
+ *   -1 an IE runs past the end of the chain
+ *   0  end of the chain
+ *   1  ref is set to the next IE
+ */
+static inline int gtpcIEIterNext(gtp_ie_iter_t *it, gtp_ie_ref_t *ref)
+{
+    if (it->offset >= it->end) {
+        return 0;
+    }
+    uint8_t *ie = it->data + it->offset;
+    if (it->end - it->offset < 4) {
+        return -1;
+    }
+    uint32_t length = (uint32_t)ie[1] << 8 | ie[2];
+    if (length > it->end - it->offset - 4) {
+        return -1;
+    }
+    ref->type = ie[0];
+    ref->instance = ie[3] & 0x0F;
+    ref->offset = it->offset + 4;
+    ref->length = length;
+    it->offset += 4 + length;
+    return 1;
+}
+
+/* depth first walk through grouped IEs, bounded by MAX_IE_DEPTH */
+#define MAX_IE_DEPTH 4
+typedef struct gtp_ie_walk_s {
+    gtp_ie_iter_t stack[MAX_IE_DEPTH];
+    uint8_t depth; // of the next IE, 0 for the top level
+} gtp_ie_walk_t;
+
+/**
+ * @return
+ *   1 if the gtpv2 IE type is a grouped IE
+ */
+GCD_PUBLIC int gtpv2IsGroupedIE(uint8_t type);
+/**
+ * walk the gtpv2 IEs between offset and end of data, eg. the body of a
+ * message, including the children of grouped IEs
+ */
+GCD_PUBLIC void gtpcIEWalkInit(gtp_ie_walk_t *walk, uint8_t *data,
+                               uint32_t offset, uint32_t end);
+/**
+ * yield the next IE, the children of a grouped IE follow it
+ * @return
+ *   -1 malformed chain or nested deeper than MAX_IE_DEPTH
+ *   0  end of the walk
+ *   1  ref is set, depth to its nesting level
+ */
+GCD_PUBLIC int gtpcIEWalkNext(gtp_ie_walk_t *walk, gtp_ie_ref_t *ref,
+                              uint8_t *depth);
+
+/**
+ * walk the IE chain once and index every IE without copying any value
+ * @return
+ *   -1 on decode header error or not supported version
+ *   0  on malformed IE chain or more than MAX_VIEW_IE IEs
+ *   1  on success
+ */
+GCD_PUBLIC int decodeGtpcView(uint8_t *data, uint32_t len, gtp_view_t *view);
+/**
+ * find the first IE with the given type and instance
+ * @return
+ *   NULL if not present
+ */
+GCD_PUBLIC const gtp_ie_ref_t *gtpcViewFind(const gtp_view_t *view,
+                                            uint8_t type, uint8_t instance);
+
+/**
+ * lazy accessors, decode a single IE on demand
+ * @return
+ *   -1 IE is malformed
+ *   0  IE not present
+ *   1  success
+ */
+GCD_PUBLIC int gtpcViewGetCause(const gtp_view_t *view, uint8_t *cause);
+GCD_PUBLIC int gtpcViewGetImsi(const gtp_view_t *view,
+                               char imsi[MAX_IMSI_BCD_LEN + 1]);
+GCD_PUBLIC int gtpcViewGetMsisdn(const gtp_view_t *view,
+                                 char msisdn[MAX_MSISDN_BCD_LEN + 1]);
+GCD_PUBLIC int gtpcViewGetImei(const gtp_view_t *view,
+                               char imei[MAX_IMEISV_BCD_LEN + 1]);
+GCD_PUBLIC int gtpcViewGetApn(const gtp_view_t *view,
+                              char apn[MAX_APN_LEN + 1]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+#include "gtpu-decoder.h"
+
+#include <arpa/inet.h>
+
+#include "gtpc-internal.h"
+
+static void parseExtension(uint8_t type, const uint8_t *content, uint32_t n,
+                           gtpu_t *gtpu)
+{
+    switch (type) {
+    case GTPU_EXT_PDU_SESSION:
+        if (n >= 2) {
+            gtpu->pduType = content[0] >> 4;
+            gtpu->qfi = content[1] & 0x3F;
+            gtpu->rqi = gtpu->pduType == 0 ? (content[1] >> 6) & 0x01 : 0;
+            gtpu->present |= GTPU_HAS_QFI;
+        }
+        break;
+    case GTPU_EXT_PDCP_PDU:
+        if (n >= 2) {
+            gtpu->pdcpSn = (uint32_t)content[0] << 8 | content[1];
+            gtpu->present |= GTPU_HAS_PDCP;
+        }
+        break;
+    case GTPU_EXT_LONG_PDCP_PDU:
+        if (n >= 3) {
+            gtpu->pdcpSn = (uint32_t)(content[0] & 0x03) << 16
+                         | (uint32_t)content[1] << 8 | content[2];
+            gtpu->present |= GTPU_HAS_PDCP;
+        }
+        break;
+    case GTPU_EXT_UDP_PORT:
+        if (n >= 2) {
+            gtpu->udpPort = (uint16_t)content[0] << 8 | content[1];
+            gtpu->present |= GTPU_HAS_UDP_PORT;
+        }
+        break;
+    case GTPU_EXT_SCI:
+        if (n >= 1) {
+            gtpu->sci = content[0];
+            gtpu->present |= GTPU_HAS_SCI;
+        }
+        break;
+    default:
+        gtpu->present |= GTPU_HAS_UNKNOWN_EXT;
+        break;
+    }
+}
+
+int gtpv1ExtensionChain(const uint8_t *data, uint32_t end, uint32_t offset,
+                        uint8_t next, gtpu_t *gtpu)
+{
+    while (next != GTPU_EXT_NONE) {
+        // length in 4 octet units, covering itself and the next type
+        uint32_t extLen = offset < end ? data[offset] * 4u : 0;
+        if (extLen == 0 || extLen > end - offset) {
+            return -1;
+        }
+        if (gtpu) {
+            parseExtension(next, data + offset + 1, extLen - 2, gtpu);
+            gtpu->extCount++;
+        }
+        next = data[offset + extLen - 1];
+        offset += extLen;
+    }
+    return offset;
+}
+
+/* sequence number, n-pdu number and extension headers */
+static int decodeOptional(const uint8_t *data, uint32_t end, gtpu_t *gtpu)
+{
+    if (end < 12) {
+        return -1;
+    }
+    if (data[0] & 0x02) {
+        gtpu->sqn = ntohs(*(uint16_t *)(data + 8));
+        gtpu->present |= GTPU_HAS_SQN;
+    }
+    if (data[0] & 0x01) {
+        gtpu->npdu = data[10];
+        gtpu->present |= GTPU_HAS_NPDU;
+    }
+    int offset = 12;
+    if (data[0] & 0x04) {
+        offset = gtpv1ExtensionChain(data, end, 12, data[11], gtpu);
+        if (offset < 0) {
+            return -1;
+        }
+    }
+    gtpu->payload = offset;
+    gtpu->payloadLen = end - offset;
+    return 1;
+}
+
+int decodeGtpu(const uint8_t *data, uint32_t len, gtpu_t *gtpu)
+{
+    // version 1 and protocol type gtp, gtp' is not user plane
+    if (len < 8 || (data[0] & 0xF0) != 0x30) {
+        return -1;
+    }
+    uint32_t end = 8 + ntohs(*(uint16_t *)(data + 2));
+    if (end > len) {
+        return -1;
+    }
+    gtpu->msgType = data[1];
+    gtpu->teid = ntohl(*(uint32_t *)(data + 4));
+    gtpu->present = 0;
+    gtpu->extCount = 0;
+    // nearly every G-PDU of a plain tunnel has no optional field
+    if (__builtin_expect((data[0] & 0x07) == 0, 1)) {
+        gtpu->payload = 8;
+        gtpu->payloadLen = end - 8;
+        return 1;
+    }
+    return decodeOptional(data, end, gtpu);
+}
+
+#define GTPU_BATCH_PREFETCH 8
+
+uint32_t decodeGtpuBatch(uint8_t **data, uint32_t *len, gtpu_t *gtpu,
+                         int *status, uint32_t n)
+{
+    uint32_t ok = 0;
+
+    for (uint32_t i = 0; i < n && i < GTPU_BATCH_PREFETCH; i++) {
+        GCD_PREFETCH_R(data[i]);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (i + GTPU_BATCH_PREFETCH < n) {
+            GCD_PREFETCH_R(data[i + GTPU_BATCH_PREFETCH]);
+        }
+        status[i] = decodeGtpu(data[i], len[i], &gtpu[i]);
+        ok += status[i] == 1;
+    }
+    return ok;
+}
@@ -0,0 +1,73 @@
+#ifndef GTPU_DECODER_H_
+#define GTPU_DECODER_H_
+
+#include <stdint.h>
+
+#include "macros.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GTPU_PORT  2152
+#define GTPU_G_PDU 255
+
+/* extension header types of ts 29.281 */
+#define GTPU_EXT_NONE             0x00
+#define GTPU_EXT_SCI              0x20 // service class indicator
+#define GTPU_EXT_UDP_PORT         0x40
+#define GTPU_EXT_RAN_CONTAINER    0x81
+#define GTPU_EXT_LONG_PDCP_PDU    0x82
+#define GTPU_EXT_XW_RAN_CONTAINER 0x83
+#define GTPU_EXT_NR_RAN_CONTAINER 0x84
+#define GTPU_EXT_PDU_SESSION      0x85 // ts 38.415
+#define GTPU_EXT_PDCP_PDU         0xC0
+
+/* fields of gtpu_t carried by the packet */
+#define GTPU_HAS_SQN         0x01
+#define GTPU_HAS_NPDU        0x02
+#define GTPU_HAS_QFI         0x04
+#define GTPU_HAS_PDCP        0x08
+#define GTPU_HAS_UDP_PORT    0x10
+#define GTPU_HAS_SCI         0x20
+#define GTPU_HAS_UNKNOWN_EXT 0x40 // an extension header was skipped
+
+typedef struct gtpu_s {
+    uint32_t teid;
+    uint8_t msgType; // GTPU_G_PDU for user data
+    uint8_t present; // GTPU_HAS_*
+    uint16_t sqn;
+    uint8_t npdu;
+    uint8_t extCount; // extension headers in the chain
+    uint8_t qfi;
+    uint8_t pduType; // pdu session container, 0 downlink, 1 uplink
+    uint8_t rqi;     // reflective qos indicator of downlink containers
+    uint8_t sci;
+    uint16_t udpPort;
+    uint32_t pdcpSn;
+    // the header length field allows 8 + 0xFFFF, past a uint16_t
+    uint32_t payload; // offset of the T-PDU from the start of the packet
+    uint32_t payloadLen;
+} gtpu_t;
+
+/**
+ * parse the gtp-u header and its whole extension header chain, data is
+ * the udp payload
+ * @return
+ *   -1 not a gtp-u packet, malformed or truncated
+ *   1  success
+ */
+GCD_PUBLIC int decodeGtpu(const uint8_t *data, uint32_t len, gtpu_t *gtpu);
+/**
+ * decode a batch of gtp-u packets, see decodeGtpcBatch
+ * @return
+ *   number of packets decoded successfully
+ */
+GCD_PUBLIC uint32_t decodeGtpuBatch(uint8_t **data, uint32_t *len,
+                                    gtpu_t *gtpu, int *status, uint32_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
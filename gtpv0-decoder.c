@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "gtpc-internal.h"
 #include "util.h"
 
 /* below macros are based on `3GPP TS 09.60 V7.10.0` */
@@ -57,6 +58,27 @@
 #define GTPV0_CHARGING_GATEWAY_ADDRESS       0xFB
 #define GTPV0_PRIVATE_EXTENSION              0xFF
 
+const uint8_t gtpv0TvLen[MAX_IE + 1] = {
+    [GTPV0_CAUSE] = GTPV0_CAUSE_LEN,
+    [GTPV0_IMSI] = GTPV0_IMSI_LEN,
+    [GTPV0_ROUTING_AREA_IDENTITY] = GTPV0_ROUTING_AREA_IDENTITY_LEN,
+    [GTPV0_TLLI] = GTPV0_TLLI_LEN,
+    [GTPV0_P_TMSI] = GTPV0_P_TMSI_LEN,
+    [GTPV0_QUALITY_OF_SERVICE] = GTPV0_QUALITY_OF_SERVICE_LEN,
+    [GTPV0_REORDERING_REQUIRED] = GTPV0_REORDERING_REQUIRED_LEN,
+    [GTPV0_AUTHENTICATION_TRIPLET] = GTPV0_AUTHENTICATION_TRIPLET_LEN,
+    [GTPV0_MAP_CAUSE] = GTPV0_MAP_CAUSE_LEN,
+    [GTPV0_P_TMSI_SIGNATURE] = GTPV0_P_TMSI_SIGNATURE_LEN,
+    [GTPV0_MS_VALIDATED] = GTPV0_MS_VALIDATED_LEN,
+    [GTPV0_RECOVERY] = GTPV0_RECOVERY_LEN,
+    [GTPV0_SELECTION_MODE] = GTPV0_SELECTION_MODE_LEN,
+    [GTPV0_FLOW_LABEL_DATA_I] = GTPV0_FLOW_LABEL_DATA_I_LEN,
+    [GTPV0_FLOW_LABEL_SIGNALLING] = GTPV0_FLOW_LABEL_SIGNALLING_LEN,
+    [GTPV0_FLOW_LABEL_DATA_II] = GTPV0_FLOW_LABEL_DATA_II_LEN,
+    [GTPV0_MS_NOT_REACHABLE_REASON] = GTPV0_MS_NOT_REACHABLE_REASON_LEN,
+    [GTPV0_CHARGING_ID] = GTPV0_CHARGING_ID_LEN,
+};
+
 /* TV parser */
 #define defFallbackTv(name)                                          \
   static int skip##name(uint8_t *data, uint32_t datalen, gtp_t *gtp) \
@@ -64,9 +86,6 @@
     (void)gtp; /* suppress warnings for unused parameter */          \
     if (data[0] != GTPV0_##name) {                                   \
       return 0;                                                      \
-    }                                                                \
-    if (datalen < GTPV0_##name##_LEN + 1) {                          \
-      return -1;                                                     \
     }                                                                \
                                                                      \
     return 1 + GTPV0_##name##_LEN;                                   \
@@ -85,15 +104,12 @@ defFallbackTv(MS_NOT_REACHABLE_REASON)
 
 #undef defFallbackTv
 
-static int decodeCause(uint8_t *data, uint32_t datalen,
-                       gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeCause(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV0_CAUSE) {
         return 0;
     }
-    if (datalen < GTPV0_CAUSE_LEN + 1) {
-        return -1;
-    }
 
     gtp->b0.cause = data[1];
     return 1 + GTPV0_CAUSE_LEN;
@@ -105,14 +121,12 @@ static int decodeCause(uint8_t *data, uint32_t datalen,
  *   -1 error
  *   0 not found IE
  */
-static int decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV0_IMSI) {
         return 0;
     }
-    if (datalen < GTPV0_IMSI_LEN + 1) {
-        return -1;
-    }
 
     BCD2ASCII(data + 1, GTPV0_IMSI_LEN * 2, gtp->b0.imsi, MAX_IMSI_BCD_LEN + 1);
     return 1 + GTPV0_IMSI_LEN;
@@ -124,9 +138,6 @@ static int decodeRoutingAreaIdentity(uint8_t *data, uint32_t datalen,
     if (data[0] != GTPV0_ROUTING_AREA_IDENTITY) {
         return 0;
     }
-    if (datalen < GTPV0_ROUTING_AREA_IDENTITY_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     offset += decodeMccMncLac(data + offset, gtp->b0.routingAreaIdentityMcc,
@@ -143,9 +154,6 @@ static int decodeQos(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV0_QUALITY_OF_SERVICE) {
         return 0;
     }
-    if (datalen < GTPV0_QUALITY_OF_SERVICE_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     memcpy(gtp->b0.qos, data + offset, GTPV0_QUALITY_OF_SERVICE_LEN);
@@ -158,9 +166,6 @@ static int decodeReorderingRequired(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV0_REORDERING_REQUIRED) {
         return 0;
     }
-    if (datalen < GTPV0_REORDERING_REQUIRED_LEN + 1) {
-        return -1;
-    }
 
     gtp->b0.reordering = data[1];
     return 1 + GTPV0_REORDERING_REQUIRED_LEN;
@@ -171,9 +176,6 @@ static int decodeRecovery(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV0_RECOVERY) {
         return 0;
     }
-    if (datalen < GTPV0_RECOVERY_LEN + 1) {
-        return -1;
-    }
 
     gtp->b0.recovery = data[1];
     return 1 + GTPV0_RECOVERY_LEN;
@@ -184,9 +186,6 @@ static int decodeSelectionMode(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV0_SELECTION_MODE) {
         return 0;
     }
-    if (datalen < GTPV0_SELECTION_MODE_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b0.selectionMode = data[offset] & 0x03;
@@ -200,9 +199,6 @@ static int decodeFlowLabelDataI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV0_FLOW_LABEL_DATA_I) {
         return 0;
     }
-    if (datalen < GTPV0_FLOW_LABEL_DATA_I_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b0.flowLabelData = ntohs(*(uint16_t *)(data + offset));
@@ -216,9 +212,6 @@ static int decodeFlowLabelSignalling(uint8_t *data, uint32_t datalen,
     if (data[0] != GTPV0_FLOW_LABEL_SIGNALLING) {
         return 0;
     }
-    if (datalen < GTPV0_FLOW_LABEL_SIGNALLING_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b0.flowLabelSignalling = ntohs(*(uint16_t *)(data + offset));
@@ -231,9 +224,6 @@ static int decodeChargingID(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV0_CHARGING_ID) {
         return 0;
     }
-    if (datalen < GTPV0_CHARGING_ID_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b0.chargingId = ntohl(*(uint32_t *)(data + offset));
@@ -249,9 +239,6 @@ static inline int decodeGtpV0Tlv(uint8_t *data, uint32_t datalen, uint8_t type,
     if (data[0] == type) {
         int length = ntohs(*(uint16_t *)&data[1]);
         offset = length + 3;
-        if (datalen < offset) {
-            return -1;
-        }
         *out = data + 3;
         *outlen = length;
     }
@@ -268,6 +255,11 @@ static int decodeEndUserAddress(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (ret <= 0) {
         return ret;
     }
+    if (p_value_len < 2) {
+        gcdLog(GCD_LOG_WARN, "weired End User Address Length[%d]",
+               p_value_len);
+        return ret;
+    }
 
     gtp->b0.pdpTypeOrg = p_value[0] & 0x0F;
     gtp->b0.pdpTypeNum = p_value[1];
@@ -280,7 +272,8 @@ static int decodeEndUserAddress(uint8_t *data, uint32_t datalen, gtp_t *gtp)
         inet_ntop(AF_INET, p_value + 2, gtp->b0.endUserAddress, 16);
         // we discard ipv6?
     } else {
-        printf("weired End User Address Length[%d]\n", p_value_len);
+        gcdLog(GCD_LOG_WARN, "weired End User Address Length[%d]",
+               p_value_len);
     }
     return ret;
 }
@@ -298,19 +291,7 @@ static int decodeAccessPointName(uint8_t *data, uint32_t datalen, gtp_t *gtp)
         return -1;
     }
 
-    int offset = 0;
-    // remove prefix character
-    while (p_value[offset] < 0x20 && offset < p_value_len) {
-        offset++;
-    }
-    strncpy(gtp->b0.apn, (char *)(p_value + offset), p_value_len - offset);
-    for (int i = 0; i < MAX_APN_LEN; i++) {
-        if (gtp->b0.apn[i] == 0) {
-            break;
-        }
-        // convert unprintable character
-        if (gtp->b0.apn[i] < 32) gtp->b0.apn[i] = '.';
-    }
+    APN2ASCII(p_value, p_value_len, gtp->b0.apn, MAX_APN_LEN + 1);
     return ret;
 }
 
@@ -345,10 +326,10 @@ static int decodeGSNAddress(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     }
     if (p_value_len == 4) {
         inet_ntop(AF_INET, p_value, ip, 16);
-    } else if (p_value_len == 6) {
+    } else if (p_value_len == 16) {
         inet_ntop(AF_INET6, p_value, ip, 40);
     } else {
-        printf("weired GSN Address length[%d]\n", p_value_len);
+        gcdLog(GCD_LOG_WARN, "weired GSN Address length[%d]", p_value_len);
     }
     return ret;
 }
@@ -370,34 +351,53 @@ static int decodeMSInternationalNumber(uint8_t *data, uint32_t datalen,
     return ret;
 }
 
+/* built-in IEs, shared by the parser table and the switch dispatcher */
+// clang-format off
+#define GTPV0_BUILTIN_IES(X)                                         \
+    X(GTPV0_CAUSE, decodeCause)                                      \
+    X(GTPV0_IMSI, decodeImsi)                                        \
+    X(GTPV0_ROUTING_AREA_IDENTITY, decodeRoutingAreaIdentity)        \
+    X(GTPV0_TLLI, skipTLLI)                                          \
+    X(GTPV0_P_TMSI, skipP_TMSI)                                      \
+    X(GTPV0_QUALITY_OF_SERVICE, decodeQos)                           \
+    X(GTPV0_REORDERING_REQUIRED, decodeReorderingRequired)           \
+    X(GTPV0_AUTHENTICATION_TRIPLET, skipAUTHENTICATION_TRIPLET)      \
+    X(GTPV0_MAP_CAUSE, skipMAP_CAUSE)                                \
+    X(GTPV0_P_TMSI_SIGNATURE, skipP_TMSI_SIGNATURE)                  \
+    X(GTPV0_MS_VALIDATED, skipMS_VALIDATED)                          \
+    X(GTPV0_RECOVERY, decodeRecovery)                                \
+    X(GTPV0_SELECTION_MODE, decodeSelectionMode)                     \
+    X(GTPV0_FLOW_LABEL_DATA_I, decodeFlowLabelDataI)                 \
+    X(GTPV0_FLOW_LABEL_SIGNALLING, decodeFlowLabelSignalling)        \
+    X(GTPV0_FLOW_LABEL_DATA_II, skipFLOW_LABEL_DATA_II)              \
+    X(GTPV0_MS_NOT_REACHABLE_REASON, skipMS_NOT_REACHABLE_REASON)    \
+    X(GTPV0_CHARGING_ID, decodeChargingID)                           \
+    X(GTPV0_END_USER_ADDRESS, decodeEndUserAddress)                  \
+    X(GTPV0_ACCESS_POINT_NAME, decodeAccessPointName)                \
+    X(GTPV0_PROTOCOL_CONFIGURATION_OPTIONS, decodeProtocolConfOpts)  \
+    X(GTPV0_GSN_ADDRESS, decodeGSNAddress)                           \
+    X(GTPV0_MS_INTERNATIONAL_NUMBER, decodeMSInternationalNumber)
+// clang-format on
+
 int registerGtpv0IEParsers(onIEParse ietable[MAX_IE])
 {
-    ietable[GTPV0_CAUSE] = decodeCause;
-    ietable[GTPV0_IMSI] = decodeImsi;
-    ietable[GTPV0_ROUTING_AREA_IDENTITY] = decodeRoutingAreaIdentity;
-    ietable[GTPV0_TLLI] = skipTLLI;
-    ietable[GTPV0_P_TMSI] = skipP_TMSI;
-    ietable[GTPV0_QUALITY_OF_SERVICE] = decodeQos;
-
-    ietable[GTPV0_REORDERING_REQUIRED] = decodeReorderingRequired;
-    ietable[GTPV0_AUTHENTICATION_TRIPLET] = skipAUTHENTICATION_TRIPLET;
-
-    ietable[GTPV0_MAP_CAUSE] = skipMAP_CAUSE;
-    ietable[GTPV0_P_TMSI_SIGNATURE] = skipP_TMSI_SIGNATURE;
-    ietable[GTPV0_MS_VALIDATED] = skipMS_VALIDATED;
-    ietable[GTPV0_RECOVERY] = decodeRecovery;
-    ietable[GTPV0_SELECTION_MODE] = decodeSelectionMode;
-    ietable[GTPV0_FLOW_LABEL_DATA_I] = decodeFlowLabelDataI;
-    ietable[GTPV0_FLOW_LABEL_SIGNALLING] = decodeFlowLabelSignalling;
-    ietable[GTPV0_FLOW_LABEL_DATA_II] = skipFLOW_LABEL_DATA_II;
-    ietable[GTPV0_MS_NOT_REACHABLE_REASON] = skipMS_NOT_REACHABLE_REASON;
-    ietable[GTPV0_CHARGING_ID] = decodeChargingID;
-    ietable[GTPV0_END_USER_ADDRESS] = decodeEndUserAddress;
-    ietable[GTPV0_ACCESS_POINT_NAME] = decodeAccessPointName;
-    ietable[GTPV0_PROTOCOL_CONFIGURATION_OPTIONS] = decodeProtocolConfOpts;
-    ietable[GTPV0_GSN_ADDRESS] = decodeGSNAddress;
-    ietable[GTPV0_MS_INTERNATIONAL_NUMBER] = decodeMSInternationalNumber;
+#define X(ie, parser) ietable[ie] = parser;
+    GTPV0_BUILTIN_IES(X)
+#undef X
 
     // todo: add validation for TV registration
     return 1;
 }
+
+int dispatchGtpv0IE(uint8_t *data, uint32_t len, gtp_t *gtp)
+{
+    switch (data[0]) {
+#define X(ie, parser) \
+    case ie:          \
+        return parser(data, len, gtp);
+        GTPV0_BUILTIN_IES(X)
+#undef X
+    default:
+        return GTPC_IE_NOT_BUILTIN;
+    }
+}
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "gtpc-internal.h"
 #include "util.h"
 
 /* below macro are based on ts 29.060 */
@@ -82,6 +83,36 @@
 #define GTPV1_BEARER_CONTROL_MODE             0xB8
 #define GTPV1_EVOLVED_PRIORITY_I              0xBF
 
+const uint8_t gtpv1TvLen[MAX_IE + 1] = {
+    [GTPV1_CAUSE] = GTPV1_CAUSE_LEN,
+    [GTPV1_IMSI] = GTPV1_IMSI_LEN,
+    [GTPV1_ROUTING_AREA_IDENTITY] = GTPV1_ROUTING_AREA_IDENTITY_LEN,
+    [GTPV1_TLLI] = GTPV1_TLLI_LEN,
+    [GTPV1_P_TMSI] = GTPV1_P_TMSI_LEN,
+    [GTPV1_REORDERING_REQUIRED] = GTPV1_REORDERING_REQUIRED_LEN,
+    [GTPV1_AUTHENTICATION_TRIPLET] = GTPV1_AUTHENTICATION_TRIPLET_LEN,
+    [GTPV1_MAP_CAUSE] = GTPV1_MAP_CAUSE_LEN,
+    [GTPV1_P_TMSI_SIGNATURE] = GTPV1_P_TMSI_SIGNATURE_LEN,
+    [GTPV1_MS_VALIDATED] = GTPV1_MS_VALIDATED_LEN,
+    [GTPV1_RECOVERY] = GTPV1_RECOVERY_LEN,
+    [GTPV1_SELECTION_MODE] = GTPV1_SELECTION_MODE_LEN,
+    [GTPV1_TEID_DATA_I] = GTPV1_TEID_DATA_I_LEN,
+    [GTPV1_TEID_CONTROL_PLANE] = GTPV1_TEID_CONTROL_PLANE_LEN,
+    [GTPV1_TEID_DATA_II] = GTPV1_TEID_DATA_II_LEN,
+    [GTPV1_TEARDOWN_IND] = GTPV1_TEARDOWN_IND_LEN,
+    [GTPV1_NSAPI] = GTPV1_NSAPI_LEN,
+    [GTPV1_RANAP_CAUSE] = GTPV1_RANAP_CAUSE_LEN,
+    [GTPV1_RAB_CONTEXT] = GTPV1_RAB_CONTEXT_LEN,
+    [GTPV1_RADIO_PRIORITY_SMS] = GTPV1_RADIO_PRIORITY_SMS_LEN,
+    [GTPV1_RADIO_PRIORITY] = GTPV1_RADIO_PRIORITY_LEN,
+    [GTPV1_PACKET_FLOW_ID] = GTPV1_PACKET_FLOW_ID_LEN,
+    [GTPV1_CHARGING_CHARACTERISTICS] = GTPV1_CHARGING_CHARACTERISTICS_LEN,
+    [GTPV1_TRACE_REFERENCE] = GTPV1_TRACE_REFERENCE_LEN,
+    [GTPV1_TRACE_TYPE] = GTPV1_TRACE_TYPE_LEN,
+    [GTPV1_MS_NOT_REACHABLE_REASON] = GTPV1_MS_NOT_REACHABLE_REASON_LEN,
+    [GTPV1_CHARGING_ID] = GTPV1_CHARGING_ID_LEN,
+};
+
 /* TV parser */
 #define defFallbackTv(name)                                          \
   static int skip##name(uint8_t *data, uint32_t datalen, gtp_t *gtp) \
@@ -89,9 +120,6 @@
     (void)gtp; /* suppress warnings for unused parameter */          \
     if (data[0] != GTPV1_##name) {                                   \
       return 0;                                                      \
-    }                                                                \
-    if (datalen < GTPV1_##name##_LEN + 1) {                          \
-      return -1;                                                     \
     }                                                                \
                                                                      \
     return 1 + GTPV1_##name##_LEN;                                   \
@@ -117,15 +145,12 @@ defFallbackTv(MS_NOT_REACHABLE_REASON)
 
 #undef defFallbackTv
 
-static int decodeCause(uint8_t *data, uint32_t datalen,
-                       gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeCause(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_CAUSE) {
         return 0;
     }
-    if (datalen < GTPV1_CAUSE_LEN + 1) {
-        return -1;
-    }
 
     gtp->b1.cause = data[1];
     return 1 + GTPV1_CAUSE_LEN;
@@ -137,14 +162,12 @@ static int decodeCause(uint8_t *data, uint32_t datalen,
  *   -1 error
  *   0 not found IE
  */
-static int decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_IMSI) {
         return 0;
     }
-    if (datalen < GTPV1_IMSI_LEN + 1) {
-        return -1;
-    }
 
     BCD2ASCII(data + 1, GTPV1_IMSI_LEN * 2, gtp->b1.imsi, MAX_IMSI_BCD_LEN + 1);
     return 1 + GTPV1_IMSI_LEN;
@@ -156,9 +179,6 @@ static int decodeRoutingAreaIdentity(uint8_t *data, uint32_t datalen,
     if (data[0] != GTPV1_ROUTING_AREA_IDENTITY) {
         return 0;
     }
-    if (datalen < GTPV1_ROUTING_AREA_IDENTITY_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     offset += decodeMccMncLac(data + offset, gtp->b1.routingAreaIdentityMcc,
@@ -175,22 +195,17 @@ static int decodeReorderingRequired(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV1_REORDERING_REQUIRED) {
         return 0;
     }
-    if (datalen < GTPV1_REORDERING_REQUIRED_LEN + 1) {
-        return -1;
-    }
 
     gtp->b1.reordering = data[1];
     return 1 + GTPV1_REORDERING_REQUIRED_LEN;
 }
 
-static int decodeRecovery(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeRecovery(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_RECOVERY) {
         return 0;
     }
-    if (datalen < GTPV1_RECOVERY_LEN + 1) {
-        return -1;
-    }
 
     gtp->b1.recovery = data[1];
     return 1 + GTPV1_RECOVERY_LEN;
@@ -201,9 +216,6 @@ static int decodeSelectionMode(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV1_SELECTION_MODE) {
         return 0;
     }
-    if (datalen < GTPV1_SELECTION_MODE_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.selectionMode = data[offset] & 0x03;
@@ -212,14 +224,12 @@ static int decodeSelectionMode(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     return offset;
 }
 
-static int decodeTEIDDataI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeTEIDDataI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_TEID_DATA_I) {
         return 0;
     }
-    if (datalen < GTPV1_TEID_DATA_I_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.teid = ntohl(*(uint32_t *)(data + offset));
@@ -227,14 +237,12 @@ static int decodeTEIDDataI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     return offset;
 }
 
-static int decodeTEIDControlPlane(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeTEIDControlPlane(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_TEID_CONTROL_PLANE) {
         return 0;
     }
-    if (datalen < GTPV1_TEID_CONTROL_PLANE_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.teidControlPlane = ntohl(*(uint32_t *)(data + offset));
@@ -247,9 +255,6 @@ static int decodeTeardownInd(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (data[0] != GTPV1_TEARDOWN_IND) {
         return 0;
     }
-    if (datalen < GTPV1_TEARDOWN_IND_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.teardownInd = data[offset] & 0x01;
@@ -257,14 +262,12 @@ static int decodeTeardownInd(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     return offset;
 }
 
-static int decodeNSAPI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeNSAPI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_NSAPI) {
         return 0;
     }
-    if (datalen < GTPV1_NSAPI_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.nsapi = data[offset] & 0x0F;
@@ -278,9 +281,6 @@ static int decodeChargingCharacteristics(uint8_t *data, uint32_t datalen,
     if (data[0] != GTPV1_CHARGING_CHARACTERISTICS) {
         return 0;
     }
-    if (datalen < GTPV1_CHARGING_CHARACTERISTICS_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.chargingFlags = data[offset] & 0x0F;
@@ -288,14 +288,12 @@ static int decodeChargingCharacteristics(uint8_t *data, uint32_t datalen,
     return offset;
 }
 
-static int decodeChargingID(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeChargingID(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     if (data[0] != GTPV1_CHARGING_ID) {
         return 0;
     }
-    if (datalen < GTPV1_CHARGING_ID_LEN + 1) {
-        return -1;
-    }
 
     int offset = 1;
     gtp->b1.chargingId = ntohl(*(uint32_t *)(data + offset));
@@ -312,9 +310,6 @@ static inline int decodeGtpV1Tlv(uint8_t *data, uint32_t datalen, uint8_t type,
     if (data[0] == type) {
         uint16_t length = ntohs(*(uint16_t *)&data[1]);
         offset = length + 3;
-        if (datalen < offset) {
-            return -1;
-        }
         *out = data + 3;
         *outlen = length;
     }
@@ -331,6 +326,11 @@ static int decodeEndUserAddress(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     if (ret <= 0) {
         return ret;
     }
+    if (p_value_len < 2) {
+        gcdLog(GCD_LOG_WARN, "weired End User Address Length[%d]",
+               p_value_len);
+        return ret;
+    }
 
     gtp->b1.pdpTypeOrg = p_value[0] & 0x0F;
     gtp->b1.pdpTypeNum = p_value[1];
@@ -343,7 +343,8 @@ static int decodeEndUserAddress(uint8_t *data, uint32_t datalen, gtp_t *gtp)
         inet_ntop(AF_INET, p_value + 2, gtp->b1.endUserAddress, 16);
         // we discard ipv6?
     } else {
-        printf("weired End User Address Length[%d]\n", p_value_len);
+        gcdLog(GCD_LOG_WARN, "weired End User Address Length[%d]",
+               p_value_len);
     }
     return ret;
 }
@@ -361,19 +362,7 @@ static int decodeAccessPointName(uint8_t *data, uint32_t datalen, gtp_t *gtp)
         return -1;
     }
 
-    int offset = 0;
-    // remove prefix character
-    while (p_value[offset] < 0x20 && offset < p_value_len) {
-        offset++;
-    }
-    strncpy(gtp->b1.apn, (char *)(p_value + offset), p_value_len - offset);
-    for (int i = 0; i < MAX_APN_LEN; i++) {
-        if (gtp->b1.apn[i] == 0) {
-            break;
-        }
-        // convert unprintable character
-        if (gtp->b1.apn[i] < 32) gtp->b1.apn[i] = '.';
-    }
+    APN2ASCII(p_value, p_value_len, gtp->b1.apn, MAX_APN_LEN + 1);
     return ret;
 }
 
@@ -408,10 +397,10 @@ static int decodeGSNAddress(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     }
     if (p_value_len == 4) {
         inet_ntop(AF_INET, p_value, ip, 16);
-    } else if (p_value_len == 6) {
+    } else if (p_value_len == 16) {
         inet_ntop(AF_INET6, p_value, ip, 40);
     } else {
-        printf("weired GSN Address length[%d]\n", p_value_len);
+        gcdLog(GCD_LOG_WARN, "weired GSN Address length[%d]", p_value_len);
     }
     return ret;
 }
@@ -423,7 +412,7 @@ static int decodeMSInternationalNumber(uint8_t *data, uint32_t datalen,
     int p_value_len = 0;
     int ret = decodeGtpV1Tlv(data, datalen, GTPV1_MS_INTERNATIONAL_NUMBER,
                              &p_value, &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 1) {
         return ret;
     }
 
@@ -439,7 +428,7 @@ static int decodeqos(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     int p_value_len = 0;
     int ret = decodeGtpV1Tlv(data, datalen, GTPV1_QUALITY_OF_SERVICE, &p_value,
                              &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 1) {
         return ret;
     }
 
@@ -454,7 +443,7 @@ static int decodeCommonFlags(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     int p_value_len = 0;
     int ret = decodeGtpV1Tlv(data, datalen, GTPV1_COMMON_FLAGS, &p_value,
                              &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 1) {
         return ret;
     }
 
@@ -468,7 +457,7 @@ static int decodeRATType(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     int p_value_len = 0;
     int ret =
         decodeGtpV1Tlv(data, datalen, GTPV1_RAT_TYPE, &p_value, &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 1) {
         return ret;
     }
 
@@ -486,7 +475,7 @@ static int decodeUserLocationInformation(uint8_t *data, uint32_t datalen,
     int p_value_len = 0;
     int ret = decodeGtpV1Tlv(data, datalen, GTPV1_USER_LOCATION_INFORMATION,
                              &p_value, &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 1) {
         return ret;
     }
 
@@ -494,6 +483,9 @@ static int decodeUserLocationInformation(uint8_t *data, uint32_t datalen,
     int offset = 1;
     switch (geographicLocationType) {
     case 0: {
+        if (p_value_len < 8) {
+            break;
+        }
         offset += decodeMccMncLac(
             p_value + offset, gtp->b1.userLocationInforMcc,
             gtp->b1.userLocationInforMnc, &gtp->b1.userLocationInforLac);
@@ -515,7 +507,7 @@ static int decodeMSTimeZone(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     int p_value_len = 0;
     int ret = decodeGtpV1Tlv(data, datalen, GTPV1_MS_TIME_ZONE, &p_value,
                              &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 2) {
         return ret;
     }
 
@@ -533,7 +525,7 @@ static int decodeIMEI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
         return ret;
     }
 
-    BCD2ASCII(p_value, p_value_len * 2, gtp->b1.imei, MAX_IMEISV_BCD_LEN);
+    BCD2ASCII(p_value, p_value_len * 2, gtp->b1.imei, MAX_IMEISV_BCD_LEN + 1);
     return ret;
 }
 
@@ -559,7 +551,7 @@ static int decodeBearerControlMode(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     int p_value_len = 0;
     int ret = decodeGtpV1Tlv(data, datalen, GTPV1_BEARER_CONTROL_MODE, &p_value,
                              &p_value_len);
-    if (ret <= 0) {
+    if (ret <= 0 || p_value_len < 1) {
         return ret;
     }
 
@@ -581,51 +573,71 @@ static int decodeEPriorityI(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     return ret;
 }
 
+/* built-in IEs, shared by the parser table and the switch dispatcher */
+// clang-format off
+#define GTPV1_BUILTIN_IES(X)                                                     \
+    X(GTPV1_CAUSE, decodeCause)                                                  \
+    X(GTPV1_IMSI, decodeImsi)                                                    \
+    X(GTPV1_ROUTING_AREA_IDENTITY, decodeRoutingAreaIdentity)                    \
+    X(GTPV1_TLLI, skipTLLI)                                                      \
+    X(GTPV1_P_TMSI, skipP_TMSI)                                                  \
+    X(GTPV1_REORDERING_REQUIRED, decodeReorderingRequired)                       \
+    X(GTPV1_AUTHENTICATION_TRIPLET, skipAUTHENTICATION_TRIPLET)                  \
+    X(GTPV1_MAP_CAUSE, skipMAP_CAUSE)                                            \
+    X(GTPV1_P_TMSI_SIGNATURE, skipP_TMSI_SIGNATURE)                              \
+    X(GTPV1_MS_VALIDATED, skipMS_VALIDATED)                                      \
+    X(GTPV1_RECOVERY, decodeRecovery)                                            \
+    X(GTPV1_SELECTION_MODE, decodeSelectionMode)                                 \
+    X(GTPV1_TEID_DATA_I, decodeTEIDDataI)                                        \
+    X(GTPV1_TEID_CONTROL_PLANE, decodeTEIDControlPlane)                          \
+    X(GTPV1_TEID_DATA_II, skipTEID_DATA_II)                                      \
+    X(GTPV1_TEARDOWN_IND, decodeTeardownInd)                                     \
+    X(GTPV1_NSAPI, decodeNSAPI)                                                  \
+    X(GTPV1_RANAP_CAUSE, skipRANAP_CAUSE)                                        \
+    X(GTPV1_RAB_CONTEXT, skipRAB_CONTEXT)                                        \
+    X(GTPV1_RADIO_PRIORITY_SMS, skipRADIO_PRIORITY_SMS)                          \
+    X(GTPV1_RADIO_PRIORITY, skipRADIO_PRIORITY)                                  \
+    X(GTPV1_PACKET_FLOW_ID, skipPACKET_FLOW_ID)                                  \
+    X(GTPV1_CHARGING_CHARACTERISTICS, decodeChargingCharacteristics)             \
+    X(GTPV1_TRACE_REFERENCE, skipTRACE_REFERENCE)                                \
+    X(GTPV1_TRACE_TYPE, skipTRACE_TYPE)                                          \
+    X(GTPV1_MS_NOT_REACHABLE_REASON, skipMS_NOT_REACHABLE_REASON)                \
+    X(GTPV1_CHARGING_ID, decodeChargingID)                                       \
+    X(GTPV1_END_USER_ADDRESS, decodeEndUserAddress)                              \
+    X(GTPV1_ACCESS_POINT_NAME, decodeAccessPointName)                            \
+    X(GTPV1_PROTOCOL_CONFIGURATION_OPTIONS, decodeProtocolConfOpts)              \
+    X(GTPV1_MS_INTERNATIONAL_NUMBER, decodeMSInternationalNumber)                \
+    X(GTPV1_IMEI, decodeIMEI)                                                    \
+    X(GTPV1_GSN_ADDRESS, decodeGSNAddress)                                       \
+    X(GTPV1_QUALITY_OF_SERVICE, decodeqos)                                       \
+    X(GTPV1_COMMON_FLAGS, decodeCommonFlags)                                     \
+    X(GTPV1_RAT_TYPE, decodeRATType)                                             \
+    X(GTPV1_USER_LOCATION_INFORMATION, decodeUserLocationInformation)            \
+    X(GTPV1_MS_TIME_ZONE, decodeMSTimeZone)                                      \
+    X(GTPV1_EVOLVED_PRIORITY_I, decodeEPriorityI)                                \
+    X(GTPV1_BEARER_CONTROL_MODE, decodeBearerControlMode)                        \
+    X(GTPV1_MS_INFO_CHANGE_REPORTING_ACTION, decodeMSInfoChangeReportingAction)
+// clang-format on
+
 int registerGtpv1IEParsers(onIEParse ietable[MAX_IE])
 {
-    ietable[GTPV1_CAUSE] = decodeCause;
-    ietable[GTPV1_IMSI] = decodeImsi;
-    ietable[GTPV1_ROUTING_AREA_IDENTITY] = decodeRoutingAreaIdentity;
-    ietable[GTPV1_TLLI] = skipTLLI;
-    ietable[GTPV1_P_TMSI] = skipP_TMSI;
-    ietable[GTPV1_REORDERING_REQUIRED] = decodeReorderingRequired;
-    ietable[GTPV1_AUTHENTICATION_TRIPLET] = skipAUTHENTICATION_TRIPLET;
-    ietable[GTPV1_MAP_CAUSE] = skipMAP_CAUSE;
-    ietable[GTPV1_P_TMSI_SIGNATURE] = skipP_TMSI_SIGNATURE;
-    ietable[GTPV1_MS_VALIDATED] = skipMS_VALIDATED;
-    ietable[GTPV1_RECOVERY] = decodeRecovery;
-    ietable[GTPV1_SELECTION_MODE] = decodeSelectionMode;
-    ietable[GTPV1_TEID_DATA_I] = decodeTEIDDataI;
-    ietable[GTPV1_TEID_CONTROL_PLANE] = decodeTEIDControlPlane;
-    ietable[GTPV1_TEID_DATA_II] = skipTEID_DATA_II;
-    ietable[GTPV1_TEARDOWN_IND] = decodeTeardownInd;
-    ietable[GTPV1_NSAPI] = decodeNSAPI;
-    ietable[GTPV1_RANAP_CAUSE] = skipRANAP_CAUSE;
-    ietable[GTPV1_RAB_CONTEXT] = skipRAB_CONTEXT;
-    ietable[GTPV1_RADIO_PRIORITY_SMS] = skipRADIO_PRIORITY_SMS;
-    ietable[GTPV1_RADIO_PRIORITY] = skipRADIO_PRIORITY;
-    ietable[GTPV1_PACKET_FLOW_ID] = skipPACKET_FLOW_ID;
-    ietable[GTPV1_CHARGING_CHARACTERISTICS] = decodeChargingCharacteristics;
-    ietable[GTPV1_TRACE_REFERENCE] = skipTRACE_REFERENCE;
-    ietable[GTPV1_TRACE_TYPE] = skipTRACE_TYPE;
-    ietable[GTPV1_MS_NOT_REACHABLE_REASON] = skipMS_NOT_REACHABLE_REASON;
-    ietable[GTPV1_CHARGING_ID] = decodeChargingID;
-    ietable[GTPV1_END_USER_ADDRESS] = decodeEndUserAddress;
-    ietable[GTPV1_ACCESS_POINT_NAME] = decodeAccessPointName;
-    ietable[GTPV1_PROTOCOL_CONFIGURATION_OPTIONS] = decodeProtocolConfOpts;
-    ietable[GTPV1_MS_INTERNATIONAL_NUMBER] = decodeMSInternationalNumber;
-    ietable[GTPV1_IMEI] = decodeIMEI;
-    ietable[GTPV1_GSN_ADDRESS] = decodeGSNAddress;
-    ietable[GTPV1_QUALITY_OF_SERVICE] = decodeqos;
-    ietable[GTPV1_COMMON_FLAGS] = decodeCommonFlags;
-    ietable[GTPV1_RAT_TYPE] = decodeRATType;
-    ietable[GTPV1_USER_LOCATION_INFORMATION] = decodeUserLocationInformation;
-    ietable[GTPV1_MS_TIME_ZONE] = decodeMSTimeZone;
-    ietable[GTPV1_EVOLVED_PRIORITY_I] = decodeEPriorityI;
-    ietable[GTPV1_BEARER_CONTROL_MODE] = decodeBearerControlMode;
-    ietable[GTPV1_MS_INFO_CHANGE_REPORTING_ACTION] =
-        decodeMSInfoChangeReportingAction;
+#define X(ie, parser) ietable[ie] = parser;
+    GTPV1_BUILTIN_IES(X)
+#undef X
 
     // todo: add validation for TV registration
     return 1;
 }
+
+int dispatchGtpv1IE(uint8_t *data, uint32_t len, gtp_t *gtp)
+{
+    switch (data[0]) {
+#define X(ie, parser) \
+    case ie:          \
+        return parser(data, len, gtp);
+        GTPV1_BUILTIN_IES(X)
+#undef X
+    default:
+        return GTPC_IE_NOT_BUILTIN;
+    }
+}
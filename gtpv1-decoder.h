@@ -4,5 +4,16 @@
 #include "gtpc-decoder.h"
 
 GCD_LOCAL int registerGtpv1IEParsers(onIEParse ietable[MAX_IE]);
+/*
+ * decode a built-in IE through a switch instead of the parser table. the
+ * IE must be known to fit in len, decodeGtpcBody() validates the chain
+ * before any built-in parser runs
+ * @return
+ *   GTPC_IE_NOT_BUILTIN if the IE has no built-in parser
+ *   otherwise the same as onIEParse
+ */
+GCD_LOCAL int dispatchGtpv1IE(uint8_t *data, uint32_t len, gtp_t *gtp);
+/* value length of TV IEs, 0 for TLV or unknown IEs */
+GCD_LOCAL extern const uint8_t gtpv1TvLen[MAX_IE + 1];
 
 #endif
@@ -4,9 +4,33 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "gtpc-internal.h"
+#include "gtpc-view.h"
 #include "util.h"
 
-#define GTPV2_IMSI 0x01
+/* below macro are based on ts 29.274 */
+#define GTPV2_IMSI                  1
+#define GTPV2_CAUSE                 2
+#define GTPV2_RECOVERY              3
+#define GTPV2_APN                   71
+#define GTPV2_AMBR                  72
+#define GTPV2_EBI                   73
+#define GTPV2_MEI                   75
+#define GTPV2_MSISDN                76
+#define GTPV2_INDICATION            77
+#define GTPV2_PAA                   79
+#define GTPV2_RAT_TYPE              82
+#define GTPV2_SERVING_NETWORK       83
+#define GTPV2_BEARER_QOS            80
+#define GTPV2_ULI                   86
+#define GTPV2_FTEID                 87
+#define GTPV2_BEARER_CONTEXT        93
+#define GTPV2_PDN_TYPE              99
+#define GTPV2_SELECTION_MODE        128
+
+#define GTPV2_INSTANCE(data)        ((data)[3] & 0x0F)
+/* dispatch key of an IE, the instance tells apart IEs of the same type */
+#define GTPV2_KEY(ie, instance)     ((ie) << 4 | (instance))
 
 static inline int decoderGtpV2Tlv(unsigned char *data, int dataLen,
                                   unsigned char type, unsigned char **out_data,
@@ -17,9 +41,6 @@ static inline int decoderGtpV2Tlv(unsigned char *data, int dataLen,
     if (data[0] == type) {
         int length = ntohs(*(short *)&data[1]);
         offset = length + 4;
-        if (dataLen < offset) {
-            return 0;
-        }
         *out_data = data + 4;
         *out_dataLen = length;
     }
@@ -27,7 +48,8 @@ static inline int decoderGtpV2Tlv(unsigned char *data, int dataLen,
     return offset;
 }
 
-static int decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+static GCD_ALWAYS_INLINE int
+decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
 {
     uint8_t *p_value = NULL;
     int p_value_len = 0;
@@ -41,8 +63,516 @@ static int decodeImsi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
     return ret;
 }
 
+static GCD_ALWAYS_INLINE int
+decodeCause(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_CAUSE, &p_value, &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (p_value_len < 2) {
+        gcdLog(GCD_LOG_WARN, "weired Cause length[%d]", p_value_len);
+        return ret;
+    }
+    // p_value[1]: PCE, BCE and CS flags, an offending IE may follow
+    gtp->b2.cause = p_value[0];
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeRecovery(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_RECOVERY, &p_value, &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+    gtp->b2.recovery = p_value[0];
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeApn(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_APN, &p_value, &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (APN2ASCII(p_value, p_value_len, gtp->b2.apn, MAX_APN_LEN + 1) == 0
+        && p_value_len > 0) {
+        gcdLog(GCD_LOG_WARN, "weired APN length[%d]", p_value_len);
+    }
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeAmbr(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_AMBR, &p_value, &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (p_value_len < 8) {
+        gcdLog(GCD_LOG_WARN, "weired AMBR length[%d]", p_value_len);
+        return ret;
+    }
+    gtp->b2.ambrUplink = ntohl(*(uint32_t *)p_value);
+    gtp->b2.ambrDownlink = ntohl(*(uint32_t *)(p_value + 4));
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeEbi(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_EBI, &p_value, &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+    gtp->b2.ebi = p_value[0] & 0x0F;
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeMei(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_MEI, &p_value, &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    BCD2ASCII(p_value, p_value_len * 2, gtp->b2.mei, MAX_IMEISV_BCD_LEN + 1);
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeMsisdn(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_MSISDN, &p_value, &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    BCD2ASCII(p_value, p_value_len * 2, gtp->b2.msisdn,
+              MAX_MSISDN_BCD_LEN + 1);
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeIndication(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_INDICATION, &p_value,
+                              &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    // flags of later releases are kept as far as they fit
+    gtp->b2.indicationLen = p_value_len < MAX_INDICATION_LEN
+                                ? p_value_len
+                                : MAX_INDICATION_LEN;
+    memcpy(gtp->b2.indication, p_value, gtp->b2.indicationLen);
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodePaa(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_PAA, &p_value, &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+    uint8_t type = p_value[0] & 0x07;
+    switch (type) {
+    case 1:
+        if (p_value_len < 5) {
+            break;
+        }
+        gtp->b2.paaType = type;
+        memcpy(gtp->b2.paaIpv4, p_value + 1, 4);
+        return ret;
+    case 2:
+    case 3:
+        if (p_value_len < (type == 2 ? 18 : 22)) {
+            break;
+        }
+        gtp->b2.paaType = type;
+        gtp->b2.paaIpv6PrefixLen = p_value[1];
+        memcpy(gtp->b2.paaIpv6, p_value + 2, 16);
+        if (type == 3) {
+            memcpy(gtp->b2.paaIpv4, p_value + 18, 4);
+        }
+        return ret;
+    default:
+        return ret;
+    }
+    gcdLog(GCD_LOG_WARN, "weired PAA length[%d]", p_value_len);
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeRatType(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_RAT_TYPE, &p_value, &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+    gtp->b2.ratType = p_value[0];
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeServingNetwork(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_SERVING_NETWORK, &p_value,
+                              &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (p_value_len < 3) {
+        gcdLog(GCD_LOG_WARN, "weired Serving Network length[%d]", p_value_len);
+        return ret;
+    }
+    decodeMccMnc(p_value, gtp->b2.servingNetworkMcc,
+                 gtp->b2.servingNetworkMnc);
+    return ret;
+}
+
+/* plmn of the first location part present */
+static inline void uliPlmn(gtp_t *gtp, uint8_t *plmn)
+{
+    if (!gtp->b2.uliMcc[0]) {
+        decodeMccMnc(plmn, gtp->b2.uliMcc, gtp->b2.uliMnc);
+    }
+}
+
+static int decodeUli(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_ULI, &p_value, &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+
+    uint8_t flags = p_value[0];
+    int offset = 1;
+    gtp->b2.uliMcc[0] = 0;
+    // the parts follow the order of their flags
+    if (flags & GTPV2_ULI_CGI) {
+        if (offset + 7 > p_value_len) {
+            goto truncated;
+        }
+        uliPlmn(gtp, p_value + offset);
+        gtp->b2.uliLac = ntohs(*(uint16_t *)(p_value + offset + 3));
+        gtp->b2.uliCi = ntohs(*(uint16_t *)(p_value + offset + 5));
+        offset += 7;
+    }
+    if (flags & GTPV2_ULI_SAI) {
+        if (offset + 7 > p_value_len) {
+            goto truncated;
+        }
+        uliPlmn(gtp, p_value + offset);
+        gtp->b2.uliLac = ntohs(*(uint16_t *)(p_value + offset + 3));
+        gtp->b2.uliSac = ntohs(*(uint16_t *)(p_value + offset + 5));
+        offset += 7;
+    }
+    if (flags & GTPV2_ULI_RAI) {
+        if (offset + 7 > p_value_len) {
+            goto truncated;
+        }
+        uliPlmn(gtp, p_value + offset);
+        gtp->b2.uliLac = ntohs(*(uint16_t *)(p_value + offset + 3));
+        gtp->b2.uliRac = p_value[offset + 5];
+        offset += 7;
+    }
+    if (flags & GTPV2_ULI_TAI) {
+        if (offset + 5 > p_value_len) {
+            goto truncated;
+        }
+        uliPlmn(gtp, p_value + offset);
+        gtp->b2.uliTac = ntohs(*(uint16_t *)(p_value + offset + 3));
+        offset += 5;
+    }
+    if (flags & GTPV2_ULI_ECGI) {
+        if (offset + 7 > p_value_len) {
+            goto truncated;
+        }
+        uliPlmn(gtp, p_value + offset);
+        gtp->b2.uliEci = ntohl(*(uint32_t *)(p_value + offset + 3)) & 0x0FFFFFFF;
+        offset += 7;
+    }
+    if (flags & GTPV2_ULI_LAI) {
+        if (offset + 5 > p_value_len) {
+            goto truncated;
+        }
+        uliPlmn(gtp, p_value + offset);
+        gtp->b2.uliLac = ntohs(*(uint16_t *)(p_value + offset + 3));
+        offset += 5;
+    }
+    gtp->b2.uliFlags = flags;
+    return ret;
+
+truncated:
+    gcdLog(GCD_LOG_WARN, "weired ULI length[%d]", p_value_len);
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeFteid(uint8_t *data, uint32_t datalen, gtp_v2_fteid_t *fteid)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_FTEID, &p_value, &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    uint8_t v4 = p_value_len > 0 && (p_value[0] & 0x80);
+    uint8_t v6 = p_value_len > 0 && (p_value[0] & 0x40);
+    if (p_value_len < 5 + (v4 ? 4 : 0) + (v6 ? 16 : 0)) {
+        gcdLog(GCD_LOG_WARN, "weired F-TEID length[%d]", p_value_len);
+        return ret;
+    }
+    fteid->present = 1;
+    fteid->ifType = p_value[0] & 0x3F;
+    fteid->hasIpv4 = v4;
+    fteid->hasIpv6 = v6;
+    fteid->teid = ntohl(*(uint32_t *)(p_value + 1));
+    if (v4) {
+        memcpy(fteid->ipv4, p_value + 5, 4);
+    }
+    if (v6) {
+        memcpy(fteid->ipv6, p_value + (v4 ? 9 : 5), 16);
+    }
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeSenderFteid(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    return decodeFteid(data, datalen, &gtp->b2.senderFteid);
+}
+
+static GCD_ALWAYS_INLINE int
+decodePgwFteid(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    return decodeFteid(data, datalen, &gtp->b2.pgwFteid);
+}
+
+/* 40 bit bit rate of the bearer qos */
+static inline uint64_t bitRate(const uint8_t *p)
+{
+    return (uint64_t)p[0] << 32 | (uint64_t)ntohl(*(uint32_t *)(p + 1));
+}
+
+static void decodeBearerQos(const uint8_t *value, uint16_t len,
+                            gtp_v2_bearer_t *bearer)
+{
+    if (len < 22) {
+        gcdLog(GCD_LOG_WARN, "weired Bearer QoS length[%u]", len);
+        return;
+    }
+    bearer->arp = value[0];
+    bearer->qci = value[1];
+    bearer->mbrUplink = bitRate(value + 2);
+    bearer->mbrDownlink = bitRate(value + 7);
+    bearer->gbrUplink = bitRate(value + 12);
+    bearer->gbrDownlink = bitRate(value + 17);
+}
+
+/*
+ * decode a bearer context into the next free slot, its children are
+ * walked in place and nested grouped IEs are skipped
+ */
+static int decodeBearerContext(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_BEARER_CONTEXT, &p_value,
+                              &p_value_len);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (gtp->b2.bearerTotal < UINT8_MAX) {
+        gtp->b2.bearerTotal++;
+    }
+    if (gtp->b2.bearerCount == MAX_BEARER_CONTEXTS) {
+        return ret;
+    }
+
+    gtp_v2_bearer_t *bearer = &gtp->b2.bearers[gtp->b2.bearerCount];
+    gtp_ie_iter_t it;
+    gtp_ie_ref_t child;
+    gtp_v2_fteid_t fteid;
+    int rc;
+    memset(bearer, 0, sizeof(*bearer));
+    bearer->instance = GTPV2_INSTANCE(data);
+    gtpcIEIterInit(&it, p_value, 0, p_value_len);
+    while ((rc = gtpcIEIterNext(&it, &child)) > 0) {
+        uint8_t *value = p_value + child.offset;
+        switch (child.type) {
+        case GTPV2_EBI:
+            if (child.length >= 1) {
+                bearer->ebi = value[0] & 0x0F;
+            }
+            break;
+        case GTPV2_CAUSE:
+            if (child.length >= 1) {
+                bearer->cause = value[0];
+            }
+            break;
+        case GTPV2_BEARER_QOS:
+            decodeBearerQos(value, child.length, bearer);
+            break;
+        case GTPV2_FTEID:
+            if (child.instance < MAX_BEARER_FTEID
+                && decodeFteid(value - 4, child.length + 4, &fteid) > 0
+                && fteid.present) {
+                gtp_v2_bearer_fteid_t *f = &bearer->fteid[child.instance];
+                f->teid = fteid.teid;
+                memcpy(f->ipv4, fteid.ipv4, sizeof(f->ipv4));
+                f->ifType = fteid.ifType;
+                f->hasIpv4 = fteid.hasIpv4;
+                f->hasIpv6 = fteid.hasIpv6;
+                bearer->fteidMask |= 1 << child.instance;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if (rc < 0) {
+        return 0; // a child runs past its bearer context
+    }
+    gtp->b2.bearerCount++;
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodePdnType(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret =
+        decoderGtpV2Tlv(data, datalen, GTPV2_PDN_TYPE, &p_value, &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+    gtp->b2.pdnType = p_value[0] & 0x07;
+    return ret;
+}
+
+static GCD_ALWAYS_INLINE int
+decodeSelectionMode(uint8_t *data, uint32_t datalen, gtp_t *gtp)
+{
+    uint8_t *p_value = NULL;
+    int p_value_len = 0;
+
+    int ret = decoderGtpV2Tlv(data, datalen, GTPV2_SELECTION_MODE, &p_value,
+                              &p_value_len);
+    if (ret <= 0 || p_value_len < 1) {
+        return ret;
+    }
+    gtp->b2.selectionMode = p_value[0] & 0x03;
+    return ret;
+}
+
+/*
+ * built-in IEs keyed on (type, instance), shared by the parser table and
+ * the switch dispatcher
+ */
+// clang-format off
+#define GTPV2_BUILTIN_IES(X)                                \
+    X(GTPV2_IMSI, 0, decodeImsi)                            \
+    X(GTPV2_CAUSE, 0, decodeCause)                          \
+    X(GTPV2_RECOVERY, 0, decodeRecovery)                    \
+    X(GTPV2_APN, 0, decodeApn)                              \
+    X(GTPV2_AMBR, 0, decodeAmbr)                            \
+    X(GTPV2_EBI, 0, decodeEbi)                              \
+    X(GTPV2_MEI, 0, decodeMei)                              \
+    X(GTPV2_MSISDN, 0, decodeMsisdn)                        \
+    X(GTPV2_INDICATION, 0, decodeIndication)                \
+    X(GTPV2_PAA, 0, decodePaa)                              \
+    X(GTPV2_RAT_TYPE, 0, decodeRatType)                     \
+    X(GTPV2_SERVING_NETWORK, 0, decodeServingNetwork)       \
+    X(GTPV2_ULI, 0, decodeUli)                              \
+    X(GTPV2_FTEID, 0, decodeSenderFteid)                    \
+    X(GTPV2_FTEID, 1, decodePgwFteid)                       \
+    X(GTPV2_BEARER_CONTEXT, 0, decodeBearerContext)         \
+    X(GTPV2_BEARER_CONTEXT, 1, decodeBearerContext)         \
+    X(GTPV2_PDN_TYPE, 0, decodePdnType)                     \
+    X(GTPV2_SELECTION_MODE, 0, decodeSelectionMode)
+// clang-format on
+
+int dispatchGtpv2IE(uint8_t *data, uint32_t len, gtp_t *gtp)
+{
+    switch (GTPV2_KEY(data[0], GTPV2_INSTANCE(data))) {
+#define X(ie, instance, parser)        \
+    case GTPV2_KEY(ie, instance):      \
+        return parser(data, len, gtp);
+        GTPV2_BUILTIN_IES(X)
+#undef X
+    default:
+        return GTPC_IE_NOT_BUILTIN;
+    }
+}
+
+/*
+ * parser table entry of every built-in type, the table is indexed by type
+ * only, instances without a built-in field are skipped
+ */
+static int decodeByInstance(uint8_t *data, uint32_t len, gtp_t *gtp)
+{
+    int ret = dispatchGtpv2IE(data, len, gtp);
+    if (ret != GTPC_IE_NOT_BUILTIN) {
+        return ret;
+    }
+    return 4 + ntohs(*(uint16_t *)&data[1]);
+}
+
 int registerGtpv2IEParsers(onIEParse ietable[MAX_IE])
 {
-    ietable[GTPV2_IMSI] = decodeImsi;
+#define X(ie, instance, parser) ietable[ie] = decodeByInstance;
+    GTPV2_BUILTIN_IES(X)
+#undef X
+
     return 1;
 }
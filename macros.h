@@ -26,6 +26,16 @@
   #endif
 #endif
 
+#if defined __GNUC__
+  #define GCD_PREFETCH_R(addr) __builtin_prefetch((addr), 0, 3)
+  #define GCD_PREFETCH_W(addr) __builtin_prefetch((addr), 1, 3)
+  #define GCD_ALWAYS_INLINE    inline __attribute__((always_inline))
+#else
+  #define GCD_PREFETCH_R(addr)
+  #define GCD_PREFETCH_W(addr)
+  #define GCD_ALWAYS_INLINE    inline
+#endif
+
 #define MAX_MCC_SIZE 3
 #define MAX_MNC_SIZE 3
 
@@ -0,0 +1,442 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gtpc-capture.h"
+#include "gtpc-decoder.h"
+#include "gtpc-pcap.h"
+#include "gtpc-pipeline.h"
+#include "gtpc-transaction.h"
+
+/*
+ * gcd-pcap: decode every gtpc message of pcap/pcapng captures
+ *
+ *   gcd-pcap [-q] [-l] [-b batch] [-w workers [-p]] file...
+ *   gcd-pcap [-q] [-l] [-b batch] [-w rings] -i interface
+ *
+ * "-" reads stdin, *.gz is decompressed on the fly. fragmented datagrams
+ * are reassembled, VLAN/MPLS and IPv6 extension headers skipped. -q only
+ * prints the summary. -l matches requests with responses and reports their
+ * latency.
+ * -w decodes on a pipeline of worker threads, pinned with -p, messages are
+ * still printed in capture order.
+ * -i captures live from an interface until interrupted, -w is then the
+ * number of fanout rings, each decoded in place by a thread of its own.
+ */
+
+#define MAX_BATCH 1024
+
+/* what the sink needs of a payload copied into a pipeline chunk */
+typedef struct msg_meta_s {
+    gcd_payload_t payload;
+    uint8_t src[16];
+    uint8_t dst[16];
+    uint8_t *copy; // a payload too large for the arena, freed by the sink
+} msg_meta_t;
+
+typedef struct run_s {
+    int quiet;
+    gcd_pipeline_t *pipeline;
+    gcd_chunk_t *chunk;
+    gcd_matcher_t *matcher;
+    uint64_t messages;
+    uint64_t decoded;
+    uint64_t errors;
+    uint8_t *data[MAX_BATCH];
+    uint32_t len[MAX_BATCH];
+    int status[MAX_BATCH];
+    gtp_t gtp[MAX_BATCH];
+} run_t;
+
+static void printMessage(const gcd_payload_t *p, const gtp_t *gtp, int status)
+{
+    char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+    int af = p->ipVersion == 6 ? AF_INET6 : AF_INET;
+    inet_ntop(af, p->src, src, sizeof(src));
+    inet_ntop(af, p->dst, dst, sizeof(dst));
+    printf("%lu.%09lu %s:%u > %s:%u v%u type %u teid 0x%08x sqn %u",
+           (unsigned long)(p->tsNs / 1000000000ULL),
+           (unsigned long)(p->tsNs % 1000000000ULL), src, p->srcPort, dst,
+           p->dstPort, gtp->hdr.version, gtp->hdr.msgType, gtp->hdr.teid,
+           gtp->hdr.sqn);
+    if (status == 1) {
+        printf("\n");
+    } else {
+        printf(" error %u ie %u offset %u\n", gtp->err.code, gtp->err.ie,
+               gtp->err.offset);
+    }
+}
+
+static void onChunk(gcd_chunk_t *chunk, void *arg)
+{
+    run_t *run = arg;
+    __atomic_add_fetch(&run->messages, chunk->count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&run->decoded, chunk->ok, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&run->errors, chunk->count - chunk->ok,
+                       __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < chunk->count; i++) {
+        msg_meta_t *meta = gcdChunkUser(chunk, i);
+        if (run->matcher && chunk->status[i] >= 0) {
+            gcdMatcherFeed(run->matcher, &chunk->gtp[i].hdr, &meta->payload,
+                           NULL);
+        }
+        if (!run->quiet) {
+            printMessage(&meta->payload, &chunk->gtp[i], chunk->status[i]);
+        }
+        free(meta->copy);
+    }
+}
+
+static void submitPayload(run_t *run, const gcd_payload_t *payload)
+{
+    int i;
+    uint8_t *copy = NULL;
+    for (;;) {
+        if (!run->chunk) {
+            run->chunk = gcdPipelineAcquire(run->pipeline);
+        }
+        i = gcdChunkAppend(run->chunk, payload->data, payload->len);
+        if (i >= 0) {
+            break;
+        }
+        if (run->chunk->count == 0) {
+            // larger than a whole arena, referenced until the sink saw it
+            copy = malloc(payload->len);
+            if (!copy) {
+                __atomic_add_fetch(&run->messages, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&run->errors, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            memcpy(copy, payload->data, payload->len);
+            i = gcdChunkAdd(run->chunk, copy, payload->len);
+            break;
+        }
+        gcdPipelineSubmit(run->pipeline, run->chunk);
+        run->chunk = NULL;
+    }
+    msg_meta_t *meta = gcdChunkUser(run->chunk, i);
+    meta->copy = copy;
+    uint32_t alen = payload->ipVersion == 6 ? 16 : 4;
+    meta->payload = *payload;
+    memcpy(meta->src, payload->src, alen);
+    memcpy(meta->dst, payload->dst, alen);
+    meta->payload.src = meta->src;
+    meta->payload.dst = meta->dst;
+}
+
+static int onBatch(gcd_payload_t *payloads, uint32_t n, void *arg)
+{
+    run_t *run = arg;
+    if (run->pipeline) {
+        for (uint32_t i = 0; i < n; i++) {
+            submitPayload(run, &payloads[i]);
+        }
+        return 0;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        run->data[i] = payloads[i].data;
+        run->len[i] = payloads[i].len;
+    }
+    memset(run->gtp, 0, sizeof(gtp_t) * n);
+    run->decoded += decodeGtpcBatch(run->data, run->len, run->gtp, run->status,
+                                    n);
+    run->messages += n;
+    for (uint32_t i = 0; i < n; i++) {
+        if (run->status[i] != 1) {
+            run->errors++;
+        }
+        if (run->matcher && run->status[i] >= 0) {
+            gcdMatcherFeed(run->matcher, &run->gtp[i].hdr, &payloads[i], NULL);
+        }
+        if (!run->quiet) {
+            printMessage(&payloads[i], &run->gtp[i], run->status[i]);
+        }
+    }
+    return 0;
+}
+
+/* decode buffers of one live capture thread */
+typedef struct live_s {
+    uint8_t *data[MAX_BATCH];
+    uint32_t len[MAX_BATCH];
+    int status[MAX_BATCH];
+    gtp_t gtp[MAX_BATCH];
+} live_t;
+
+static pthread_key_t liveKey; // live_t of the calling thread
+static pthread_mutex_t matcherLock = PTHREAD_MUTEX_INITIALIZER;
+static gcd_capture_t *capture;
+
+/* same as onBatch, called concurrently on the frames of the rings */
+static int onLiveBatch(gcd_payload_t *payloads, uint32_t n, void *arg)
+{
+    run_t *run = arg;
+    live_t *live = pthread_getspecific(liveKey);
+    if (!live) {
+        live = malloc(sizeof(*live));
+        if (!live || pthread_setspecific(liveKey, live)) {
+            free(live);
+            return 1;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        live->data[i] = payloads[i].data;
+        live->len[i] = payloads[i].len;
+    }
+    memset(live->gtp, 0, sizeof(gtp_t) * n);
+    uint32_t ok = decodeGtpcBatch(live->data, live->len, live->gtp,
+                                  live->status, n);
+    __atomic_add_fetch(&run->messages, n, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&run->decoded, ok, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&run->errors, n - ok, __ATOMIC_RELAXED);
+    if (run->matcher) {
+        pthread_mutex_lock(&matcherLock);
+        for (uint32_t i = 0; i < n; i++) {
+            if (live->status[i] >= 0) {
+                gcdMatcherFeed(run->matcher, &live->gtp[i].hdr, &payloads[i],
+                               NULL);
+            }
+        }
+        pthread_mutex_unlock(&matcherLock);
+    }
+    if (!run->quiet) {
+        flockfile(stdout);
+        for (uint32_t i = 0; i < n; i++) {
+            printMessage(&payloads[i], &live->gtp[i], live->status[i]);
+        }
+        funlockfile(stdout);
+    }
+    return 0;
+}
+
+static void printReassembly(const gcd_reasm_stats_t *s)
+{
+    if (!s->fragments) {
+        return;
+    }
+    fprintf(stderr,
+            "fragments %lu, reassembled %lu, timeouts %lu, evicted %lu, "
+            "invalid %lu\n",
+            (unsigned long)s->fragments, (unsigned long)s->reassembled,
+            (unsigned long)s->timeouts, (unsigned long)s->evicted,
+            (unsigned long)s->invalid);
+}
+
+static void onSignal(int sig)
+{
+    gcdCaptureStop(capture);
+}
+
+static int captureLive(run_t *run, const char *ifname, uint32_t batch,
+                       uint32_t rings, gcd_pcap_stats_t *total)
+{
+    gcd_capture_conf_t conf = {
+        .ifname = ifname,
+        .rings = rings,
+        .batch = batch,
+        .reassembly = &(gcd_reasm_conf_t){0},
+    };
+    capture = gcdCaptureOpen(&conf);
+    if (!capture) {
+        fprintf(stderr, "%s: %s\n", ifname, strerror(errno));
+        return 1;
+    }
+    pthread_key_create(&liveKey, free);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    int ret = gcdCaptureRun(capture, onLiveBatch, run) < 0;
+    if (ret) {
+        fprintf(stderr, "%s: capture failed\n", ifname);
+    }
+    gcd_capture_stats_t st;
+    gcdCaptureStats(capture, &st);
+    total->frames = st.frames;
+    total->bytes = st.bytes;
+    total->payloads = st.payloads;
+    total->malformed = st.malformed;
+    fprintf(stderr, "kernel drops %lu, rings full %lu times\n",
+            (unsigned long)st.drops, (unsigned long)st.freezes);
+    printReassembly(&st.reasm);
+    free(pthread_getspecific(liveKey)); // ring 0 ran on this thread
+    pthread_key_delete(liveKey);
+    gcdCaptureClose(capture);
+    return ret;
+}
+
+static void printLatency(const char *name, const gcd_txn_stats_t *s)
+{
+    fprintf(stderr,
+            "%-24s req %lu rsp %lu retrans %lu timeout %lu unmatched %lu "
+            "latency us p50 %.1f p99 %.1f max %.1f\n",
+            name, (unsigned long)s->requests, (unsigned long)s->responses,
+            (unsigned long)s->retransmissions, (unsigned long)s->timeouts,
+            (unsigned long)s->unmatched,
+            gcdHistogramPercentile(&s->latency, 50) / 1e3,
+            gcdHistogramPercentile(&s->latency, 99) / 1e3,
+            s->latency.max / 1e3);
+}
+
+static void reportLatency(const gcd_matcher_t *m)
+{
+    char name[64];
+    for (uint32_t v = 0; v <= MAX_GTPC_VERSION; v++) {
+        for (uint32_t t = 0; t < 256; t++) {
+            const gcd_txn_stats_t *s = gcdMatcherTypeStats(m, v, t);
+            if (s) {
+                snprintf(name, sizeof(name), "v%u type %u", v, t);
+                printLatency(name, s);
+            }
+        }
+    }
+    const gcd_txn_peer_t *peer;
+    for (uint32_t i = 0; (peer = gcdMatcherPeer(m, i)); i++) {
+        int af = peer->addr.family == GTP_ADDR_IPV6 ? AF_INET6 : AF_INET;
+        inet_ntop(af, peer->addr.addr, name, sizeof(name));
+        printLatency(name, &peer->stats);
+    }
+    gcd_matcher_totals_t totals;
+    gcdMatcherTotals(m, &totals);
+    fprintf(stderr, "transactions %lu answered, %lu pending, %lu dropped\n",
+            (unsigned long)totals.responses, (unsigned long)totals.pending,
+            (unsigned long)totals.overflows);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-q] [-l] [-b batch] [-w workers [-p]] file...\n"
+            "       %s [-q] [-l] [-b batch] [-w rings] -i interface\n",
+            prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static run_t run;
+    uint32_t batch = 64;
+    gcd_pipeline_conf_t conf = {
+        .ordered = 1,
+        .userSize = sizeof(msg_meta_t),
+        .sink = onChunk,
+        .arg = &run,
+    };
+    const char *ifname = NULL;
+    int opt, workers = 0, ret = 0;
+    while ((opt = getopt(argc, argv, "qlb:w:pi:h")) != -1) {
+        switch (opt) {
+        case 'q':
+            run.quiet = 1;
+            break;
+        case 'l':
+            run.matcher = gcdMatcherCreate(&(gcd_matcher_conf_t){0});
+            if (!run.matcher) {
+                fprintf(stderr, "create matcher failed\n");
+                return 1;
+            }
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        case 'w':
+            workers = atoi(optarg);
+            break;
+        case 'p':
+            conf.pin = 1;
+            break;
+        case 'i':
+            ifname = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    /* files or an interface, not both */
+    if ((optind >= argc) == !ifname || batch == 0 || batch > MAX_BATCH
+        || workers < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!initIEParsers()) {
+        fprintf(stderr, "init IE parsers failed\n");
+        return 1;
+    }
+    if (workers && !ifname) {
+        conf.workers = workers;
+        conf.ordered = !run.quiet || run.matcher; // counting needs no order
+        run.pipeline = gcdPipelineCreate(&conf);
+        if (!run.pipeline) {
+            fprintf(stderr, "create pipeline failed\n");
+            return 1;
+        }
+    }
+
+    gcd_reasm_t *reasm = gcdReasmCreate(&(gcd_reasm_conf_t){0});
+    if (!reasm) {
+        fprintf(stderr, "create reassembly failed\n");
+        return 1;
+    }
+    gcd_pcap_stats_t total = {0};
+    double start = now();
+    if (ifname) {
+        ret = captureLive(&run, ifname, batch, workers, &total);
+    }
+    for (int i = optind; i < argc; i++) {
+        gcd_pcap_t *pcap = gcdPcapOpen(argv[i]);
+        if (!pcap) {
+            fprintf(stderr, "%s: not a readable pcap/pcapng capture\n",
+                    argv[i]);
+            ret = 1;
+            continue;
+        }
+        gcdPcapSetReassembly(pcap, reasm);
+        if (gcdPcapForEach(pcap, batch, onBatch, &run) < 0) {
+            fprintf(stderr, "%s: malformed or truncated capture\n", argv[i]);
+            ret = 1;
+        }
+        const gcd_pcap_stats_t *st = gcdPcapStats(pcap);
+        total.frames += st->frames;
+        total.bytes += st->bytes;
+        total.payloads += st->payloads;
+        total.malformed += st->malformed;
+        gcdPcapClose(pcap);
+    }
+    if (run.pipeline) {
+        if (run.chunk) {
+            gcdPipelineSubmit(run.pipeline, run.chunk);
+        }
+        gcdPipelineDestroy(run.pipeline);
+    }
+    double elapsed = now() - start;
+
+    fprintf(stderr,
+            "frames %lu (%lu malformed), gtpc %lu, decoded %lu, errors %lu, "
+            "%.1f MB/s\n",
+            (unsigned long)total.frames, (unsigned long)total.malformed,
+            (unsigned long)run.messages, (unsigned long)run.decoded,
+            (unsigned long)run.errors,
+            elapsed > 0 ? total.bytes / elapsed / 1e6 : 0.0);
+    if (!ifname) {
+        gcd_reasm_stats_t rs;
+        gcdReasmStats(reasm, &rs);
+        printReassembly(&rs);
+    }
+    gcdReasmDestroy(reasm);
+    if (run.matcher) {
+        reportLatency(run.matcher);
+        gcdMatcherDestroy(run.matcher);
+    }
+    return ret;
+}
@@ -0,0 +1,225 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gtpc-decoder.h"
+#include "gtpc-udp.h"
+
+/*
+ * gcd-probe: decode the gtpc datagrams sent to a udp port
+ *
+ *   gcd-probe [-a addr] [-P port] [-w workers [-p]] [-b batch] [-r rcvbuf]
+ *             [-u] [-v]
+ *
+ * every worker owns a SO_REUSEPORT socket of the port (default 2123) and
+ * decodes what it receives in place. -u receives with io_uring multishot
+ * recvmsg instead of recvmmsg. -r sets SO_RCVBUF of the sockets. -v prints
+ * every message. the rates are printed every second until interrupted.
+ */
+
+#define MAX_BATCH 1024
+
+typedef struct run_s {
+    int verbose;
+    uint64_t messages;
+    uint64_t decoded;
+    uint64_t errors;
+} run_t;
+
+/* decode buffers of one worker */
+typedef struct worker_s {
+    uint8_t *data[MAX_BATCH];
+    uint32_t len[MAX_BATCH];
+    int status[MAX_BATCH];
+    gtp_t gtp[MAX_BATCH];
+} worker_t;
+
+static pthread_key_t workerKey;
+static volatile sig_atomic_t stopped;
+
+static void printMessage(const gcd_payload_t *p, const gtp_t *gtp, int status)
+{
+    char src[INET6_ADDRSTRLEN];
+    inet_ntop(p->ipVersion == 6 ? AF_INET6 : AF_INET, p->src, src,
+              sizeof(src));
+    printf("%s:%u v%u type %u teid 0x%08x sqn %u", src, p->srcPort,
+           gtp->hdr.version, gtp->hdr.msgType, gtp->hdr.teid, gtp->hdr.sqn);
+    if (status == 1) {
+        printf("\n");
+    } else {
+        printf(" error %u ie %u offset %u\n", gtp->err.code, gtp->err.ie,
+               gtp->err.offset);
+    }
+}
+
+static int onDatagrams(gcd_payload_t *payloads, uint32_t n, void *arg)
+{
+    run_t *run = arg;
+    worker_t *w = pthread_getspecific(workerKey);
+    if (!w) {
+        w = malloc(sizeof(*w));
+        if (!w || pthread_setspecific(workerKey, w)) {
+            free(w);
+            return 1;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        w->data[i] = payloads[i].data;
+        w->len[i] = payloads[i].len;
+    }
+    memset(w->gtp, 0, sizeof(gtp_t) * n);
+    uint32_t ok = decodeGtpcBatch(w->data, w->len, w->gtp, w->status, n);
+    __atomic_add_fetch(&run->messages, n, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&run->decoded, ok, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&run->errors, n - ok, __ATOMIC_RELAXED);
+    if (run->verbose) {
+        flockfile(stdout);
+        for (uint32_t i = 0; i < n; i++) {
+            printMessage(&payloads[i], &w->gtp[i], w->status[i]);
+        }
+        funlockfile(stdout);
+    }
+    return 0;
+}
+
+typedef struct receiver_s {
+    gcd_udp_t *udp;
+    run_t *run;
+    int ret;
+    int done;
+} receiver_t;
+
+static void *receive(void *arg)
+{
+    receiver_t *r = arg;
+    r->ret = gcdUdpRun(r->udp, onDatagrams, r->run);
+    __atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void onSignal(int sig)
+{
+    stopped = 1;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(run_t *run, gcd_udp_t *udp, gcd_udp_stats_t *last,
+                   double elapsed)
+{
+    gcd_udp_stats_t st;
+    gcdUdpStats(udp, &st);
+    uint64_t datagrams = st.datagrams - last->datagrams;
+    uint64_t syscalls = st.syscalls - last->syscalls;
+    fprintf(stderr,
+            "%.0f msgs/s %.1f MB/s, %.1f msgs per syscall, decoded %lu, "
+            "errors %lu, truncated %lu\n",
+            datagrams / elapsed, (st.bytes - last->bytes) / elapsed / 1e6,
+            syscalls ? (double)datagrams / syscalls : 0.0,
+            (unsigned long)__atomic_load_n(&run->decoded, __ATOMIC_RELAXED),
+            (unsigned long)__atomic_load_n(&run->errors, __ATOMIC_RELAXED),
+            (unsigned long)st.truncated);
+    *last = st;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-a addr] [-P port] [-w workers [-p]] [-b batch] "
+            "[-r rcvbuf] [-u] [-v]\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static run_t run;
+    gcd_udp_conf_t conf = {.mode = GCD_UDP_RECVMMSG};
+    int opt;
+    while ((opt = getopt(argc, argv, "a:P:w:pb:r:uvh")) != -1) {
+        switch (opt) {
+        case 'a':
+            conf.addr = optarg;
+            break;
+        case 'P':
+            conf.port = atoi(optarg);
+            break;
+        case 'w':
+            conf.workers = atoi(optarg);
+            break;
+        case 'p':
+            conf.pin = 1;
+            break;
+        case 'b':
+            conf.batch = atoi(optarg);
+            break;
+        case 'r':
+            conf.rcvbuf = atoi(optarg);
+            break;
+        case 'u':
+            conf.mode = GCD_UDP_URING;
+            break;
+        case 'v':
+            run.verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc || conf.batch > MAX_BATCH) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!initIEParsers()) {
+        fprintf(stderr, "init IE parsers failed\n");
+        return 1;
+    }
+    gcd_udp_t *udp = gcdUdpOpen(&conf);
+    if (!udp) {
+        fprintf(stderr, "open udp receiver failed: %s\n", strerror(errno));
+        return 1;
+    }
+    pthread_key_create(&workerKey, free);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    receiver_t receiver = {.udp = udp, .run = &run};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, receive, &receiver)) {
+        fprintf(stderr, "start receiver failed\n");
+        gcdUdpClose(udp);
+        return 1;
+    }
+    gcd_udp_stats_t last = {0};
+    double t0 = now();
+    while (!stopped && !__atomic_load_n(&receiver.done, __ATOMIC_ACQUIRE)) {
+        sleep(1); // cut short by the signal
+        double t1 = now();
+        report(&run, udp, &last, t1 - t0);
+        t0 = t1;
+    }
+    gcdUdpStop(udp);
+    pthread_join(thread, NULL);
+
+    gcd_udp_stats_t st;
+    gcdUdpStats(udp, &st);
+    fprintf(stderr,
+            "datagrams %lu, decoded %lu, errors %lu, truncated %lu, "
+            "syscalls %lu, rearms %lu\n",
+            (unsigned long)st.datagrams, (unsigned long)run.decoded,
+            (unsigned long)run.errors, (unsigned long)st.truncated,
+            (unsigned long)st.syscalls, (unsigned long)st.rearms);
+    gcdUdpClose(udp);
+    return receiver.ret < 0;
+}
@@ -1,44 +1,140 @@
 #include "util.h"
 
 #include <arpa/inet.h>
-#include <stdio.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "macros.h"
 
-uint8_t BCD2ASCII(uint8_t *bcd, uint8_t bcdLen, char *ascii, uint8_t asciiLen)
+/* nibble to ascii, 0xD and 0xE are the '*' and '#' of TS 24.008 */
+static const char bcd_digits[16] = "0123456789:;<*#?";
+
+static void bcdExpandScalar(uint8_t *bcd, uint8_t bcdLen, char *ascii)
 {
-    int i = 0, j = 0;
-    if (asciiLen < bcdLen) return 0;
-    if ((bcdLen == 0) || (asciiLen == 0)) return 0;
+    for (int i = 0; i < bcdLen; i += 2) {
+        ascii[i] = bcd_digits[bcd[i / 2] & 0x0F];
+        ascii[i + 1] = bcd_digits[(bcd[i / 2] >> 4) & 0x0F];
+    }
+}
 
-    ascii[0] = 0;
-
-    for (i = 0; i < bcdLen; i++) {
-        j = i / 2;
-        ascii[i] = (bcd[j] & 0x0F) + 0x30;
-        switch (ascii[i]) {
-        case 0x3D: {
-            ascii[i] = '*';
-        } break;
-        case 0x3E: {
-            ascii[i] = '#';
-        } break;
-        default:
-            break;
+static int apnCopyScalar(uint8_t *apn, int len, char *ascii)
+{
+    int i = 0;
+    for (; i < len && apn[i] != 0; i++) {
+        // convert unprintable character
+        ascii[i] = apn[i] < 0x20 ? '.' : apn[i];
+    }
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("ssse3"))) static void
+bcdExpandSsse3(uint8_t *bcd, uint8_t bcdLen, char *ascii)
+{
+    const __m128i digits = _mm_loadu_si128((const __m128i *)bcd_digits);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    int i = 0;
+    // 8 bcd bytes per round, never read or write past the caller's buffers
+    for (; i < bcdLen; i += 16) {
+        uint64_t in = 0;
+        int n = (bcdLen - i + 1) / 2;
+        memcpy(&in, bcd + i / 2, n > 8 ? 8 : n);
+        __m128i v = _mm_loadl_epi64((const __m128i *)&in);
+        __m128i lo = _mm_and_si128(v, nibble);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        __m128i out = _mm_shuffle_epi8(digits, _mm_unpacklo_epi8(lo, hi));
+        if (bcdLen - i >= 16) {
+            _mm_storeu_si128((__m128i *)(ascii + i), out);
+        } else {
+            char tmp[16];
+            _mm_storeu_si128((__m128i *)tmp, out);
+            memcpy(ascii + i, tmp, ((bcdLen - i) + 1) & ~1);
         }
-        ++i;
-        ascii[i] = ((bcd[j] & 0xF0) >> 4) + 0x30;
-        switch (ascii[i]) {
-        case 0x3D: {
-            ascii[i] = '*';
-        } break;
-        case 0x3E: {
-            ascii[i] = '#';
-        } break;
-        default:
-            break;
+    }
+}
+
+__attribute__((target("sse2"))) static int apnCopySse2(uint8_t *apn, int len,
+                                                       char *ascii)
+{
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    const __m128i dot = _mm_set1_epi8('.');
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(apn + i));
+        __m128i unprintable = _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v);
+        __m128i out = _mm_or_si128(_mm_and_si128(unprintable, dot),
+                                   _mm_andnot_si128(unprintable, v));
+        _mm_storeu_si128((__m128i *)(ascii + i), out);
+        int zero = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        if (zero) {
+            return i + __builtin_ctz(zero);
+        }
+    }
+    return i + apnCopyScalar(apn + i, len - i, ascii + i);
+}
+
+__attribute__((target("avx2"))) static int apnCopyAvx2(uint8_t *apn, int len,
+                                                       char *ascii)
+{
+    const __m256i ctl = _mm256_set1_epi8(0x1F);
+    const __m256i dot = _mm256_set1_epi8('.');
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(apn + i));
+        __m256i unprintable = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v);
+        __m256i out = _mm256_blendv_epi8(v, dot, unprintable);
+        _mm256_storeu_si256((__m256i *)(ascii + i), out);
+        uint32_t zero = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        if (zero) {
+            return i + __builtin_ctz(zero);
         }
     }
+    return i + apnCopySse2(apn + i, len - i, ascii + i);
+}
+#endif
+
+static void bcdExpandResolve(uint8_t *bcd, uint8_t bcdLen, char *ascii);
+static int apnCopyResolve(uint8_t *apn, int len, char *ascii);
+
+static void (*bcdExpand)(uint8_t *, uint8_t, char *) = bcdExpandResolve;
+static int (*apnCopy)(uint8_t *, int, char *) = apnCopyResolve;
+
+/* pick the kernels on first use, racing threads store the same pointers */
+static void resolveKernels()
+{
+    void (*bcd)(uint8_t *, uint8_t, char *) = bcdExpandScalar;
+    int (*apn)(uint8_t *, int, char *) = apnCopyScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) bcd = bcdExpandSsse3;
+    if (__builtin_cpu_supports("sse2")) apn = apnCopySse2;
+    if (__builtin_cpu_supports("avx2")) apn = apnCopyAvx2;
+#endif
+    __atomic_store_n(&bcdExpand, bcd, __ATOMIC_RELAXED);
+    __atomic_store_n(&apnCopy, apn, __ATOMIC_RELAXED);
+}
+
+static void bcdExpandResolve(uint8_t *bcd, uint8_t bcdLen, char *ascii)
+{
+    resolveKernels();
+    bcdExpandScalar(bcd, bcdLen, ascii);
+}
+
+static int apnCopyResolve(uint8_t *apn, int len, char *ascii)
+{
+    resolveKernels();
+    return apnCopyScalar(apn, len, ascii);
+}
+
+uint8_t BCD2ASCII(uint8_t *bcd, uint8_t bcdLen, char *ascii, uint8_t asciiLen)
+{
+    if (asciiLen < bcdLen) return 0;
+    if ((bcdLen == 0) || (asciiLen == 0)) return 0;
+
+    __atomic_load_n(&bcdExpand, __ATOMIC_RELAXED)(bcd, bcdLen, ascii);
 
     int has_st = 0;
     if (bcdLen % 2 == 0) {
@@ -59,21 +155,78 @@ uint8_t BCD2ASCII(uint8_t *bcd, uint8_t bcdLen, char *ascii, uint8_t asciiLen)
     return bcdLen;
 }
 
-int decodeMccMncLac(uint8_t *data, char *mcc, char *mnc, uint16_t *lac)
+/*
+ * pack bcd digits into an integer, stop at the filler or any non digit
+ * @return
+ *   number of digits packed
+ */
+uint8_t BCD2U64(uint8_t *bcd, uint8_t bcdLen, uint64_t *value)
+{
+    uint64_t v = 0;
+    uint8_t i = 0;
+    for (; i < bcdLen && i < 19; i++) {
+        uint8_t digit = i % 2 ? bcd[i / 2] >> 4 : bcd[i / 2] & 0x0F;
+        if (digit > 9) {
+            break;
+        }
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return i;
+}
+
+/*
+ * convert the dns label encoded apn into dotted form
+ * @return
+ *   length of the converted apn, 0 if ascii is too small
+ */
+uint8_t APN2ASCII(uint8_t *apn, uint8_t apnLen, char *ascii, uint8_t asciiLen)
 {
     int offset = 0;
-    BCD2ASCII(data + offset, MAX_MCC_SIZE + 1, mcc, MAX_MCC_SIZE + 1);
-    offset += 1;
-    uint8_t flag = (data[offset] >> 4) & 0x0F;
-    offset += 1;
-    if (flag == 0x0F) {
-        snprintf(mnc, MAX_MCC_SIZE + 1, "%x%x", data[offset] & 0x0F,
-                 (data[offset] >> 4) & 0x0F);
+    // remove prefix character
+    while (offset < apnLen && apn[offset] < 0x20) {
+        offset++;
+    }
+    if (asciiLen == 0) return 0;
+    if (apnLen - offset >= asciiLen) {
+        ascii[0] = 0; // a reused buffer must not keep the previous apn
+        return 0;
+    }
+
+    int i = __atomic_load_n(&apnCopy, __ATOMIC_RELAXED)(apn + offset,
+                                                        apnLen - offset, ascii);
+    ascii[i] = 0;
+
+    return i;
+}
+
+/*
+ * decode the 3 byte MCC/MNC of TS 24.008, a 2 digit MNC has the filler in
+ * place of its third digit
+ * @return
+ *   bytes consumed
+ */
+int decodeMccMnc(uint8_t *data, char *mcc, char *mnc)
+{
+    static const char hex_digits[16] = "0123456789abcdef";
+    mcc[0] = bcd_digits[data[0] & 0x0F];
+    mcc[1] = bcd_digits[data[0] >> 4];
+    mcc[2] = bcd_digits[data[1] & 0x0F];
+    mcc[3] = 0;
+    mnc[0] = hex_digits[data[2] & 0x0F];
+    mnc[1] = hex_digits[data[2] >> 4];
+    if ((data[1] >> 4) == 0x0F) {
+        mnc[2] = 0;
     } else {
-        snprintf(mnc, MAX_MNC_SIZE + 1, "%x%x%x", data[offset] & 0x0F,
-                 (data[offset] >> 4) & 0x0F, flag);
+        mnc[2] = hex_digits[data[1] >> 4];
+        mnc[3] = 0;
     }
-    offset += 1;
+    return 3;
+}
+
+int decodeMccMncLac(uint8_t *data, char *mcc, char *mnc, uint16_t *lac)
+{
+    int offset = decodeMccMnc(data, mcc, mnc);
     *lac = ntohs(*(uint16_t *)(data + offset));
     offset += 2;
 
@@ -7,6 +7,10 @@
 
 GCD_LOCAL uint8_t BCD2ASCII(uint8_t *bcd, uint8_t bcdLen, char *ascii,
                             uint8_t asciiLen);
+GCD_LOCAL uint8_t BCD2U64(uint8_t *bcd, uint8_t bcdLen, uint64_t *value);
+GCD_LOCAL uint8_t APN2ASCII(uint8_t *apn, uint8_t apnLen, char *ascii,
+                            uint8_t asciiLen);
+GCD_LOCAL int decodeMccMnc(uint8_t *data, char *mcc, char *mnc);
 GCD_LOCAL int decodeMccMncLac(uint8_t *data, char *mcc, char *mnc,
                               uint16_t *lac);
 
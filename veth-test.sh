@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# live capture check on a local veth pair, needs root:
+#
+#   ./veth-test.sh [transactions] [rings]
+#
+# gcd-gen writes a capture of gtpv2 transactions, its frames are sent raw
+# into one end of the pair while gcd-pcap -i reads the other end. every
+# frame sent has to be captured and decoded, with no kernel drops.
+
+set -eu
+
+TRANSACTIONS=${1:-20000}
+RINGS=${2:-2}
+TX=gcdtest0
+RX=gcdtest1
+DIR=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d)
+
+cleanup() {
+    ip link del "$TX" 2>/dev/null || true
+    rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+ip link add "$TX" type veth peer name "$RX"
+for dev in "$TX" "$RX"; do
+    # keep the kernel's own ipv6 chatter off the pair
+    sysctl -qw "net.ipv6.conf.$dev.disable_ipv6=1" 2>/dev/null || true
+    ip link set "$dev" up
+done
+
+"$DIR/gcd-gen" -v 2 -n "$TRANSACTIONS" -o "$TMP/gen.pcap" 2>/dev/null
+"$DIR/gcd-pcap" -q -w "$RINGS" -i "$RX" 2>"$TMP/live.txt" &
+PID=$!
+sleep 1
+
+SENT=$(python3 - "$TMP/gen.pcap" "$TX" <<'EOF'
+import socket, struct, sys
+data = open(sys.argv[1], "rb").read()
+s = socket.socket(socket.AF_PACKET, socket.SOCK_RAW)
+s.bind((sys.argv[2], 0))
+off, sent = 24, 0
+while off < len(data):
+    caplen = struct.unpack_from("<I", data, off + 8)[0]
+    s.send(data[off + 16:off + 16 + caplen])
+    off += 16 + caplen
+    sent += 1
+print(sent)
+EOF
+)
+
+sleep 1
+kill -INT "$PID"
+wait "$PID" || true
+cat "$TMP/live.txt"
+
+FRAMES=$(sed -n 's/^frames \([0-9]*\) .*/\1/p' "$TMP/live.txt")
+DECODED=$(sed -n 's/.* decoded \([0-9]*\),.*/\1/p' "$TMP/live.txt")
+DROPS=$(sed -n 's/^kernel drops \([0-9]*\),.*/\1/p' "$TMP/live.txt")
+
+if [ "$FRAMES" = "$SENT" ] && [ "$DECODED" = "$SENT" ] && [ "$DROPS" = 0 ]
+then
+    echo "ok: $SENT frames sent, captured and decoded, 0 drops"
+else
+    echo "FAILED: sent $SENT, captured ${FRAMES:-?}, decoded ${DECODED:-?}," \
+         "kernel drops ${DROPS:-?}"
+    exit 1
+fi